@@ -0,0 +1,114 @@
+/*
+Bump allocator. Allocations are carved out of large chunks and never freed individually,
+so dropping a whole trie or a whole set of completion matches is a handful of free() calls.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+/// @brief start a new chunk big enough for size, chunks double so the chunk count stays logarithmic
+static arena_chunk* new_chunk(arena* a, size_t size) {
+    size_t cap = a->head ? a->head->cap * 2 : ARENA_MIN_CHUNK;
+    while (cap < size) {
+        cap *= 2;
+    }
+    arena_chunk* chunk = malloc(sizeof(arena_chunk) + cap);
+    if (chunk == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    chunk->next = a->head;
+    chunk->cap = cap;
+    chunk->used = 0;
+    a->head = chunk;
+    a->bytes += cap;
+    return chunk;
+}
+
+void arena_init(arena* a) {
+    a->head = NULL;
+    a->last = NULL;
+    a->bytes = 0;
+}
+
+void* arena_alloc(arena* a, size_t size) {
+    size = align_up(size ? size : 1);
+    arena_chunk* chunk = a->head;
+    if (chunk == NULL || chunk->cap - chunk->used < size) {
+        chunk = new_chunk(a, size);
+    }
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    a->last = ptr;
+    return ptr;
+}
+
+void* arena_calloc(arena* a, size_t size) {
+    void* ptr = arena_alloc(a, size);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+/// @brief realloc for arena memory, extends in place when ptr was the last allocation and there is room
+/// * the old block is simply abandoned otherwise, it goes away with the arena
+void* arena_grow(arena* a, void* ptr, size_t old_size, size_t new_size) {
+    if (ptr == NULL) {
+        return arena_alloc(a, new_size);
+    }
+    arena_chunk* chunk = a->head;
+    if (ptr == a->last) {
+        size_t offset = (size_t) ((char*) ptr - chunk->data);
+        size_t needed = align_up(new_size);
+        if (offset + needed <= chunk->cap) {
+            chunk->used = offset + needed;
+            return ptr;
+        }
+    }
+    void* grown = arena_alloc(a, new_size);
+    memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    return grown;
+}
+
+/// @brief copies n bytes of s and NUL terminates
+char* arena_strndup(arena* a, const char* s, size_t n) {
+    char* copy = arena_alloc(a, n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+/// @brief release everything but keep the biggest chunk around, so a reused arena stops calling malloc
+void arena_reset(arena* a) {
+    arena_chunk* keep = a->head;
+    if (keep == NULL) return;
+
+    arena_chunk* chunk = keep->next;
+    while (chunk) {
+        arena_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    keep->next = NULL;
+    keep->used = 0;
+    a->bytes = keep->cap;
+    a->last = NULL;
+}
+
+void arena_free(arena* a) {
+    arena_chunk* chunk = a->head;
+    while (chunk) {
+        arena_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena_init(a);
+}
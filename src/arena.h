@@ -0,0 +1,33 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_MIN_CHUNK 4096
+#define ARENA_ALIGN 8
+
+// bump allocator, everything allocated from an arena is released at once by arena_reset()/arena_free()
+typedef struct arena_chunk arena_chunk;
+struct arena_chunk {
+    arena_chunk* next;
+    size_t cap;
+    size_t used;
+    char data[];
+};
+
+typedef struct arena arena;
+struct arena {
+    arena_chunk* head; // chunk currently being bumped, older chunks follow
+    void* last;        // most recent allocation, the only one arena_grow() can extend in place
+    size_t bytes;      // total bytes of all chunks
+};
+
+void  arena_init(arena* a);
+void* arena_alloc(arena* a, size_t size);
+void* arena_calloc(arena* a, size_t size);
+void* arena_grow(arena* a, void* ptr, size_t old_size, size_t new_size);
+char* arena_strndup(arena* a, const char* s, size_t n);
+void  arena_reset(arena* a);
+void  arena_free(arena* a);
+
+#endif
@@ -14,38 +14,69 @@ but my own custom completion and display functions.
 
 #include <readline/readline.h>
 #include <dirent.h>
+#include <time.h>
 #include <sys/stat.h>
 
 
 #include "autocomplete.h"
 #include "prefixTree.h"
+#include "pathWatcher.h"
+#include "exeIndex.h"
+#include "dirFetch.h"
+#include "pathScan.h"
+#include "fuzzyMatch.h"
+#include "frecency.h"
 
 static int tab_handler(int count, int key);
 static char** executable_ac(const char* text, int start, int end);
 static char** filename_ac(const char* text, int start, int end);
-static char** filename_ac_helper(const char* text, int start, int end);
-static char* find_lcp(char** matches, const char* text);
-static char* exe_generator(const char* text, int state);
-static char* filepath_generator(const char* text, int state);
+static char** filename_ac_helper(const char* text, int start, int end, size_t dir_len, const dir_matches* matches);
+// a command that was run before, while listing matches
+typedef struct ranked_cmd ranked_cmd;
+struct ranked_cmd {
+    char* name;
+    double score;
+};
+
+static void print_file_matches(const char* text, size_t dir_len, const dir_matches* matches);
+static void print_exe_matches(trie* subtree, trie_type* type);
+static bool is_command(const char* name);
+static char** single_match(const char* word, size_t len);
+static char** exe_fuzzy_ac(const char* text);
+static char** file_fuzzy_ac(const char* text, int start, int end, const char* dir, size_t dir_len);
+static const fuzzy_set* exe_fuzzy_set(void);
+static size_t rank_entries(const dir_matches* all, const char* query, fuzzy_match** ranked);
+static void print_exe_fuzzy(const char* text);
+static void display_file_fuzzy(const char* text, const char* dir, size_t dir_len);
+static void print_file_fuzzy(const char* text, size_t dir_len, const fuzzy_match* ranked, size_t n);
+static trie* exe_subtree(const char* text, trie_type* type);
+static void poll_exe_tree(void);
 static void populate_builtin_tree(trie *root);
-static void populate_exe_tree(trie* root);
-static int populate_filepath_tree(trie* root, const char* directory);
-static void display_matches(char **matches, int num_matches, int max_length);
+static void display_matches(void);
+static bool confirm_display(size_t num_matches);
 
 static bool did_autocomplete = false;
 static bool multiple_matches = false;
+bool ac_fuzzy = false;
 
 trie* builtin_tree_root = NULL;
 trie* exe_tree_root = NULL;
-trie* filepath_tree_root = NULL;
 
-const char* builtin_cmds[] = {"type", "echo", "exit", "pwd", "history", "cd", NULL};
+// per completion scratch space for match arrays, reset at the start of every TAB
+static arena ac_scratch;
+
+// `set -o fuzzy` candidates: every builtin and executable, built on first use and again after the tree is swapped
+static fuzzy_set exe_fuzzy;
+static bool exe_fuzzy_valid = false;
+// the directory being completed in, refilled every time
+static fuzzy_set file_fuzzy;
+
+const char* builtin_cmds[] = {"type", "echo", "exit", "pwd", "history", "cd", "hash", "export", "set", "jobs", "fg", "bg", "wait", NULL};
 
 void init_ac_readline(void) {
     rl_completer_word_break_characters = 
         strdup(" \t\n\"\\'`@$><;|&{(");
     rl_attempted_completion_function = autocomplete;
-    rl_completion_display_matches_hook = display_matches;
     rl_bind_key('\t', tab_handler);
 }
 
@@ -53,22 +84,47 @@ void init_ac(void) {
     builtin_tree_root = trie_create(); // exit, echo
     populate_builtin_tree(builtin_tree_root);
 
-    exe_tree_root = trie_create(); // from PATH
-    populate_exe_tree(exe_tree_root);
+    const char* path = getenv("PATH");
+    time_t built_at = time(NULL);
+    path_scan* scan = path_scan_start(path, path_scan_timeout_setting());
+    size_t key_len = 0;
+    char* key = path_scan_index_key(scan, &key_len); // before listing anything, see exe_index_key()
+    exe_tree_root = exe_index_load(key, key_len); // mmap'd from the last shell with this PATH, if still fresh
+    if (exe_tree_root == NULL) {
+        exe_tree_root = trie_create(); // from PATH
+        if (path_scan_merge(scan, exe_tree_root)) {
+            exe_index_save(exe_tree_root, key, key_len);
+        } else {
+            built_at = 0; // a directory missed the deadline or failed to read, the watcher rescans everything in the background
+        }
+    }
+    path_scan_finish(scan);
+    free(key);
+    path_watcher_start(path, built_at); // keeps exe_tree_root fresh from now on
+    dir_fetch_start(); // reads directories for filename completion
+
+    arena_init(&ac_scratch);
+    fuzzy_set_init(&exe_fuzzy);
+    fuzzy_set_init(&file_fuzzy);
 }
 
 void cleanup_ac(void) {
+    path_watcher_stop();
     trie_free(builtin_tree_root);
     trie_free(exe_tree_root);
-    trie_free(filepath_tree_root);
+    dir_fetch_stop();
+    arena_free(&ac_scratch);
+    fuzzy_set_free(&exe_fuzzy);
+    fuzzy_set_free(&file_fuzzy);
+    exe_fuzzy_valid = false;
 }
 
 static int tab_handler(int count, int key) {
     did_autocomplete = false;
-    // upon second consecutive TAB, call hook to our custom display_matches() function.
+    // upon second consecutive TAB, list the matches ourselves, readline would want every one of them as a string first
     if (multiple_matches) {
-        rl_possible_completions(count, key);
         multiple_matches = false;
+        display_matches();
     } else {
         rl_complete(count, key);
         if (!did_autocomplete) { // print terminal bell when multiple matches or none
@@ -81,82 +137,122 @@ static int tab_handler(int count, int key) {
     return 0;
 }
 
-static void display_matches(char **matches, int num_matches, int max_length) {
-    printf("\n");
-    for (int i = 1; i <= num_matches; ++i) {
-        printf("%s  ", matches[i]);
+/// @brief print the matches for the word before the cursor, streamed straight out of the trie or directory listing
+/// * the word boundary is found the same way readline does it, by scanning back to a word break character
+static void display_matches(void) {
+    arena_reset(&ac_scratch);
+    int start = rl_point;
+    while (start > 0 && !strchr(rl_completer_word_break_characters, rl_line_buffer[start - 1])) {
+        --start;
     }
+    const char* text = arena_strndup(&ac_scratch, rl_line_buffer + start, rl_point - start);
+
     printf("\n");
+    if (start == 0) {
+        trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0, .scratch = &ac_scratch};
+        trie* subtree = exe_subtree(text, &type);
+        if (subtree == NULL && ac_fuzzy) {
+            print_exe_fuzzy(text);
+        } else if (subtree && confirm_display(subtree->num_words)) {
+            print_exe_matches(subtree, &type);
+        }
+    } else {
+        char* last_slash_addr = strrchr(text, '/');
+        size_t dir_len = last_slash_addr ? (size_t) (last_slash_addr - text) + 1 : 0;
+        const char* dir = dir_len ? arena_strndup(&ac_scratch, text, dir_len) : "./";
+        dir_matches matches;
+        dir_fetch_status status = dir_fetch(dir, text + dir_len, fileno(rl_instream), &ac_scratch, &matches); // partial matches are listed too
+        if (matches.count == 0 && status == DIR_FETCH_DONE && ac_fuzzy) {
+            display_file_fuzzy(text, dir, dir_len);
+        } else if (matches.count && confirm_display(matches.count)) {
+            print_file_matches(text, dir_len, &matches);
+        }
+    }
     rl_on_new_line();
-    rl_redisplay();
-    multiple_matches = false;
 }
 
-/// @brief test function for just the echo and exit builtins
-/// @param root of trie
-static void populate_builtin_tree(trie *root) {
-    for(size_t i = 0; builtin_cmds[i]; ++i) {
-        trie_insert(root, (char*) builtin_cmds[i]);
+/// @brief the commands below subtree, the ones run before first by frecency, then the rest in byte order
+/// * two walks over the subtree with a hash lookup per word, nothing is copied but the ones that were run
+static void print_exe_matches(trie* subtree, trie_type* type) {
+    size_t prefix_sz = type->autocomplete_buf_sz;
+    ranked_cmd* ranked = NULL;
+    size_t num_ranked = 0;
+    size_t cap = 0;
+    trie_iter* it = arena_alloc(&ac_scratch, sizeof(trie_iter));
+    trie_iter_init(it, subtree, type);
+    while (trie_iter_next(it)) {
+        double score = frecency_score(type->autocomplete_buf, type->autocomplete_buf_sz);
+        if (score == 0) continue;
+        if (num_ranked == cap) {
+            size_t new_cap = cap ? cap * 2 : INIT_MATCHES_BUF_SIZE;
+            ranked = arena_grow(&ac_scratch, ranked, cap * sizeof(ranked_cmd), new_cap * sizeof(ranked_cmd));
+            cap = new_cap;
+        }
+        ranked[num_ranked].name = arena_strndup(&ac_scratch, type->autocomplete_buf, type->autocomplete_buf_sz);
+        ranked[num_ranked++].score = score;
     }
-}
-
-/// @brief scan directory for files and add the full file paths to the trie 
-/// @param root of trie
-/// @param directory target directory
-/// @return 1 if scandir failed, 0 otherwise
-static int populate_filepath_tree(trie* root, const char* directory) {
-    struct dirent** exe_list = NULL;
-    int numExe = scandir(directory, &exe_list, NULL, alphasort);
-    if (numExe <= 0) {
-        return 1;
+    // insertion sort, only a handful of commands under a prefix were ever run
+    for (size_t i = 1; i < num_ranked; ++i) {
+        ranked_cmd cur = ranked[i];
+        size_t k = i;
+        for (; k > 0 && ranked[k - 1].score < cur.score; --k) {
+            ranked[k] = ranked[k - 1];
+        }
+        ranked[k] = cur;
+    }
+    for (size_t i = 0; i < num_ranked; ++i) {
+        fputs(ranked[i].name, stdout);
+        fputs("  ", stdout);
     }
 
-    for (int i = 0; i < numExe; ++i) {
-        char* filepath = malloc(strlen(directory) + strlen(exe_list[i]->d_name) + 1);
-        memcpy(filepath, directory, strlen(directory) + 1);
-        strcat(filepath, exe_list[i]->d_name);
-        trie_insert(root, filepath);
-        free(filepath);
+    type->autocomplete_buf_sz = prefix_sz;
+    trie_iter_init(it, subtree, type);
+    while (trie_iter_next(it)) {
+        if (num_ranked && frecency_score(type->autocomplete_buf, type->autocomplete_buf_sz) > 0) continue;
+        fwrite(type->autocomplete_buf, 1, type->autocomplete_buf_sz, stdout);
+        fputs("  ", stdout);
     }
+    printf("\n");
+}
 
-    for (int i = 0; i < numExe; ++i) {
-        free(exe_list[i]);
+/// @brief the matches as they'd be completed, with the directory part as typed
+static void print_file_matches(const char* text, size_t dir_len, const dir_matches* matches) {
+    for (size_t i = 0; i < matches->count; ++i) {
+        fwrite(text, 1, dir_len, stdout);
+        fwrite(matches->entries[i].name, 1, matches->entries[i].len, stdout);
+        fputs("  ", stdout);
     }
-    free(exe_list);
-    return 0;
+    printf("\n");
 }
 
-/// @brief add every executable file in PATH to the prefix tree
-/// @param root root of executable file tree
-/// @return void
-static void populate_exe_tree(trie *root) {
-   // search for executable programs in PATH
-    const char* path = getenv("PATH");
-    // if we do not duplicate the path then we are actually editing the PATH environment everytime we tokenize on dir upon calling this func!
-    char* path_copy = strdup(path);
-    char* scan = path_copy;
-    char* curr_path = strtok(scan, ":");
-
-    while (curr_path) { // this code assumes that only directories are in PATH, maybe call stat and S_ISDIR() to verify 
-        struct dirent** exe_list = NULL; // *MUST DECLARE AS NULL OTHERWISE ON EDGE CASE THAT FIRST DIRECTRORY SEARCHED GIVES ERR OR 0 ENTRIES, YOU ARE FREEING UNITIALIZED MEMORY!
-        int numExe = scandir(curr_path, &exe_list, NULL, alphasort);
-        if (numExe <= 0) { // error or 0 entries in array
-            curr_path = strtok(NULL, ":");
-            if (exe_list) free(exe_list);
-            continue;
-        }
-        for (int i = 0; i < numExe; ++i) {
-            trie_insert(root, exe_list[i]->d_name);
+/// @brief ask before flooding the terminal, like readline does past completion-query-items (100 unless set in inputrc)
+/// @return true if the matches should be printed
+static bool confirm_display(size_t num_matches) {
+    if (rl_completion_query_items <= 0 || num_matches < (size_t) rl_completion_query_items) return true;
+
+    printf("Display all %zu possibilities? (y or n)", num_matches);
+    fflush(stdout);
+    for (;;) {
+        int c = rl_read_key();
+        if (c == 'y' || c == 'Y' || c == ' ') {
+            printf("\n");
+            return true;
         }
-
-        for (int i = 0; i < numExe; ++i) {
-            free(exe_list[i]);
+        if (c == 'n' || c == 'N' || c == 0x7f || c == 0x07 || c == EOF) { // also DEL and ^G
+            printf("\n");
+            return false;
         }
-        free(exe_list);
+        printf("\x07");
+        fflush(stdout);
+    }
+}
 
-        curr_path = strtok(NULL, ":");
+/// @brief test function for just the echo and exit builtins
+/// @param root of trie
+static void populate_builtin_tree(trie *root) {
+    for(size_t i = 0; builtin_cmds[i]; ++i) {
+        trie_insert(root, (char*) builtin_cmds[i]);
     }
-    free(path_copy);
 }
 
 /// @brief autocompletes based on index of word, calls executable or filename autocompletion.
@@ -178,236 +274,269 @@ char** autocomplete(const char* text, int start, int end) {
     return matches;
 }
 
-/// @brief autocompletion by calling 'exe_generator' which generates an array of executable/builtin, manually completes to longest common prefix if possible
+/// @brief executable/builtin autocompletion, the match count and longest common prefix come straight from the trie
+/// so no match is turned into a string until they are displayed (see display_matches)
 /// @param text word that TAB was pressed on
 /// @param start start index
 /// @param end end index
-/// @return array of strings for possible matches, NULL means completion was inserted manually
+/// @return the single match for readline to insert, NULL means completion was inserted manually or there is nothing to insert
 static char** executable_ac(const char* text, int start, int end) {
-    char** matches = NULL;
-    matches = rl_completion_matches(text, exe_generator);
-    if (matches) {
-        char* prefix = find_lcp(matches, text);
-        if (prefix) {
-            if (strcmp(prefix, text)) {
-                did_autocomplete = true;
-                rl_replace_line(prefix, 0);
-                rl_point = strlen(prefix);
-                free(prefix);
-                for (char** m = matches; *m; ++m) {
-                    free(*m);
-                }
-                free(matches);
-                return NULL;
-            }
-            multiple_matches = true;
-            free(prefix);
-        } else {
-            did_autocomplete = true;
-        }
+    arena_reset(&ac_scratch);
+    trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0, .scratch = &ac_scratch};
+    trie* subtree = exe_subtree(text, &type);
+    if (subtree == NULL) return ac_fuzzy ? exe_fuzzy_ac(text) : NULL;
+
+    trie_lcp(subtree, &type);
+    if (subtree->num_words == 1) { // single match, readline inserts it and appends a space
+        did_autocomplete = true;
+        return single_match(type.autocomplete_buf, type.autocomplete_buf_sz);
     }
-    return matches;
+    if (type.autocomplete_buf_sz > strlen(text)) {
+        did_autocomplete = true;
+        char* prefix = arena_strndup(&ac_scratch, type.autocomplete_buf, type.autocomplete_buf_sz);
+        rl_delete_text(start, end);
+        rl_point = start;
+        rl_insert_text(prefix);
+        return NULL;
+    }
+    // current text is already lcp: offer the match run the most, and the next TAB lists them all
+    const char* best = *text ? frecency_best(text, is_command) : NULL;
+    if (best && strcmp(best, text)) {
+        did_autocomplete = true;
+        rl_delete_text(start, end);
+        rl_point = start;
+        rl_insert_text(best);
+    }
+    multiple_matches = true;
+    return NULL;
 }
 
 /// @brief If a '/' is present in text, then complete on that directory, otherwise use current directory
 /// @param text file path that needs to be completed
 /// @param start start index
 /// @param end end index
-/// @return array of strings for possible matches, NULL means completion was inserted manually
+/// @return NULL, the completion is inserted manually and multiple matches are listed on the next TAB
 static char** filename_ac(const char* text, int start, int end) {
-    char** matches = NULL;
-
-    if (filepath_tree_root) {
-        trie_free(filepath_tree_root);
-    }
-    filepath_tree_root = trie_create();
+    arena_reset(&ac_scratch);
 
+    // the directory part is kept exactly as typed, only the name after the last '/' gets completed
     char* last_slash_addr = strrchr(text, '/');
-    if (last_slash_addr != NULL) {
-        // get the file path up until the last "/"
-        size_t index = (size_t) (last_slash_addr - text);
-        char* curr_file_path = malloc(index + 2);
-        memcpy(curr_file_path, text, index + 1);
-        curr_file_path[index + 1] = '\0'; 
-        
-        int result = populate_filepath_tree(filepath_tree_root, curr_file_path);
-        free(curr_file_path);
-        if (result) return NULL;
-
-        matches = filename_ac_helper(text, start, end);
-    } else {
-        // completing in current directory
-        int result = populate_filepath_tree(filepath_tree_root, "./");
-        if (result) return NULL;
-    
-        char current_dir[PATH_MAX];
-        strcpy(current_dir, "./");
-        strcat(current_dir, text);
-
-        matches = filename_ac_helper(current_dir, start, end);
+    size_t dir_len = last_slash_addr ? (size_t) (last_slash_addr - text) + 1 : 0;
+    const char* dir = dir_len ? arena_strndup(&ac_scratch, text, dir_len) : "./"; // completing in current directory
+
+    // the directory is read on the completion worker, a slow filesystem costs at most DIR_FETCH_DEADLINE_MS here
+    dir_matches matches;
+    dir_fetch_status status = dir_fetch(dir, text + dir_len, fileno(rl_instream), &ac_scratch, &matches);
+    if (status == DIR_FETCH_CANCELLED) {
+        did_autocomplete = true; // no bell, the keys typed meanwhile are what the user wants
+        return NULL;
     }
-    return matches;
+    if (matches.count == 0 && status == DIR_FETCH_DONE && ac_fuzzy) return file_fuzzy_ac(text, start, end, dir, dir_len);
+    if (matches.count == 0) return NULL;
+    if (status == DIR_FETCH_PARTIAL) {
+        // * only listed, never inserted: a name that hasn't been read yet could shorten the common prefix
+        did_autocomplete = true;
+        printf("\n");
+        if (confirm_display(matches.count)) print_file_matches(text, dir_len, &matches);
+        rl_on_new_line();
+        return NULL;
+    }
+    return filename_ac_helper(text, start, end, dir_len, &matches);
 }
 
-/// @brief calls functions to obtain array of matches, longest common prefix, or does manual insertion of text
+/// @brief completes to the single match or the longest common prefix, otherwise flags the matches for display
 /// @param text file path that needs to be completed
 /// @param start start index
 /// @param end end index
-/// @return array of strings for possible matches, NULL means completion was inserted manually
-static char** filename_ac_helper(const char* text, int start, int end) {
-    char** matches = NULL;
-    matches = rl_completion_matches(text, filepath_generator);
-    
-    if (matches) {
-        char* prefix = find_lcp(matches, text);
-        if (prefix) {
-            if (strcmp(prefix, text)) {
-                did_autocomplete = true;
-
-                char* lcp = prefix;
-                struct stat st;
-                if ((stat(lcp, &st) == 0) && S_ISDIR(st.st_mode)) {
-                    rl_insert_text("/");
-                }
-
-                if (strncmp(prefix, "./", 2) == 0) {
-                    lcp += 2; // strip './' prefix
-                }
-                rl_delete_text(start, end);
-                rl_point = start;
-                rl_insert_text(lcp);
-                
-                for (char** m = matches; *m; ++m) {
-                    free(*m);
-                }
-                free(matches);
-                free(prefix);
-                return NULL;
-            }
-            // current text is already lcp
-            multiple_matches = true;
-            free(prefix);
-            return matches; // return array for display_matches
-        } else { // SINGLE MATCH IN MATCHES ARRAY
-            did_autocomplete = true;
-
-            char *match = matches[0];
-
-            if (strncmp(match, "./", 2) == 0) {
-                match += 2; 
-            }
-
-            rl_delete_text(start, end);
-            rl_point = start;
-            rl_insert_text(match);
-            // append '/' if directory
-            struct stat st;
-            if ((stat(match, &st) == 0) && S_ISDIR(st.st_mode)) {
-                rl_insert_text("/");
-            }
-            rl_redisplay();
-            
-            for (char** m = matches; *m; ++m) {
-                free(*m);
-            }
-            free(matches);
-            return NULL;
+/// @param dir_len length of the directory part of text
+/// @param matches sorted entries that start with the rest of text, at least one
+/// @return NULL, the completion is inserted manually and multiple matches are listed on the next TAB
+static char** filename_ac_helper(const char* text, int start, int end, size_t dir_len, const dir_matches* matches) {
+    const dir_entry* entries = matches->entries;
+    size_t count = matches->count;
+    // entries are sorted, so the lcp of all of them is the lcp of the first and the last
+    size_t lcp_len = 0;
+    if (count == 1) {
+        lcp_len = entries[0].len;
+    } else {
+        const char* last = entries[count - 1].name;
+        while (entries[0].name[lcp_len] && entries[0].name[lcp_len] == last[lcp_len]) {
+            ++lcp_len;
         }
     }
-    return matches;
-}
 
-/// @brief iterate through array of matches until text indices do not match
-/// @param str_arr array of autocompletion matches
-/// @param text text to be autocompleted
-/// @return mallocd string for longest common prefix (lcp), MUST BE FREE'D BY CALLER, returns NULL if only a single match in array
-static char* find_lcp(char** matches, const char* text) {
-    char** first_match = matches; 
-
-    char* lcp = *first_match; // set the lcp to an arbitrary match since it cannot be greater in length than any individual match
-    // * NOTE: there are no string length checks here since the strings in the matches array are guaranteed to all contain text as a prefix
-    int idx = strlen(text) - 1; // current index of lcp
-
-    if (*(first_match + 1) == NULL) return NULL; // only one match
-
-    bool does_match = true;
-    while (lcp[idx] != '\0') {
-        for (char** i = first_match + 1; *i; ++i) {
-            if ( ((*i)[idx] == '\0') || ((*i)[idx] != (*first_match)[idx]) ) {
-                does_match = false;
-                break; 
-            }
+    if (count == 1 || lcp_len > strlen(text) - dir_len) {
+        did_autocomplete = true;
+
+        char* completion = arena_alloc(&ac_scratch, dir_len + lcp_len + 1);
+        memcpy(completion, text, dir_len);
+        memcpy(completion + dir_len, entries[0].name, lcp_len);
+        completion[dir_len + lcp_len] = '\0';
+
+        rl_delete_text(start, end);
+        rl_point = start;
+        rl_insert_text(completion);
+        // append '/' if the completion names a directory, it can only be the first entry since it is a prefix of the rest
+        if (entries[0].len == lcp_len && matches->first_is_dir) {
+            rl_insert_text("/");
         }
-        if (!does_match) break;
-        ++idx;
+        rl_redisplay();
+        return NULL;
     }
 
-    return strndup(lcp, idx); // strndup adds the null terminator if not in duplicated bytes
+    multiple_matches = true; // current text is already lcp, next TAB lists them
+    return NULL;
 }
 
-/// @brief builds match array by obtaining subtree of current text, returns elements from array
-/// @param text text to be autocompleted
-/// @param state integer for how many number of times generator fcn is called, 0 means first for current text
-/// @return current element of match array
-static char* filepath_generator(const char* text, int state) {
-    static char** match_arr = NULL;
-    static int list_idx = 0;
-
-    if (state == 0) {
-        if ((match_arr)) {
-            // free unreturned matches, readline frees returned ones
-            for (int k = list_idx; match_arr[k] != NULL; ++k) {
-                free(match_arr[k]);
-            }
-            free(match_arr);
-            match_arr = NULL;
-        }
-        list_idx = 0;
-        trie_type filepath = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0};
-        trie* subtree = get_prefix_subtree(filepath_tree_root, (char*)text, &filepath);
-        if (subtree) {
-            match_arr = assemble_trie(subtree, &filepath);    
-        }
+/// @brief the layout readline frees itself for a single match, which is its own substitution: [match, NULL]
+/// @return malloc'd array, ownership goes to readline
+static char** single_match(const char* word, size_t len) {
+    char** owned = malloc(2 * sizeof(char*));
+    owned[0] = strndup(word, len);
+    owned[1] = NULL;
+    return owned;
+}
+
+/// @brief find the subtree of words starting with text, builtins take priority over PATH executables
+/// @param type its buffer is left holding the prefix of the subtree
+/// @return NULL if nothing starts with text
+static trie* exe_subtree(const char* text, trie_type* type) {
+    poll_exe_tree();
+    trie* subtree = get_prefix_subtree(builtin_tree_root, (char*) text, type);
+    if (subtree) return subtree;
+    // if not found in builtin_tree, then search exe_tree
+    type->autocomplete_buf_sz = 0;
+    return get_prefix_subtree(exe_tree_root, (char*) text, type); // * NULL RINGS THE BELL IN tab_handler(), took a really long time to debug this...
+}
+
+/// @brief a builtin or an executable in PATH right now, for frecency_best()
+static bool is_command(const char* name) {
+    return trie_search(builtin_tree_root, (char*) name) || trie_search(exe_tree_root, (char*) name);
+}
+
+/// @brief swap in the tree the path watcher rebuilt after a PATH change, nothing else can be using the old one now
+static void poll_exe_tree(void) {
+    trie* fresh = path_watcher_poll();
+    if (fresh) {
+        trie_free(exe_tree_root);
+        exe_tree_root = fresh;
+        exe_fuzzy_valid = false;
     }
+}
 
-    if (!match_arr || !match_arr[list_idx]) {
+/// @brief `set -o fuzzy` completion of a command nothing starts with
+/// @return the only match for readline to insert, NULL if there are none or several to list on the next TAB
+static char** exe_fuzzy_ac(const char* text) {
+    const fuzzy_set* set = exe_fuzzy_set();
+    fuzzy_match* ranked = arena_alloc(&ac_scratch, set->count * sizeof(fuzzy_match));
+    size_t n = fuzzy_rank(set, text, ranked);
+    if (n == 1) {
+        did_autocomplete = true;
+        return single_match(fuzzy_name(set, ranked[0].index), ranked[0].len);
+    }
+    multiple_matches = n > 1;
+    return NULL;
+}
+
+/// @brief `set -o fuzzy` completion of a file name nothing in dir starts with
+/// @return NULL, the only match is inserted manually and several are listed on the next TAB
+static char** file_fuzzy_ac(const char* text, int start, int end, const char* dir, size_t dir_len) {
+    dir_matches all;
+    dir_fetch_status status = dir_fetch(dir, "", fileno(rl_instream), &ac_scratch, &all); // cached by the prefix fetch just before
+    if (status == DIR_FETCH_CANCELLED) {
+        did_autocomplete = true;
+        return NULL;
+    }
+    fuzzy_match* ranked = NULL;
+    size_t n = rank_entries(&all, text + dir_len, &ranked);
+    if (n && status == DIR_FETCH_PARTIAL) { // listed, never inserted, like filename_ac()
+        did_autocomplete = true;
+        printf("\n");
+        if (confirm_display(n)) print_file_fuzzy(text, dir_len, ranked, n);
+        rl_on_new_line();
+        return NULL;
+    }
+    if (n != 1) {
+        multiple_matches = n > 1;
         return NULL;
     }
-    return match_arr[list_idx++];
+
+    did_autocomplete = true;
+    const char* name = fuzzy_name(&file_fuzzy, ranked[0].index);
+    char* completion = arena_alloc(&ac_scratch, dir_len + ranked[0].len + 1);
+    memcpy(completion, text, dir_len);
+    memcpy(completion + dir_len, name, ranked[0].len + 1);
+    rl_delete_text(start, end);
+    rl_point = start;
+    rl_insert_text(completion);
+    // * fetched again by its full name, it sorts first, so the worker does the directory check
+    dir_matches exact;
+    if (dir_fetch(dir, name, -1, &ac_scratch, &exact) == DIR_FETCH_DONE && exact.first_is_dir) {
+        rl_insert_text("/");
+    }
+    rl_redisplay();
+    return NULL;
 }
 
-static char* exe_generator(const char* text, int state) {
-    static char** match_arr = NULL;
-    static int list_idx = 0;
-
-    if (state == 0) {
-        if ((match_arr)) {
-            // free unreturned matches
-            for (int k = list_idx; match_arr[k] != NULL; ++k) {
-                free(match_arr[k]);
-            }
-            free(match_arr);
-            match_arr = NULL; // * heap use after free err without this line
-        }
-        list_idx = 0;
-        trie_type builtin = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0};
-        trie* subtree = get_prefix_subtree(builtin_tree_root, (char*)text, &builtin);
-        if (subtree) {
-            match_arr = assemble_trie(subtree, &builtin);
-        // if not found in builtin_tree, then search exe_tree
-        } else {
-            trie_type exe = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0};
-            trie* exe_subtree = get_prefix_subtree(exe_tree_root, (char*) text, &exe);
-            if (exe_subtree) {
-                match_arr = assemble_trie(exe_subtree, &exe);
-            } else {
-                match_arr = NULL; // * NO COMPLETIONS POSSIBLE, RETURN NULL TO THEN RING BELL IN tab_handler(), took a really long time to debug this... 
-            }
+/// @brief builtins and executables as fuzzy candidates, builtins first and not repeated, like exe_subtree() picks them
+static const fuzzy_set* exe_fuzzy_set(void) {
+    if (exe_fuzzy_valid) return &exe_fuzzy;
+    fuzzy_set_clear(&exe_fuzzy);
+    trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0, .scratch = &ac_scratch};
+    trie_iter* it = arena_alloc(&ac_scratch, sizeof(trie_iter));
+    trie* roots[] = {builtin_tree_root, exe_tree_root};
+    for (size_t r = 0; r < ARRAY_LEN(roots); ++r) {
+        type.autocomplete_buf_sz = 0;
+        trie_iter_init(it, roots[r], &type);
+        while (trie_iter_next(it)) {
+            type.autocomplete_buf[type.autocomplete_buf_sz] = '\0';
+            if (r > 0 && trie_search(builtin_tree_root, type.autocomplete_buf)) continue;
+            fuzzy_set_add(&exe_fuzzy, type.autocomplete_buf, type.autocomplete_buf_sz);
         }
     }
-    
-    if (!match_arr || !match_arr[list_idx]) { // sentinel of array is NULL
-        return NULL; // no completion done
+    exe_fuzzy_valid = true;
+    return &exe_fuzzy;
+}
+
+/// @brief rank a directory's entries against the name being completed, into file_fuzzy
+/// @return number of matches, best first in *ranked
+static size_t rank_entries(const dir_matches* all, const char* query, fuzzy_match** ranked) {
+    fuzzy_set_clear(&file_fuzzy);
+    for (size_t i = 0; i < all->count; ++i) {
+        fuzzy_set_add(&file_fuzzy, all->entries[i].name, all->entries[i].len);
+    }
+    *ranked = arena_alloc(&ac_scratch, file_fuzzy.count * sizeof(fuzzy_match));
+    return fuzzy_rank(&file_fuzzy, query, *ranked);
+}
+
+/// @brief the fuzzy matches among the commands best first
+static void print_exe_fuzzy(const char* text) {
+    const fuzzy_set* set = exe_fuzzy_set();
+    fuzzy_match* ranked = arena_alloc(&ac_scratch, set->count * sizeof(fuzzy_match));
+    size_t n = fuzzy_rank(set, text, ranked);
+    if (n == 0 || !confirm_display(n)) return;
+    for (size_t i = 0; i < n; ++i) {
+        fwrite(fuzzy_name(set, ranked[i].index), 1, ranked[i].len, stdout);
+        fputs("  ", stdout);
+    }
+    printf("\n");
+}
+
+/// @brief the fuzzy matches in dir best first, partial listings too
+static void display_file_fuzzy(const char* text, const char* dir, size_t dir_len) {
+    dir_matches all;
+    if (dir_fetch(dir, "", fileno(rl_instream), &ac_scratch, &all) == DIR_FETCH_CANCELLED) return;
+    fuzzy_match* ranked = NULL;
+    size_t n = rank_entries(&all, text + dir_len, &ranked);
+    if (n && confirm_display(n)) print_file_fuzzy(text, dir_len, ranked, n);
+}
+
+/// @brief the ranked names in file_fuzzy as they'd be completed, with the directory part as typed
+static void print_file_fuzzy(const char* text, size_t dir_len, const fuzzy_match* ranked, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        fwrite(text, 1, dir_len, stdout);
+        fwrite(fuzzy_name(&file_fuzzy, ranked[i].index), 1, ranked[i].len, stdout);
+        fputs("  ", stdout);
     }
-    return match_arr[list_idx++];
-}
\ No newline at end of file
+    printf("\n");
+}
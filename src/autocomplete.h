@@ -1,12 +1,16 @@
 #ifndef AUTOCOMPLETE_H
 #define AUTOCOMPLETE_H
 
+#include <stdbool.h>
+
 void init_ac_readline(void);
 void init_ac(void);
 void cleanup_ac(void);
 
 char **autocomplete(const char *text, int start, int end);
 
+extern bool ac_fuzzy; // `set -o fuzzy`, subsequence matches ranked fzf-style when nothing starts with the word
+
 extern const char* builtin_cmds[];
 
 #endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+Tiny helpers shared by the benchmark programs. Every result is printed as one JSON object per line
+so runs can be diffed or loaded into a spreadsheet.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/// @brief print one result line
+/// @param bench name of the benchmark
+/// @param variant implementation being measured, e.g. "radix" vs "legacy"
+/// @param n problem size
+/// @param ns total elapsed nanoseconds
+/// @param ops number of operations timed, used for ns_per_op
+/// @param bytes memory used, 0 if not measured
+static inline void bench_report(const char* bench, const char* variant, size_t n, uint64_t ns, size_t ops, size_t bytes) {
+    printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"n\":%zu,\"ns\":%llu,\"ns_per_op\":%.1f,\"bytes\":%zu}\n",
+           bench, variant, n, (unsigned long long) ns, ops ? (double) ns / (double) ops : 0.0, bytes);
+    fflush(stdout);
+}
+
+#endif
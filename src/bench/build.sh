@@ -0,0 +1,17 @@
+set -xe
+
+# benchmarks are built optimized and without ASan, separate from the debug shell in ../build.sh
+CFLAGS="-O2 -g -Wall -Werror -std=c17"
+
+cc $CFLAGS trie_bench.c ../prefixTree.c ../arena.c -o trie_bench
+cc $CFLAGS tokenize_bench.c ../tokenizer.c -o tokenize_bench
+cc $CFLAGS spawn_bench.c ../launch.c -o spawn_bench
+cc $CFLAGS history_bench.c ../historyFile.c ../historyList.c ../arena.c -o history_bench
+cc $CFLAGS search_bench.c ../historySearch.c ../historyExpand.c ../historyList.c ../prefixTree.c ../arena.c -o search_bench
+cc $CFLAGS path_bench.c synthPath.c ../dirReader.c ../pathScan.c ../autocomplete.c ../pathWatcher.c ../exeIndex.c ../dirFetch.c ../dirCache.c ../fuzzyMatch.c ../frecency.c ../pathCache.c ../prefixTree.c ../arena.c -o path_bench -pthread -lreadline -lm
+cc $CFLAGS glob_bench.c ../pathGlob.c ../dirReader.c ../tokenizer.c ../arena.c -o glob_bench
+cc $CFLAGS dir_bench.c ../dirReader.c ../dirFetch.c ../dirCache.c ../prefixTree.c ../arena.c -o dir_bench -pthread
+cc $CFLAGS e2e_bench.c synthPath.c ptyDrive.c ../dirReader.c -o e2e_bench -lutil
+
+# the shell itself for e2e_bench, the Makefile's release build
+make -C .. release RELEASE_OUT=bench/release_shell
@@ -0,0 +1,149 @@
+/*
+Listing one big directory: scandir() with alphasort, what populate_exe_tree() did, readdir(), what the path
+watcher and the completion listings did, and the getdents64 reader all three use now.
+dir_scan only walks the entries, exe_tree inserts every name into a trie like building the completion tree.
+tab_first is the first filename completion TAB in the directory and tab_cached the ones after it, "inline" with
+every stat and read on the calling thread, "worker" through dirFetch.c's thread, which gives up on the full
+listing at its deadline (bytes is 1 when the first TAB got only partial matches).
+
+usage: ./dir_bench [entries]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "bench.h"
+#include "../dirReader.h"
+#include "../prefixTree.h"
+#include "../dirFetch.h"
+
+#define DEFAULT_ENTRIES 100000
+#define REPEATS 20
+
+static size_t scan_scandir(const char* dir, trie* root);
+static size_t scan_readdir(const char* dir, trie* root);
+static size_t scan_dir_reader(const char* dir, trie* root);
+static void bench_tab(const char* dir, size_t entries);
+
+/// @return entries seen, each is inserted into root unless it's NULL
+static size_t scan_scandir(const char* dir, trie* root) {
+    struct dirent** list = NULL;
+    int n = scandir(dir, &list, NULL, alphasort);
+    for (int i = 0; i < n; ++i) {
+        if (root && strcmp(list[i]->d_name, ".") && strcmp(list[i]->d_name, "..")) trie_insert(root, list[i]->d_name);
+        free(list[i]);
+    }
+    free(list);
+    return n;
+}
+
+static size_t scan_readdir(const char* dir, trie* root) {
+    DIR* dp = opendir(dir);
+    size_t n = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dp))) {
+        if (root && strcmp(ent->d_name, ".") && strcmp(ent->d_name, "..")) trie_insert(root, ent->d_name);
+        ++n;
+    }
+    closedir(dp);
+    return n;
+}
+
+static size_t scan_dir_reader(const char* dir, trie* root) {
+    dir_reader r;
+    dir_reader_open(&r, dir);
+    size_t n = 0;
+    dir_ent* ent;
+    while ((ent = dir_reader_next(&r))) {
+        if (root) trie_insert(root, ent->d_name);
+        ++n;
+    }
+    dir_reader_close(&r);
+    return n;
+}
+
+static void bench_tab(const char* dir, size_t entries) {
+    char dir_slash[PATH_MAX];
+    snprintf(dir_slash, sizeof(dir_slash), "%s/", dir);
+    arena scratch;
+    arena_init(&scratch);
+    dir_matches matches;
+    char name[64];
+    for (int worker = 0; worker <= 1; ++worker) {
+        if (worker) dir_fetch_start();
+        uint64_t t0 = bench_now_ns();
+        dir_fetch_status status = dir_fetch(dir_slash, "exe_12", -1, &scratch, &matches);
+        snprintf(name, sizeof(name), "tab_first/%zu", entries);
+        bench_report(name, worker ? "worker" : "inline", entries, bench_now_ns() - t0, 1, status == DIR_FETCH_PARTIAL);
+        if (status == DIR_FETCH_PARTIAL) { // let the worker finish the listing
+            while (dir_fetch(dir_slash, "exe_12", -1, &scratch, &matches) == DIR_FETCH_PARTIAL) {}
+        }
+
+        t0 = bench_now_ns();
+        for (int r = 0; r < REPEATS; ++r) {
+            arena_reset(&scratch);
+            dir_fetch(dir_slash, "exe_12", -1, &scratch, &matches);
+        }
+        snprintf(name, sizeof(name), "tab_cached/%zu", entries);
+        bench_report(name, worker ? "worker" : "inline", entries, bench_now_ns() - t0, REPEATS, 0);
+        dir_fetch_stop(); // frees the cache too, so the worker starts cold
+    }
+    arena_free(&scratch);
+}
+
+int main(int argc, char* argv[]) {
+    size_t entries = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_ENTRIES;
+    char dir[] = "/tmp/cshell_bench_dir_XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char file[PATH_MAX];
+    for (size_t i = 0; i < entries; ++i) {
+        snprintf(file, sizeof(file), "%s/exe_%zu", dir, i);
+        close(open(file, O_WRONLY | O_CREAT, 0755));
+    }
+
+    struct {
+        const char* name;
+        size_t (*scan)(const char* dir, trie* root);
+    } variants[] = {{"scandir", scan_scandir}, {"readdir", scan_readdir}, {"getdents64", scan_dir_reader}};
+    char name[64];
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        variants[v].scan(dir, NULL); // page cache and dentries warm for everyone
+        snprintf(name, sizeof(name), "dir_scan/%zu", entries);
+        uint64_t t0 = bench_now_ns();
+        for (int r = 0; r < REPEATS; ++r) {
+            variants[v].scan(dir, NULL);
+        }
+        bench_report(name, variants[v].name, entries, bench_now_ns() - t0, REPEATS, 0);
+
+        snprintf(name, sizeof(name), "exe_tree/%zu", entries);
+        uint64_t ns = 0;
+        for (int r = 0; r < REPEATS; ++r) {
+            trie* root = trie_create();
+            uint64_t start = bench_now_ns();
+            variants[v].scan(dir, root);
+            ns += bench_now_ns() - start;
+            trie_free(root);
+        }
+        bench_report(name, variants[v].name, entries, ns, REPEATS, 0);
+    }
+
+    bench_tab(dir, entries);
+
+    for (size_t i = 0; i < entries; ++i) {
+        snprintf(file, sizeof(file), "%s/exe_%zu", dir, i);
+        unlink(file);
+    }
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+End to end timings of a whole shell binary, on synthetic PATH directories of 10k and 100k executables.
+
+cold_start is fork+exec until the first prompt shows on a pty, "scan" with no cached executable index,
+"cached" with the one the previous start left behind.
+pty_commands types N commands into an interactive shell one at a time, each sent when the prompt for it is
+back, like someone typing as fast as the shell allows: a builtin (echo) and an external command found in PATH.
+script runs N lines as a script file and as one -c string, with the output thrown away, and a builtin
+with a redirect and piped into an external command.
+
+The shell gets HISTFILE= so no history is read or written, and TERM=dumb so readline prints plain prompts.
+
+usage: ./e2e_bench [shell binary] [max entries]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "synthPath.h"
+#include "ptyDrive.h"
+
+#define DEFAULT_SHELL "./release_shell"
+#define DEFAULT_MAX_ENTRIES 100000
+#define STARTS 10
+#define PTY_COMMANDS 500
+#define SCRIPT_COMMANDS 5000
+#define SCRIPT_FORKING_COMMANDS 500 // for scripts where every line could start a process
+
+static const char* shell = DEFAULT_SHELL;
+
+static void bench_cold_start(synth_path* sp);
+static void bench_pty_commands(size_t entries, const char* variant, const char* cmd);
+static uint64_t time_script(const char* script, bool as_string);
+static char* repeat_line(const char* line, size_t count);
+static void bench_script(size_t entries);
+static void run(size_t entries);
+
+static void bench_cold_start(synth_path* sp) {
+    char name[64];
+    snprintf(name, sizeof(name), "cold_start/%zu", sp->entries);
+    for (int cached = 0; cached <= 1; ++cached) {
+        uint64_t total = 0;
+        for (int i = 0; i < STARTS; ++i) {
+            if (!cached) synth_path_clear_cache(sp);
+            int master;
+            uint64_t t0 = bench_now_ns();
+            pid_t pid = pty_shell_start(shell, &master);
+            pty_wait_prompts(master, 1);
+            total += bench_now_ns() - t0;
+            pty_shell_stop(pid, master);
+        }
+        bench_report(name, cached ? "cached" : "scan", sp->entries, total, STARTS, 0);
+    }
+}
+
+static void bench_pty_commands(size_t entries, const char* variant, const char* cmd) {
+    char name[64];
+    snprintf(name, sizeof(name), "pty_commands/%zu", entries);
+    int master;
+    pid_t pid = pty_shell_start(shell, &master);
+    pty_wait_prompts(master, 1);
+
+    uint64_t t0 = bench_now_ns();
+    for (size_t i = 0; i < PTY_COMMANDS; ++i) {
+        pty_send(master, cmd);
+        pty_wait_prompts(master, 1);
+    }
+    bench_report(name, variant, entries, bench_now_ns() - t0, PTY_COMMANDS, 0);
+    pty_shell_stop(pid, master);
+}
+
+/// @brief run a script as a file, or as -c, with the output thrown away
+/// @return elapsed nanoseconds
+static uint64_t time_script(const char* script, bool as_string) {
+    char file[] = "/tmp/cshell_bench_script_XXXXXX";
+    size_t len = strlen(script);
+    int fd = mkstemp(file);
+    if (fd == -1 || write(fd, script, len) != (ssize_t) len) {
+        perror(file);
+        exit(1);
+    }
+    close(fd);
+
+    uint64_t t0 = bench_now_ns();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_RDWR);
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDOUT_FILENO);
+        if (as_string) {
+            execl(shell, shell, "-c", script, (char*) NULL);
+        } else {
+            execl(shell, shell, file, (char*) NULL);
+        }
+        perror(shell);
+        _exit(127);
+    }
+    waitpid(pid, NULL, 0);
+    uint64_t ns = bench_now_ns() - t0;
+    unlink(file);
+    return ns;
+}
+
+/// @brief script of count copies of line
+/// @return malloc'd script
+static char* repeat_line(const char* line, size_t count) {
+    size_t line_len = strlen(line);
+    char* script = malloc(line_len * count + 1);
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(script + i * line_len, line, line_len);
+    }
+    script[line_len * count] = '\0';
+    return script;
+}
+
+/// @brief SCRIPT_COMMANDS lines of a builtin and an external command, as a file and as -c,
+/// then builtins with a redirect and at the start of a pipeline, which used to cost a fork each
+static void bench_script(size_t entries) {
+    char name[64];
+    snprintf(name, sizeof(name), "script/%zu", entries);
+    char* script = malloc(SCRIPT_COMMANDS * 8 + 1);
+    size_t len = 0;
+    for (size_t i = 0; i < SCRIPT_COMMANDS; ++i) {
+        len += sprintf(script + len, i % 10 ? "echo x\n" : "true\n"); // every tenth one forks
+    }
+    bench_report(name, "file", entries, time_script(script, false), SCRIPT_COMMANDS, 0);
+    bench_report(name, "dash_c", entries, time_script(script, true), SCRIPT_COMMANDS, 0);
+    free(script);
+
+    script = repeat_line("echo x > /dev/null\n", SCRIPT_FORKING_COMMANDS);
+    bench_report(name, "builtin_redirect", entries, time_script(script, false), SCRIPT_FORKING_COMMANDS, 0);
+    free(script);
+    script = repeat_line("type echo | true\n", SCRIPT_FORKING_COMMANDS);
+    bench_report(name, "builtin_pipe", entries, time_script(script, false), SCRIPT_FORKING_COMMANDS, 0);
+    free(script);
+}
+
+static void run(size_t entries) {
+    synth_path sp;
+    if (synth_path_create(&sp, entries)) exit(1);
+    setenv("PATH", sp.path, 1);
+    setenv("XDG_CACHE_HOME", sp.cache, 1);
+
+    bench_cold_start(&sp);
+    bench_pty_commands(entries, "builtin", "echo x\n");
+    bench_pty_commands(entries, "external", "true\n");
+    bench_script(entries);
+    synth_path_destroy(&sp);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) shell = argv[1];
+    size_t max_entries = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_MAX_ENTRIES;
+    if (access(shell, X_OK)) {
+        perror(shell);
+        return 1;
+    }
+    setenv("TERM", "dumb", 1);
+    setenv("HISTFILE", "", 1);
+    char* real_path = getenv("PATH") ? strdup(getenv("PATH")) : NULL;
+    for (size_t n = 10000; n <= max_entries; n *= 10) {
+        run(n);
+        if (real_path) setenv("PATH", real_path, 1); // synth_path_create appends the PATH it finds
+    }
+    free(real_path);
+    return 0;
+}
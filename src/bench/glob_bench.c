@@ -0,0 +1,138 @@
+/*
+Pathname expansion of pathGlob.c against glob(3), on a directory of many files.
+
+glob_suffix is `*.log` (half of the files match), glob_prefix `f12*` and glob_class `f[0-4]?[13579].txt`,
+"path_glob" against glibc's glob(), which also sorts. glob(3) has no `**`, so globstar matches `*.c` under `**`
+in a two level tree holding as many files, against nftw() with fnmatch() on every name, unsorted.
+bytes is the number of matches, the same for both variants.
+
+usage: ./glob_bench [entries]
+*/
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700 // nftw
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <glob.h>
+#include <fnmatch.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "bench.h"
+#include "../pathGlob.h"
+
+#define DEFAULT_ENTRIES 100000
+#define REPEATS 10
+#define TREE_FANOUT 10 // directories per level, two levels
+
+static size_t run_path_glob(const char* pattern);
+static size_t run_glob3(const char* pattern);
+static size_t run_nftw(const char* pattern);
+static int count_match(const char* path, const struct stat* st, int type, struct FTW* ftw);
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw);
+
+static size_t nftw_matches = 0;
+
+static size_t run_path_glob(const char* pattern) {
+    path_glob g;
+    glob_matches m = {0};
+    size_t n = 0;
+    if (path_glob_compile(&g, pattern) == 0) n = path_glob_expand(&g, &m);
+    path_glob_free(&g);
+    glob_matches_free(&m);
+    return n;
+}
+
+static size_t run_glob3(const char* pattern) {
+    glob_t g;
+    size_t n = glob(pattern, 0, NULL, &g) == 0 ? g.gl_pathc : 0;
+    globfree(&g);
+    return n;
+}
+
+/// @brief `*.c` anywhere under tree/, the way a shell without globstar support would have to do it
+static size_t run_nftw(const char* pattern) {
+    (void) pattern;
+    nftw_matches = 0;
+    nftw("tree", count_match, 32, FTW_PHYS);
+    return nftw_matches;
+}
+
+static int count_match(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void) st;
+    if (type == FTW_F && fnmatch("*.c", path + ftw->base, FNM_PERIOD) == 0) ++nftw_matches;
+    return 0;
+}
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void) st;
+    (void) type;
+    (void) ftw;
+    return remove(path);
+}
+
+int main(int argc, char* argv[]) {
+    size_t entries = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_ENTRIES;
+    char dir[] = "/tmp/cshell_bench_glob_XXXXXX";
+    if (mkdtemp(dir) == NULL || chdir(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char file[PATH_MAX];
+    mkdir("flat", 0755);
+    for (size_t i = 0; i < entries; ++i) {
+        snprintf(file, sizeof(file), "flat/f%zu.%s", i, i % 2 ? "txt" : "log");
+        close(open(file, O_WRONLY | O_CREAT, 0644));
+    }
+    mkdir("tree", 0755);
+    size_t per_dir = entries / (TREE_FANOUT * TREE_FANOUT);
+    for (int a = 0; a < TREE_FANOUT; ++a) {
+        snprintf(file, sizeof(file), "tree/d%d", a);
+        mkdir(file, 0755);
+        for (int b = 0; b < TREE_FANOUT; ++b) {
+            snprintf(file, sizeof(file), "tree/d%d/d%d", a, b);
+            mkdir(file, 0755);
+            for (size_t i = 0; i < per_dir; ++i) {
+                snprintf(file, sizeof(file), "tree/d%d/d%d/g%zu.%s", a, b, i, i % 2 ? "h" : "c");
+                close(open(file, O_WRONLY | O_CREAT, 0644));
+            }
+        }
+    }
+
+    struct {
+        const char* bench;
+        const char* pattern;
+        const char* baseline;
+        size_t (*run_baseline)(const char* pattern);
+    } cases[] = {
+        {"glob_suffix", "flat/*.log", "glob3", run_glob3},
+        {"glob_prefix", "flat/f12*", "glob3", run_glob3},
+        {"glob_class", "flat/f[0-4]?[13579].txt", "glob3", run_glob3},
+        {"globstar", "tree/**/*.c", "nftw_fnmatch", run_nftw},
+    };
+    char name[64];
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        snprintf(name, sizeof(name), "%s/%zu", cases[c].bench, entries);
+        struct {
+            const char* name;
+            size_t (*run)(const char* pattern);
+        } variants[] = {{"path_glob", run_path_glob}, {cases[c].baseline, cases[c].run_baseline}};
+        for (size_t v = 0; v < 2; ++v) {
+            size_t matches = variants[v].run(cases[c].pattern); // warm
+            uint64_t t0 = bench_now_ns();
+            for (int r = 0; r < REPEATS; ++r) {
+                variants[v].run(cases[c].pattern);
+            }
+            bench_report(name, variants[v].name, entries, bench_now_ns() - t0, REPEATS, matches);
+        }
+    }
+
+    if (chdir("/") == 0) nftw(dir, remove_entry, 32, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
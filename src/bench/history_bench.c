@@ -0,0 +1,113 @@
+/*
+Loading and appending to the persistent history file at up to a million entries.
+
+"getline" is what loading line by line would cost: getline() into add_history_entry(), a malloc and
+strdup per entry. "mmap" is history_file_open() with HISTSIZE as big as the file, which maps it and copies
+every line into the history's arena, "mmap_histsize_default" keeps only the last HISTORY_DEFAULT_SIZE.
+Appends are timed against the full file, one O_APPEND write per entry. history_add pushes n commands
+through a HISTORY_DEFAULT_SIZE ring and reports the memory it ends up with.
+
+usage: ./history_bench [max entries]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "bench.h"
+#include "../historyList.h"
+#include "../historyFile.h"
+
+#define DEFAULT_MAX_ENTRIES 1000000
+#define APPENDS 10000
+
+history_list* history = NULL; // normally history.c's, historyFile.c uses it for history -n/-r
+
+static void write_history(const char* path, size_t n) {
+    FILE* f = fopen(path, "w");
+    for (size_t i = 0; i < n; ++i) {
+        fprintf(f, "git commit -m \"change number %zu\" --author=someone%zu\n", i, i % 97);
+    }
+    fclose(f);
+}
+
+static void run(const char* path, size_t n) {
+    char name[64];
+    write_history(path, n);
+
+    uint64_t t0 = bench_now_ns();
+    history_list* h = create_history_list(n);
+    FILE* f = fopen(path, "r");
+    char* line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &cap, f)) != -1) {
+        if (len && line[len - 1] == '\n') line[len - 1] = '\0';
+        if (*line) add_history_entry(h, line);
+    }
+    free(line);
+    fclose(f);
+    snprintf(name, sizeof(name), "history_load/%zu", n);
+    bench_report(name, "getline", n, bench_now_ns() - t0, n, 0);
+    free_history_list(h);
+    free(h);
+
+    t0 = bench_now_ns();
+    h = create_history_list(HISTORY_DEFAULT_SIZE);
+    history_file_open(h);
+    bench_report(name, "mmap_histsize_default", n, bench_now_ns() - t0, n, h->strings.bytes);
+    history_file_close();
+    free_history_list(h);
+    free(h);
+
+    t0 = bench_now_ns();
+    h = create_history_list(n);
+    history_file_open(h);
+    bench_report(name, "mmap", h->len, bench_now_ns() - t0, h->len, h->strings.bytes);
+
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < APPENDS; ++i) {
+        history_file_append("make -j8 && ./shell");
+    }
+    snprintf(name, sizeof(name), "history_append/%zu", n);
+    bench_report(name, "o_append", n, bench_now_ns() - t0, APPENDS, 0);
+
+    history_file_close();
+    free_history_list(h);
+    free(h);
+
+    // a long session: memory stays at what HISTSIZE entries need however many commands go through
+    h = create_history_list(HISTORY_DEFAULT_SIZE);
+    char cmd[64];
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(cmd, sizeof(cmd), "ls -la /some/dir/%zu", i);
+        add_history_entry(h, cmd);
+    }
+    snprintf(name, sizeof(name), "history_add/%zu", n);
+    bench_report(name, "ring", n, bench_now_ns() - t0, n, h->strings.bytes + h->cap * sizeof(char*));
+    free_history_list(h);
+    free(h);
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_entries = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_MAX_ENTRIES;
+    char path[] = "/tmp/history_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    setenv("HISTFILE", path, 1);
+
+    for (size_t n = 1000; n <= max_entries; n *= 10) {
+        run(path, n);
+    }
+    unlink(path);
+    return 0;
+}
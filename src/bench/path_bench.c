@@ -0,0 +1,206 @@
+/*
+Startup and PATH costs against the number of executables in PATH, on synthetic PATH directories.
+
+init_ac is the completion setup an interactive shell does before its first prompt: "scan" with no cached index
+(every PATH directory is read and inserted into the trie), "cached" with the index the scan just saved.
+path_scan is just the reading and inserting: "serial", one directory after another like the shell used to,
+against "pool", the worker threads of pathScan.c with the main thread merging sorted batches.
+tab_complete walks to a prefix and lists every executable under it, the work of a double TAB, "trie_iter" in
+byte order, "frecency" with a hundred of them run before and listed first (a score lookup per name, two walks).
+fuzzy_rank is a `set -o fuzzy` TAB over every executable, "miss" for a query nothing matches (the SIMD scan
+alone), "hit" for one a tenth of the names match, ranked.
+path_lookup is a command name resolved through PATH with an empty hash table ("miss"),
+then found in it ("hit"), for a name in the last PATH directory.
+
+usage: ./path_bench [max entries]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "synthPath.h"
+#include "../autocomplete.h"
+#include "../pathScan.h"
+#include "../dirReader.h"
+#include "../pathCache.h"
+#include "../prefixTree.h"
+#include "../fuzzyMatch.h"
+#include "../frecency.h"
+
+#define DEFAULT_MAX_ENTRIES 100000
+#define LOOKUPS 1000
+#define TABS 100
+#define SCANS 10
+#define FUZZY_TABS 20
+
+static trie* scan_serial(const char* path);
+static trie* scan_pool(const char* path);
+
+extern trie* exe_tree_root;
+
+/// @brief what populate_exe_tree() did
+static trie* scan_serial(const char* path) {
+    trie* root = trie_create();
+    char* path_copy = strdup(path);
+    for (char* dir = strtok(path_copy, ":"); dir; dir = strtok(NULL, ":")) {
+        dir_reader r;
+        if (dir_reader_open(&r, dir)) continue;
+        dir_ent* ent;
+        while ((ent = dir_reader_next(&r))) {
+            if (ent->d_type != DT_DIR) trie_insert(root, ent->d_name);
+        }
+        dir_reader_close(&r);
+    }
+    free(path_copy);
+    return root;
+}
+
+static trie* scan_pool(const char* path) {
+    trie* root = trie_create();
+    path_scan* scan = path_scan_start(path, 0);
+    size_t key_len = 0;
+    free(path_scan_index_key(scan, &key_len));
+    path_scan_merge(scan, root);
+    path_scan_finish(scan);
+    return root;
+}
+
+static void run(size_t entries) {
+    char name[64];
+    synth_path sp;
+    if (synth_path_create(&sp, entries)) exit(1);
+    setenv("PATH", sp.path, 1);
+    setenv("XDG_CACHE_HOME", sp.cache, 1);
+
+    synth_path_clear_cache(&sp);
+    uint64_t t0 = bench_now_ns();
+    init_ac();
+    snprintf(name, sizeof(name), "init_ac/%zu", entries);
+    bench_report(name, "scan", entries, bench_now_ns() - t0, 1, trie_mem_usage(exe_tree_root));
+    cleanup_ac();
+
+    struct {
+        const char* name;
+        trie* (*scan)(const char* path);
+    } variants[] = {{"serial", scan_serial}, {"pool", scan_pool}};
+    snprintf(name, sizeof(name), "path_scan/%zu", entries);
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        t0 = bench_now_ns();
+        for (int i = 0; i < SCANS; ++i) {
+            trie_free(variants[v].scan(sp.path));
+        }
+        bench_report(name, variants[v].name, entries, bench_now_ns() - t0, SCANS, 0);
+    }
+
+    snprintf(name, sizeof(name), "init_ac/%zu", entries);
+    t0 = bench_now_ns();
+    init_ac();
+    bench_report(name, "cached", entries, bench_now_ns() - t0, 1, trie_mem_usage(exe_tree_root));
+
+    // cmd9_9.. lists every tenth entry of the last directory that starts with 9
+    trie_type type = {0};
+    size_t listed = 0;
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < TABS; ++i) {
+        type.autocomplete_buf_sz = 0;
+        trie* subtree = get_prefix_subtree(exe_tree_root, "cmd9_9", &type);
+        trie_iter it;
+        trie_iter_init(&it, subtree, &type);
+        while (trie_iter_next(&it)) {
+            ++listed;
+        }
+    }
+    snprintf(name, sizeof(name), "tab_complete/%zu", entries);
+    bench_report(name, "trie_iter", listed / TABS, bench_now_ns() - t0, TABS, 0);
+
+    setenv("HOME", sp.cache, 1); // the store is saved there, and removed with it
+    frecency_open();
+    type.autocomplete_buf_sz = 0;
+    trie* subtree = get_prefix_subtree(exe_tree_root, "cmd9_9", &type);
+    trie_iter it;
+    trie_iter_init(&it, subtree, &type);
+    for (int i = 0; i < 100 && trie_iter_next(&it); ++i) {
+        type.autocomplete_buf[type.autocomplete_buf_sz] = '\0';
+        for (int k = 0; k <= i % 5; ++k) {
+            frecency_add(type.autocomplete_buf);
+        }
+    }
+    listed = 0;
+    size_t ranked_cmds = 0;
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < TABS; ++i) {
+        for (int pass = 0; pass < 2; ++pass) {
+            type.autocomplete_buf_sz = 0;
+            subtree = get_prefix_subtree(exe_tree_root, "cmd9_9", &type);
+            trie_iter_init(&it, subtree, &type);
+            while (trie_iter_next(&it)) {
+                bool run_before = frecency_score(type.autocomplete_buf, type.autocomplete_buf_sz) > 0;
+                if (pass == 0 && run_before) ++ranked_cmds;
+                if (pass == 1 && !run_before) ++listed;
+            }
+        }
+    }
+    bench_report(name, "frecency", (listed + ranked_cmds) / TABS, bench_now_ns() - t0, TABS, 0);
+    frecency_close();
+
+    fuzzy_set set;
+    fuzzy_set_init(&set);
+    type.autocomplete_buf_sz = 0;
+    trie_iter_init(&it, exe_tree_root, &type);
+    while (trie_iter_next(&it)) {
+        fuzzy_set_add(&set, type.autocomplete_buf, type.autocomplete_buf_sz);
+    }
+    fuzzy_match* ranked = malloc(set.count * sizeof(fuzzy_match));
+    struct {
+        const char* variant;
+        const char* query;
+    } queries[] = {{"miss", "zqx"}, {"hit", "c99"}};
+    snprintf(name, sizeof(name), "fuzzy_rank/%zu", entries);
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); ++q) {
+        size_t found = 0;
+        t0 = bench_now_ns();
+        for (int i = 0; i < FUZZY_TABS; ++i) {
+            found = fuzzy_rank(&set, queries[q].query, ranked);
+        }
+        bench_report(name, queries[q].variant, found, bench_now_ns() - t0, FUZZY_TABS, set.names_cap);
+    }
+    free(ranked);
+    fuzzy_set_free(&set);
+    cleanup_ac();
+
+    char cmd[64];
+    char* exe_path = NULL;
+    snprintf(cmd, sizeof(cmd), "cmd%d_%zu", SYNTH_PATH_DIRS - 1, entries - 1);
+    snprintf(name, sizeof(name), "path_lookup/%zu", entries);
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        path_cache_reset();
+        path_cache_lookup(cmd, &exe_path);
+        free(exe_path);
+    }
+    bench_report(name, "miss", entries, bench_now_ns() - t0, LOOKUPS, 0);
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        path_cache_lookup(cmd, &exe_path);
+        free(exe_path);
+    }
+    bench_report(name, "hit", entries, bench_now_ns() - t0, LOOKUPS, 0);
+    path_cache_free();
+
+    synth_path_destroy(&sp);
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_entries = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_MAX_ENTRIES;
+    char* real_path = getenv("PATH") ? strdup(getenv("PATH")) : NULL;
+    for (size_t n = 10000; n <= max_entries; n *= 10) {
+        run(n);
+        if (real_path) setenv("PATH", real_path, 1); // synth_path_create appends the PATH it finds
+    }
+    free(real_path);
+    return 0;
+}
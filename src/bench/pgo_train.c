@@ -0,0 +1,168 @@
+/*
+Training workload for `make pgo`: runs an instrumented shell through what it does most, so the profile
+reflects real use rather than whatever the benchmarks happen to stress.
+
+Interactive, on a pty with 10k executables in PATH and a few thousand lines of history: typing commands with
+quotes, variables and pipelines, TAB completion of commands and filenames, Ctrl-R, history expansion and the builtins.
+Scripted: the same kind of lines run as a script file, as -c and from piped stdin.
+
+Each interactive step is followed by a command whose output can't appear in its own echo, and the next
+step waits for that output, so TAB listings and search redraws don't have to be counted.
+
+usage: ./pgo_train <shell binary>
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "synthPath.h"
+#include "ptyDrive.h"
+
+#define TRAIN_ENTRIES 10000
+#define TRAIN_HISTORY 5000
+#define INTERACTIVE_ROUNDS 20
+#define SCRIPT_ROUNDS 200
+
+#define SYNC_INPUT "\x15" "echo 'sy''nc'\n" // Ctrl-U first drops whatever a step left on the line
+#define SYNC_OUTPUT "sync\r\n"
+
+static const char* interactive_steps[] = {
+    "echo hello world | cat | wc -c\n",
+    "echo \"quoted $HOME\" 'single $HOME' a\\ b \"$?\" ${HOME}\n",
+    "export TRAIN_VAR=value\n",
+    "echo $TRAIN_VAR $UNSET_VAR done > /dev/null\n",
+    "cmd9_99\t\t",              // a short listing of executables
+    "cmd3_12\t",                 // completes as far as it's unique
+    "ec\t hi\n",                 // builtin completion
+    "ls /us\t\t",                // filename completion
+    "cat /etc/host\t",
+    "\x12" "make\x12\x12\x07",   // Ctrl-R, cycling through matches, then Ctrl-G
+    "\x12" "git st\n",           // Ctrl-R, running the match
+    "!!\n",
+    "!ech\n",
+    "^hello^bye^\n",
+    "hash\n",
+    "type echo cat cmd9_9999\n",
+    "history 20 > /dev/null\n",
+    "pwd\n",
+    "true | true 2> /dev/null\n",
+    "\x1b[A\x1b[A\x1b[B\x15",    // up, up, down
+};
+
+static const char* script_lines[] = {
+    "echo plain words here",
+    "echo \"double $HOME quoted\" 'single quoted' back\\ slash",
+    "export SCRIPT_VAR=abc",
+    "echo $SCRIPT_VAR ${SCRIPT_VAR} $? $UNSET # trailing comment",
+    "echo one two three | cat > /dev/null",
+    "echo appended >> /dev/null",
+    "wc -c <<< \"here string\" 2>&1 > /dev/null",
+    "type echo",
+    "pwd > /dev/null",
+    "cd /tmp",
+    "cd -",
+    "true",
+};
+
+static void write_history(const char* file);
+static void train_interactive(const char* shell);
+static void train_scripts(const char* shell);
+
+/// @brief TRAIN_HISTORY lines the Ctrl-R and !prefix steps can find
+static void write_history(const char* file) {
+    static const char* commands[] = {"git status", "git commit -m fix", "make release", "ls -la", "cd ..", "echo hi"};
+    size_t num_commands = sizeof(commands) / sizeof(commands[0]);
+    FILE* fp = fopen(file, "w");
+    if (fp == NULL) {
+        perror(file);
+        exit(1);
+    }
+    for (size_t i = 0; i < TRAIN_HISTORY; ++i) {
+        fprintf(fp, "%s %zu\n", commands[i % num_commands], i);
+    }
+    fclose(fp);
+}
+
+static void train_interactive(const char* shell) {
+    size_t num_steps = sizeof(interactive_steps) / sizeof(interactive_steps[0]);
+    int master;
+    pid_t pid = pty_shell_start(shell, &master);
+    pty_wait_prompts(master, 1);
+    for (size_t round = 0; round < INTERACTIVE_ROUNDS; ++round) {
+        for (size_t i = 0; i < num_steps; ++i) {
+            pty_send(master, interactive_steps[i]);
+            pty_send(master, SYNC_INPUT);
+            pty_wait_output(master, SYNC_OUTPUT, 1);
+        }
+    }
+    pty_shell_stop(pid, master);
+}
+
+/// @brief SCRIPT_ROUNDS copies of script_lines as a file, as -c and as piped stdin
+static void train_scripts(const char* shell) {
+    size_t num_lines = sizeof(script_lines) / sizeof(script_lines[0]);
+    char file[] = "/tmp/cshell_pgo_script_XXXXXX";
+    int fd = mkstemp(file);
+    if (fd == -1) {
+        perror(file);
+        exit(1);
+    }
+    FILE* fp = fdopen(fd, "w+");
+    for (size_t round = 0; round < SCRIPT_ROUNDS; ++round) {
+        for (size_t i = 0; i < num_lines; ++i) {
+            fprintf(fp, "%s\n", script_lines[i]);
+        }
+    }
+    fflush(fp);
+    size_t len = ftell(fp);
+    char* script = malloc(len + 1);
+    rewind(fp);
+    script[fread(script, 1, len, fp)] = '\0';
+    fclose(fp);
+
+    for (int how = 0; how < 3; ++how) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int in = open(how == 2 ? file : "/dev/null", O_RDONLY);
+            int null = open("/dev/null", O_WRONLY);
+            dup2(in, STDIN_FILENO);
+            dup2(null, STDOUT_FILENO);
+            if (how == 0) execl(shell, shell, file, (char*) NULL);
+            if (how == 1) execl(shell, shell, "-c", script, (char*) NULL);
+            if (how == 2) execl(shell, shell, (char*) NULL);
+            perror(shell);
+            _exit(127);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    unlink(file);
+    free(script);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <shell binary>\n", argv[0]);
+        return 1;
+    }
+    synth_path sp;
+    if (synth_path_create(&sp, TRAIN_ENTRIES)) return 1;
+    char histfile[sizeof(sp.root) + 16];
+    snprintf(histfile, sizeof(histfile), "%s/history", sp.root);
+    write_history(histfile);
+    setenv("PATH", sp.path, 1);
+    setenv("XDG_CACHE_HOME", sp.cache, 1);
+    setenv("HISTFILE", histfile, 1);
+    setenv("TERM", "dumb", 1);
+
+    train_interactive(argv[1]); // with no cached index, so the PATH scan is trained too
+    train_interactive(argv[1]);
+    train_scripts(argv[1]);
+    synth_path_destroy(&sp);
+    return 0;
+}
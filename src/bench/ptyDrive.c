@@ -0,0 +1,87 @@
+/*
+Runs a shell interactively on a pty for the benchmarks and the PGO training run, and waits for its prompts,
+which is how a terminal user knows the previous command is done.
+*/
+
+#define _GNU_SOURCE // memmem
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pty.h>
+#include <sys/wait.h>
+
+#include "ptyDrive.h"
+
+/// @brief fork shell onto a new pty, it is interactive since its stdin is a terminal
+/// @param master set to our end of the pty
+/// @return pid of the shell
+pid_t pty_shell_start(const char* shell, int* master) {
+    pid_t pid = forkpty(master, NULL, NULL, NULL);
+    if (pid == -1) {
+        perror("forkpty");
+        exit(1);
+    }
+    if (pid == 0) {
+        execl(shell, shell, (char*) NULL);
+        perror(shell);
+        _exit(127);
+    }
+    return pid;
+}
+
+/// @brief type input into the shell, all of it
+void pty_send(int master, const char* input) {
+    size_t len = strlen(input);
+    while (len) {
+        ssize_t n = write(master, input, len);
+        if (n <= 0) {
+            perror("write");
+            exit(1);
+        }
+        input += n;
+        len -= n;
+    }
+}
+
+/// @brief read the pty until needle was printed count more times
+void pty_wait_output(int master, const char* needle, size_t count) {
+    size_t needle_len = strlen(needle);
+    char buf[4096 + PTY_NEEDLE_CAP];
+    size_t kept = 0; // tail of the previous read, a needle can be split across two
+    while (count) {
+        struct pollfd pfd = {.fd = master, .events = POLLIN};
+        if (poll(&pfd, 1, PTY_PROMPT_TIMEOUT_MS) != 1) {
+            fprintf(stderr, "no \"%s\" after %d ms\n", needle, PTY_PROMPT_TIMEOUT_MS);
+            exit(1);
+        }
+        ssize_t n = read(master, buf + kept, sizeof(buf) - kept);
+        if (n <= 0) {
+            fprintf(stderr, "the shell exited before printing \"%s\"\n", needle);
+            exit(1);
+        }
+        size_t len = kept + n;
+        char* p = buf;
+        char* found;
+        while (count && (found = memmem(p, buf + len - p, needle, needle_len))) {
+            --count;
+            p = found + needle_len;
+        }
+        kept = buf + len - p < (ptrdiff_t) needle_len ? (size_t) (buf + len - p) : needle_len - 1;
+        memmove(buf, buf + len - kept, kept);
+    }
+}
+
+/// @brief read the pty until count more prompts were printed
+void pty_wait_prompts(int master, size_t count) {
+    pty_wait_output(master, PTY_PROMPT, count);
+}
+
+void pty_shell_stop(pid_t pid, int master) {
+    pty_send(master, "exit\n");
+    waitpid(pid, NULL, 0);
+    close(master);
+}
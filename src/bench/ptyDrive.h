@@ -0,0 +1,17 @@
+#ifndef PTYDRIVE_H
+#define PTYDRIVE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define PTY_PROMPT "$ "
+#define PTY_PROMPT_TIMEOUT_MS 10000
+#define PTY_NEEDLE_CAP 64 // longest string pty_wait_output() can wait for
+
+pid_t pty_shell_start(const char* shell, int* master);
+void  pty_send(int master, const char* input);
+void  pty_wait_output(int master, const char* needle, size_t count);
+void  pty_wait_prompts(int master, size_t count);
+void  pty_shell_stop(pid_t pid, int master);
+
+#endif
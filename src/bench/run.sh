@@ -0,0 +1,9 @@
+set -e
+
+# builds every benchmark and runs them all, one JSON object per result line on stdout
+cd "$(dirname "$0")"
+sh build.sh 2>/dev/null
+for b in trie_bench tokenize_bench spawn_bench history_bench search_bench path_bench dir_bench glob_bench; do
+    ./$b
+done
+./e2e_bench ./release_shell
@@ -0,0 +1,118 @@
+/*
+Ctrl-R query and !prefix expansion latency on a history of up to a million entries.
+
+"trigram" is history_search() with its index already built, "scan" is what searching without an index costs:
+strstr on every entry from the newest back. Building the index from scratch is reported as index_build,
+which is what the first Ctrl-R after loading a full history pays.
+!prefix goes through history_expand()'s prefix trie, against scanning back for the newest entry with the prefix.
+
+usage: ./search_bench [max entries]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../historyList.h"
+#include "../historySearch.h"
+#include "../historyExpand.h"
+
+#define DEFAULT_MAX_ENTRIES 1000000
+#define QUERY_REPEATS 20
+
+static const char* prefixes[] = {"git", "ssh build1999", "true", NULL}; // "true" is only the very first entry
+static const char* queries[] = {"gi", "make -j", "ssh build42", "fix 777", "nothing like this", NULL};
+
+/// @brief a mix of commands where about half the entries repeat an earlier one
+static void fill_history(history_list* h, size_t n) {
+    char cmd[128];
+    unsigned int seed = 1;
+    add_history_entry(h, "true");
+    for (size_t i = 1; i < n; ++i) {
+        unsigned int r = rand_r(&seed);
+        size_t k = (r >> 4) % (i / 2 + 10);
+        switch (r % 6) {
+            case 0: snprintf(cmd, sizeof(cmd), "git commit -m \"fix %zu\"", k); break;
+            case 1: snprintf(cmd, sizeof(cmd), "cd ~/src/project%zu/module", k % 5000); break;
+            case 2: snprintf(cmd, sizeof(cmd), "make -j%zu target%zu", k % 16, k % 300); break;
+            case 3: snprintf(cmd, sizeof(cmd), "ssh build%zu.example.com uptime", k % 2000); break;
+            case 4: snprintf(cmd, sizeof(cmd), "grep -rn pattern%zu src/", k); break;
+            default: snprintf(cmd, sizeof(cmd), "git status"); break;
+        }
+        add_history_entry(h, cmd);
+    }
+}
+
+static void run(size_t n) {
+    char name[96];
+    history_list* h = create_history_list(n);
+    fill_history(h, n);
+
+    uint64_t t0 = bench_now_ns();
+    history_search_sync(h);
+    snprintf(name, sizeof(name), "index_build/%zu", n);
+    bench_report(name, "trigram", n, bench_now_ns() - t0, n, 0);
+
+    search_result results[SEARCH_MAX_RESULTS];
+    for (size_t q = 0; queries[q]; ++q) {
+        snprintf(name, sizeof(name), "search/%zu/%s", n, queries[q]);
+        size_t found = 0;
+        t0 = bench_now_ns();
+        for (size_t r = 0; r < QUERY_REPEATS; ++r) {
+            found = history_search(h, queries[q], results);
+        }
+        bench_report(name, "trigram", found, bench_now_ns() - t0, QUERY_REPEATS, 0);
+
+        t0 = bench_now_ns();
+        for (size_t r = 0; r < QUERY_REPEATS; ++r) {
+            found = 0;
+            for (size_t i = h->len; i-- > 0; ) {
+                if (strstr(history_at(h, i), queries[q])) ++found;
+            }
+        }
+        bench_report(name, "scan", found, bench_now_ns() - t0, QUERY_REPEATS, 0);
+    }
+    char* expanded = NULL;
+    history_expand(h, "!true", &expanded); // builds the prefix trie
+    free(expanded);
+    for (size_t q = 0; prefixes[q]; ++q) {
+        char line[64];
+        snprintf(line, sizeof(line), "!%s", prefixes[q]);
+        snprintf(name, sizeof(name), "expand/%zu/%s", n, prefixes[q]);
+        t0 = bench_now_ns();
+        for (size_t r = 0; r < QUERY_REPEATS; ++r) {
+            if (history_expand(h, line, &expanded) > 0) free(expanded);
+        }
+        bench_report(name, "trie", n, bench_now_ns() - t0, QUERY_REPEATS, 0);
+
+        size_t len = strlen(prefixes[q]);
+        volatile size_t newest = 0; // keeps the scan from being optimized out
+        t0 = bench_now_ns();
+        for (size_t r = 0; r < QUERY_REPEATS; ++r) {
+            for (size_t i = h->len; i-- > 0; ) {
+                if (!strncmp(history_at(h, i), prefixes[q], len)) {
+                    newest = i;
+                    break;
+                }
+            }
+        }
+        bench_report(name, "scan", n, bench_now_ns() - t0, QUERY_REPEATS, 0);
+        (void) newest;
+    }
+
+    history_expand_free();
+    history_search_free();
+    free_history_list(h);
+    free(h);
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_entries = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_MAX_ENTRIES;
+    for (size_t n = 10000; n <= max_entries; n *= 10) {
+        run(n);
+    }
+    return 0;
+}
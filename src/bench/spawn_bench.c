@@ -0,0 +1,56 @@
+/*
+Process launch latency against the size of the launching process.
+
+fork() has to copy the page tables of everything the shell has touched, posix_spawn (clone with
+CLONE_VM | CLONE_VFORK in glibc) doesn't. The heap is grown to each size and touched, then /bin/true is
+launched and reaped repeatedly through launch_process() with both backends.
+
+usage: ./spawn_bench [max heap MB]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "../launch.h"
+
+#define DEFAULT_MAX_HEAP_MB 512
+#define LAUNCHES 200
+#define TARGET "/bin/true"
+
+static void run(size_t heap_mb, bool spawn) {
+    char name[64];
+    char* args[] = {TARGET, NULL};
+    launch_attr attr = {.fds = NULL, .num_fds = 0, .pgid = -1, .tty_fd = -1};
+    launch_spawn = spawn;
+
+    uint64_t t0 = bench_now_ns();
+    for (size_t i = 0; i < LAUNCHES; ++i) {
+        pid_t pid = launch_process(TARGET, args, &attr);
+        if (pid > 0) waitpid(pid, NULL, 0);
+    }
+    snprintf(name, sizeof(name), "launch/%zumb", heap_mb);
+    bench_report(name, spawn ? "posix_spawn" : "fork", heap_mb, bench_now_ns() - t0, LAUNCHES, heap_mb << 20);
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_MAX_HEAP_MB;
+
+    char* heap = NULL;
+    size_t heap_mb = 0;
+    for (size_t mb = 0; mb <= max_mb; mb = mb ? mb * 4 : 8) {
+        heap = realloc(heap, (mb << 20) + 1);
+        memset(heap + (heap_mb << 20), 1, (mb - heap_mb) << 20); // touch it so the pages are really mapped
+        heap_mb = mb;
+        run(mb, false);
+        run(mb, true);
+    }
+    free(heap);
+    return 0;
+}
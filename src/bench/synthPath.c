@@ -0,0 +1,88 @@
+/*
+Synthetic PATH directories for the benchmarks, entries names are cmd<dir>_<i> so every name is unique,
+and a name from the last directory is the worst case for a PATH search.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "synthPath.h"
+#include "../dirReader.h"
+
+static void remove_tree(const char* path);
+
+/// @brief rm -r, the trees are only ever a couple of levels deep
+static void remove_tree(const char* path) {
+    dir_reader dir;
+    if (dir_reader_open(&dir, path) == 0) {
+        dir_ent* ent;
+        char child[PATH_MAX];
+        while ((ent = dir_reader_next(&dir))) {
+            snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+            if (ent->d_type == DT_DIR) {
+                remove_tree(child);
+            } else {
+                unlink(child);
+            }
+        }
+        dir_reader_close(&dir);
+    }
+    rmdir(path);
+}
+
+/// @return 0 on success, 1 if the directories couldn't be made (already reported)
+int synth_path_create(synth_path* sp, size_t entries) {
+    snprintf(sp->root, sizeof(sp->root), "/tmp/cshell_bench_XXXXXX");
+    if (mkdtemp(sp->root) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    sp->entries = entries;
+    const char* real_path = getenv("PATH") ? getenv("PATH") : "/usr/bin:/bin";
+    sp->path = malloc(SYNTH_PATH_DIRS * (sizeof(sp->root) + 8) + strlen(real_path) + 1);
+    sp->path[0] = '\0';
+
+    char file[PATH_MAX];
+    for (size_t d = 0; d < SYNTH_PATH_DIRS; ++d) {
+        char dir[sizeof(sp->root) + 8];
+        snprintf(dir, sizeof(dir), "%s/bin%zu", sp->root, d);
+        mkdir(dir, 0755);
+        strcat(sp->path, dir);
+        strcat(sp->path, ":");
+        for (size_t i = d; i < entries; i += SYNTH_PATH_DIRS) {
+            snprintf(file, sizeof(file), "%s/cmd%zu_%zu", dir, d, i);
+            int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+            if (fd == -1) {
+                perror(file);
+                return 1;
+            }
+            close(fd);
+        }
+    }
+    strcat(sp->path, real_path);
+
+    sp->cache = malloc(sizeof(sp->root) + 8);
+    snprintf(sp->cache, sizeof(sp->root) + 8, "%s/cache", sp->root);
+    mkdir(sp->cache, 0755);
+    return 0;
+}
+
+/// @brief drop the executable index cached by a shell, so the next one starts cold
+void synth_path_clear_cache(synth_path* sp) {
+    remove_tree(sp->cache);
+    mkdir(sp->cache, 0755);
+}
+
+void synth_path_destroy(synth_path* sp) {
+    remove_tree(sp->root);
+    free(sp->path);
+    free(sp->cache);
+}
@@ -0,0 +1,21 @@
+#ifndef SYNTHPATH_H
+#define SYNTHPATH_H
+
+#include <stddef.h>
+
+#define SYNTH_PATH_DIRS 10 // the executables are spread over this many directories
+
+// a temporary PATH of empty executables, like a machine with a lot of packages installed
+typedef struct synth_path synth_path;
+struct synth_path {
+    char root[64];  // mkdtemp'd directory holding the PATH directories and the cache directory
+    char* path;     // the PATH value, the synthetic directories then the real PATH so real commands still run
+    char* cache;    // an empty directory to use as XDG_CACHE_HOME
+    size_t entries;
+};
+
+int  synth_path_create(synth_path* sp, size_t entries);
+void synth_path_clear_cache(synth_path* sp);
+void synth_path_destroy(synth_path* sp);
+
+#endif
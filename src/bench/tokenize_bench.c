@@ -0,0 +1,196 @@
+/*
+Throughput of the command line tokenizer on long generated lines, the kind produced by pasting
+a big argument list. Compares tokenizer.c against the original memmove based tokenize() from main.c,
+kept here as legacy_tokenize.
+
+usage: ./tokenize_bench [max line bytes]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "bench.h"
+#include "../tokenizer.h"
+
+#define DEFAULT_MAX_LINE 65536
+#define BENCH_ITERS_BYTES (64u << 20) // tokenize about this many bytes per line size
+
+static char** legacy_tokenize(char* line);
+
+static char** legacy_tokenize(char* line) {
+
+    typedef enum token {
+        IN_DOUBLE, IN_SINGLE, OUTSIDE
+    } token_t;
+
+    token_t state = OUTSIDE;
+    char** argv = NULL;
+    size_t argc = 0;
+    char* token = NULL;
+
+    bool token_done = true;
+    
+    // strip leading whitespaces
+    while(*line == ' ') { ++line; }
+
+    char* ptr = line;
+
+    while(*ptr) {
+        // continue processing on token or start new one
+        if (state == OUTSIDE) {
+            // strip leading whitespaces before starting new token
+            // * since extra spaces between tokens are collapsed to just one
+            while(*ptr == ' ') {
+                ++ptr;
+            }
+
+            if (*ptr == '\0') break; // reached the end
+
+            token = ptr;
+
+            if (*ptr == '"') {
+                    state = IN_DOUBLE;
+                    // does not include the quote char
+                    if (token_done) { token = ++ptr; }
+            } else if (*ptr == '\'') {
+                    state = IN_SINGLE;
+                    if (token_done) { token = ++ptr; }
+            } else {
+                state = OUTSIDE; 
+            }
+            // first realloc call with NULL is treated as malloc, doing +2 to account for final NULL entry
+            // * note the use of sizeof(char*) since argv is an array of strings!
+            if (token_done) {
+                argv = realloc(argv, sizeof(char*) * (argc + 2));
+                argv[argc++] = token;
+                token_done = false;
+            }
+        }
+        // processing current token
+        switch(state) {
+            case IN_SINGLE:
+                // condition is irrelevant since if we parsed till the end of a string without closing quote
+                // that is an illegal quote
+                while (*ptr) {
+                    if (*ptr == '\'') {
+                        // only start a new token if the char after ' is a SPACE
+                        if (*(ptr + 1) == ' ') {
+                            *(ptr++) = '\0'; // end current token by replacing '
+                            token_done = true;
+                        } else {
+                            memmove(ptr, ptr + 1, strlen(ptr + 1) + 1);
+                        }
+                        break;
+                    }
+                    ++ptr;
+                }
+                state = OUTSIDE;
+                break;
+            case IN_DOUBLE:
+                while (*ptr) {
+                    // preserve backslash rules
+                    if (*ptr == '\\' && (ptr[1] == '"' || ptr[1] == '\\' || ptr[1] == '$')) {
+                        memmove(ptr, ptr + 1, strlen(ptr + 1) + 1);
+                    } else if (*ptr == '"') {
+                        // only start a new token if the char after " is a SPACE
+                        if (ptr[1] == ' ') {
+                            *(ptr++) = '\0'; // end current token on "
+                            token_done = true;
+                        } else {
+                            memmove(ptr, ptr + 1, strlen(ptr + 1) + 1);
+                        }
+                        break;
+                    }
+                    ++ptr; 
+                }
+                state = OUTSIDE;
+                break;
+            // OUTSIDE
+            default: 
+                while (*ptr) {
+                    // preserve backslashed literal
+                    if (*ptr == '\\') {
+                        memmove(ptr, ptr + 1, strlen(ptr + 1) + 1);
+                    // unescaped space signals start of new token
+                    } else if (*ptr == ' ') {
+                        token_done = true;
+                        break;
+                    // current token will switch state
+                    } else if (*ptr == '\'' || *ptr == '"') {
+                        break;
+                    }
+                    ++ptr;
+                }
+                // since we didnt move pointer after breaking on a space, space gets overwritten
+                if (token_done && *ptr != '\0') { *(ptr++) = '\0'; }
+                state = OUTSIDE;
+        }
+    }
+    if (argv) {
+        argv[argc] = NULL;
+    } else {
+        argv = malloc(sizeof(char*));
+        *argv = NULL;
+    }
+    return argv;
+}
+
+/// @brief a line of about len bytes mixing plain, quoted and escaped arguments and a couple of operators
+static char* make_line(size_t len) {
+    static const char* args[] = {"--flag", "\"two words\"", "'single $quoted'", "escaped\\ space", "src/file.c",
+                                 "\"esc \\\"inner\\\" quote\"", "|", "grep", "-v"};
+    char* line = malloc(len + 64);
+    size_t pos = 0;
+    pos += sprintf(line, "cmd");
+    for (size_t i = 0; pos < len; ++i) {
+        pos += sprintf(line + pos, " %s", args[i % (sizeof(args) / sizeof(args[0]))]);
+    }
+    return line;
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_len = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_MAX_LINE;
+    char name[64];
+
+    for (size_t len = 256; len <= max_len; len *= 4) {
+        char* line = make_line(len);
+        size_t line_len = strlen(line);
+        size_t iters = BENCH_ITERS_BYTES / line_len;
+        if (iters > 100000) iters = 100000;
+        if (iters < 4) iters = 4;
+        snprintf(name, sizeof(name), "tokenize/%zu", len);
+
+        size_t tokens_new = 0;
+        uint64_t t0 = bench_now_ns();
+        for (size_t i = 0; i < iters; ++i) {
+            token_list tokens;
+            tokenize(line, &tokens);
+            tokens_new = tokens.len;
+            token_list_free(&tokens);
+        }
+        bench_report(name, "single_pass", line_len, bench_now_ns() - t0, iters, 0);
+
+        // the legacy version is quadratic, cap its total work so big lines finish
+        size_t legacy_iters = iters > 2000 ? 2000 : iters;
+        if (line_len > 16384) legacy_iters = legacy_iters > 20 ? 20 : legacy_iters;
+        size_t tokens_old = 0;
+        char* copy = malloc(line_len + 1);
+        t0 = bench_now_ns();
+        for (size_t i = 0; i < legacy_iters; ++i) {
+            memcpy(copy, line, line_len + 1); // legacy tokenize writes into the line
+            char** toks = legacy_tokenize(copy);
+            for (tokens_old = 0; toks[tokens_old]; ++tokens_old) {}
+            free(toks);
+        }
+        bench_report(name, "legacy", line_len, bench_now_ns() - t0, legacy_iters, 0);
+        if (tokens_old != tokens_new) fprintf(stderr, "tokenize/%zu: %zu tokens vs legacy %zu\n", len, tokens_new, tokens_old);
+
+        free(copy);
+        free(line);
+    }
+    return 0;
+}
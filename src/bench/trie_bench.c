@@ -0,0 +1,325 @@
+/*
+Memory and lookup benchmark for the completion trie.
+
+Compares the radix tree in prefixTree.c against the original layout (one 256 pointer node per character),
+which is kept here verbatim-ish as legacy_trie. Word sets are the executables in $PATH and a synthetic
+set of n names with realistic shared prefixes.
+
+usage: ./trie_bench [n]
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <sys/mman.h>
+
+#include "bench.h"
+#include "../prefixTree.h"
+
+#define DEFAULT_SYNTHETIC_WORDS 50000
+#define LOOKUP_PREFIX_LEN 3
+#define LOOKUP_SAMPLES 1000 // prefixes of the synthetic set match thousands of words each
+
+typedef struct legacy_trie legacy_trie;
+struct legacy_trie {
+    legacy_trie* children[256];
+    bool isEnd;
+};
+
+static size_t legacy_nodes = 0;
+
+static legacy_trie* legacy_alloc(void) {
+    ++legacy_nodes;
+    legacy_trie* node = calloc(1, sizeof(legacy_trie));
+    if (node == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    return node;
+}
+
+static void legacy_insert(legacy_trie* root, const char* word) {
+    for (; *word; ++word) {
+        unsigned char idx = (unsigned char) *word;
+        if (!root->children[idx]) {
+            root->children[idx] = legacy_alloc();
+        }
+        root = root->children[idx];
+    }
+    root->isEnd = true;
+}
+
+static legacy_trie* legacy_prefix(legacy_trie* root, const char* prefix, trie_type* type) {
+    for (; *prefix; ++prefix) {
+        root = root->children[(unsigned char) *prefix];
+        if (!root) return NULL;
+        ac_buf_push(*prefix, type);
+    }
+    return root;
+}
+
+static void legacy_assemble(legacy_trie* root, char*** words, size_t* count, size_t* cap, trie_type* type) {
+    if (root->isEnd) {
+        push_word(words, count, cap, type);
+    }
+    for (size_t i = 0; i < 256; ++i) {
+        if (root->children[i]) {
+            ac_buf_push((char) i, type);
+            legacy_assemble(root->children[i], words, count, cap, type);
+            ac_buf_pop(type);
+        }
+    }
+}
+
+static void legacy_free(legacy_trie* root) {
+    if (!root) return;
+    for (int i = 0; i < 256; ++i) {
+        legacy_free(root->children[i]);
+    }
+    free(root);
+}
+
+typedef struct word_list word_list;
+struct word_list {
+    char** words;
+    size_t len;
+};
+
+static void word_list_push(word_list* wl, char* word) {
+    wl->words = realloc(wl->words, sizeof(char*) * (wl->len + 1));
+    wl->words[wl->len++] = word;
+}
+
+static word_list path_words(void) {
+    word_list wl = {0};
+    const char* path = getenv("PATH");
+    char* path_copy = strdup(path ? path : "");
+    for (char* dir = strtok(path_copy, ":"); dir; dir = strtok(NULL, ":")) {
+        DIR* d = opendir(dir);
+        if (!d) continue;
+        struct dirent* ent;
+        while ((ent = readdir(d))) {
+            word_list_push(&wl, strdup(ent->d_name));
+        }
+        closedir(d);
+    }
+    free(path_copy);
+    return wl;
+}
+
+/// @brief names shaped like a real bin directory: shared tool prefixes, suffixes and versions
+static word_list synthetic_words(size_t n) {
+    static const char* stems[] = {"git", "gcc", "x86_64-linux-gnu-", "python3", "lib", "kube", "docker", "perl",
+                                  "llvm-", "clang", "systemd-", "grub-", "xdg-", "dpkg-", "apt-", "ssh"};
+    static const char* alpha = "abcdefghijklmnopqrstuvwxyz0123456789-_.";
+    word_list wl = {0};
+    unsigned int seed = 12345;
+    char buf[64];
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const char* stem = stems[(seed >> 16) % ARRAY_LEN(stems)];
+        size_t len = strlen(stem);
+        memcpy(buf, stem, len);
+        size_t extra = 2 + (seed >> 8) % 12;
+        for (size_t k = 0; k < extra; ++k) {
+            seed = seed * 1103515245u + 12345u;
+            buf[len++] = alpha[(seed >> 16) % 39];
+        }
+        buf[len] = '\0';
+        word_list_push(&wl, strdup(buf));
+    }
+    return wl;
+}
+
+static void free_matches(char** matches) {
+    for (char** m = matches; *m; ++m) {
+        free(*m);
+    }
+    free(matches);
+}
+
+static void run(const char* set, word_list* wl) {
+    char name[64];
+    char prefix[LOOKUP_PREFIX_LEN + 1];
+    size_t n = wl->len;
+    size_t step = n > LOOKUP_SAMPLES ? n / LOOKUP_SAMPLES : 1;
+    size_t lookups = (n + step - 1) / step;
+    uint64_t t0;
+
+    // radix
+    t0 = bench_now_ns();
+    trie* root = trie_create();
+    for (size_t i = 0; i < n; ++i) {
+        trie_insert(root, wl->words[i]);
+    }
+    snprintf(name, sizeof(name), "trie_insert/%s", set);
+    bench_report(name, "radix", n, bench_now_ns() - t0, n, trie_mem_usage(root));
+
+    t0 = bench_now_ns();
+    size_t found = 0;
+    for (size_t i = 0; i < n; ++i) {
+        found += trie_search(root, wl->words[i]);
+    }
+    snprintf(name, sizeof(name), "trie_search/%s", set);
+    bench_report(name, "radix", n, bench_now_ns() - t0, n, 0);
+    if (found != n) fprintf(stderr, "radix: only %zu/%zu words found\n", found, n);
+
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i += step) {
+        trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0};
+        snprintf(prefix, sizeof(prefix), "%s", wl->words[i]);
+        trie* sub = get_prefix_subtree(root, prefix, &type);
+        if (sub) free_matches(assemble_trie(sub, &type));
+    }
+    snprintf(name, sizeof(name), "prefix_assemble/%s", set);
+    bench_report(name, "radix", n, bench_now_ns() - t0, lookups, 0);
+
+    // same walk, matches go to a scratch arena that is reset per lookup like a TAB press
+    arena scratch;
+    arena_init(&scratch);
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i += step) {
+        arena_reset(&scratch);
+        trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0, .scratch = &scratch};
+        snprintf(prefix, sizeof(prefix), "%s", wl->words[i]);
+        trie* sub = get_prefix_subtree(root, prefix, &type);
+        if (sub) assemble_trie(sub, &type);
+    }
+    bench_report(name, "radix+arena", n, bench_now_ns() - t0, lookups, 0);
+
+    // what the first TAB needs: the match count and the longest common prefix,
+    // from every match as a string vs straight off the trie
+    t0 = bench_now_ns();
+    size_t lcp_total = 0;
+    for (size_t i = 0; i < n; i += step) {
+        arena_reset(&scratch);
+        trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0, .scratch = &scratch};
+        snprintf(prefix, sizeof(prefix), "%s", wl->words[i]);
+        trie* sub = get_prefix_subtree(root, prefix, &type);
+        if (sub == NULL) continue;
+        char** matches = assemble_trie(sub, &type);
+        size_t lcp = strlen(matches[0]);
+        for (char** m = matches + 1; *m; ++m) {
+            size_t k = 0;
+            while (k < lcp && (*m)[k] == matches[0][k]) ++k;
+            lcp = k;
+        }
+        lcp_total += lcp;
+    }
+    snprintf(name, sizeof(name), "tab_lcp/%s", set);
+    bench_report(name, "assemble", n, bench_now_ns() - t0, lookups, 0);
+
+    t0 = bench_now_ns();
+    size_t lcp_check = 0;
+    for (size_t i = 0; i < n; i += step) {
+        trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0};
+        snprintf(prefix, sizeof(prefix), "%s", wl->words[i]);
+        trie* sub = get_prefix_subtree(root, prefix, &type);
+        if (sub == NULL) continue;
+        trie_lcp(sub, &type);
+        lcp_check += type.autocomplete_buf_sz;
+    }
+    bench_report(name, "trie_lcp", n, bench_now_ns() - t0, lookups, 0);
+    if (lcp_check != lcp_total) fprintf(stderr, "trie_lcp: %zu != %zu\n", lcp_check, lcp_total);
+
+    // listing the matches on the second TAB, one word at a time out of the iterator's buffer
+    t0 = bench_now_ns();
+    trie_iter* it = malloc(sizeof(trie_iter));
+    size_t listed = 0;
+    for (size_t i = 0; i < n; i += step) {
+        trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0};
+        snprintf(prefix, sizeof(prefix), "%s", wl->words[i]);
+        trie* sub = get_prefix_subtree(root, prefix, &type);
+        if (sub == NULL) continue;
+        trie_iter_init(it, sub, &type);
+        while (trie_iter_next(it)) {
+            listed += type.autocomplete_buf_sz;
+        }
+    }
+    free(it);
+    snprintf(name, sizeof(name), "prefix_assemble/%s", set);
+    bench_report(name, "radix+iter", n, bench_now_ns() - t0, lookups, listed);
+
+    // frozen image, what a new shell maps from the on disk index instead of inserting every word
+    t0 = bench_now_ns();
+    trie_image* image = trie_freeze(root, NULL, 0);
+    snprintf(name, sizeof(name), "trie_freeze/%s", set);
+    bench_report(name, "radix", n, bench_now_ns() - t0, 1, image->size);
+
+    void* mapped = mmap(NULL, image->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    memcpy(mapped, image, image->size);
+    t0 = bench_now_ns();
+    trie* frozen = trie_map_image(mapped, image->size); // * checks the image checksum, one pass over it
+    snprintf(name, sizeof(name), "trie_map_image/%s", set);
+    bench_report(name, "radix", n, bench_now_ns() - t0, 1, image->size);
+    free(image);
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i += step) {
+        arena_reset(&scratch);
+        trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0, .scratch = &scratch};
+        snprintf(prefix, sizeof(prefix), "%s", wl->words[i]);
+        trie* sub = get_prefix_subtree(frozen, prefix, &type);
+        if (sub) assemble_trie(sub, &type);
+    }
+    snprintf(name, sizeof(name), "prefix_assemble/%s", set);
+    bench_report(name, "frozen+arena", n, bench_now_ns() - t0, lookups, 0);
+    trie_free(frozen);
+    arena_free(&scratch);
+
+    t0 = bench_now_ns();
+    trie_free(root);
+    snprintf(name, sizeof(name), "trie_free/%s", set);
+    bench_report(name, "radix", n, bench_now_ns() - t0, 1, 0);
+
+    // legacy
+    legacy_nodes = 0;
+    t0 = bench_now_ns();
+    legacy_trie* lroot = legacy_alloc();
+    for (size_t i = 0; i < n; ++i) {
+        legacy_insert(lroot, wl->words[i]);
+    }
+    snprintf(name, sizeof(name), "trie_insert/%s", set);
+    bench_report(name, "legacy", n, bench_now_ns() - t0, n, legacy_nodes * sizeof(legacy_trie));
+
+    t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i += step) {
+        trie_type type = {.autocomplete_buf = {0}, .autocomplete_buf_sz = 0};
+        snprintf(prefix, sizeof(prefix), "%s", wl->words[i]);
+        legacy_trie* sub = legacy_prefix(lroot, prefix, &type);
+        if (sub) {
+            char** words = NULL;
+            size_t count = 0;
+            size_t cap = 0;
+            legacy_assemble(sub, &words, &count, &cap, &type);
+            words = realloc(words, (count + 1) * sizeof(char*));
+            words[count] = NULL;
+            free_matches(words);
+        }
+    }
+    snprintf(name, sizeof(name), "prefix_assemble/%s", set);
+    bench_report(name, "legacy", n, bench_now_ns() - t0, lookups, 0);
+
+    t0 = bench_now_ns();
+    legacy_free(lroot);
+    snprintf(name, sizeof(name), "trie_free/%s", set);
+    bench_report(name, "legacy", n, bench_now_ns() - t0, 1, 0);
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_SYNTHETIC_WORDS;
+
+    word_list path = path_words();
+    word_list synth = synthetic_words(n);
+    run("path", &path);
+    run("synthetic", &synth);
+
+    for (size_t i = 0; i < path.len; ++i) free(path.words[i]);
+    for (size_t i = 0; i < synth.len; ++i) free(synth.words[i]);
+    free(path.words);
+    free(synth.words);
+    return 0;
+}
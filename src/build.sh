@@ -1,4 +1,4 @@
 set -xe
 
-rm -f prefixTree shell
-cc -g -O0 -Wall -Werror -std=c17 -ggdb main.c prefixTree.c autocomplete.c history.c historyList.c readline_init.c -o shell -fsanitize=address -lreadline -lncurses
\ No newline at end of file
+# the debug shell with ASan, see the Makefile for release and pgo builds
+make "$@"
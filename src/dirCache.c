@@ -0,0 +1,137 @@
+/*
+Directory listing cache for filename completion.
+
+Each TAB used to scandir() the whole directory into a brand new trie. Listings are now kept in a small LRU,
+keyed by the directory's device and inode and validated against its mtime, so pressing TAB again in the
+same directory costs one stat() and a binary search over a sorted array.
+The cache belongs to the completion worker thread, which does the stat()s and the reading (see dirFetch.c).
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h> // d_type values
+
+#include <sys/stat.h>
+
+#include "dirCache.h"
+
+static dir_listing slots[DIR_CACHE_SLOTS];
+static size_t used_slots = 0;
+static uint64_t use_clock = 0;
+
+static int cmp_entries(const void* a, const void* b);
+
+static int cmp_entries(const void* a, const void* b) {
+    return strcmp(((const dir_entry*) a)->name, ((const dir_entry*) b)->name);
+}
+
+/// @brief the cached listing of the directory st describes, if it hasn't changed since it was read
+/// @return NULL if it has to be read (again)
+dir_listing* dir_cache_find(const struct stat* st) {
+    for (size_t i = 0; i < used_slots; ++i) {
+        dir_listing* listing = &slots[i];
+        if (listing->dev == st->st_dev && listing->ino == st->st_ino &&
+            listing->mtime.tv_sec == st->st_mtim.tv_sec && listing->mtime.tv_nsec == st->st_mtim.tv_nsec) {
+            listing->last_used = ++use_clock;
+            return listing;
+        }
+    }
+    return NULL;
+}
+
+/// @brief an emptied slot to read the directory st describes into, its old slot or the least recently used one
+/// * the caller fills entries and names, and sorts them with dir_listing_sort()
+dir_listing* dir_cache_claim(const struct stat* st) {
+    dir_listing* listing = NULL;
+    for (size_t i = 0; i < used_slots; ++i) {
+        if (slots[i].dev == st->st_dev && slots[i].ino == st->st_ino) {
+            listing = &slots[i];
+            break;
+        }
+    }
+    if (listing == NULL) {
+        if (used_slots < DIR_CACHE_SLOTS) {
+            listing = &slots[used_slots++];
+            memset(listing, 0, sizeof(dir_listing));
+            arena_init(&listing->names);
+        } else { // evict least recently used
+            listing = &slots[0];
+            for (size_t i = 1; i < used_slots; ++i) {
+                if (slots[i].last_used < listing->last_used) listing = &slots[i];
+            }
+        }
+    }
+    arena_reset(&listing->names);
+    free(listing->entries);
+    listing->entries = NULL;
+    listing->len = 0;
+    listing->dev = st->st_dev;
+    listing->ino = st->st_ino;
+    listing->mtime = st->st_mtim;
+    listing->last_used = ++use_clock;
+    return listing;
+}
+
+/// @brief forget a claimed listing that couldn't be read in full
+void dir_cache_drop(dir_listing* listing) {
+    listing->ino = 0; // don't match this slot again until it's read
+    listing->mtime = (struct timespec){0};
+}
+
+/// @brief byte order, so a prefix is a contiguous range
+void dir_listing_sort(dir_entry* entries, size_t len) {
+    if (len) qsort(entries, len, sizeof(dir_entry), cmp_entries);
+}
+
+/// @brief find the entries starting with prefix, two binary searches over the sorted entries
+/// @param first set to the index of the first match
+/// @return number of matches, they are entries[first .. first + count)
+size_t dir_listing_prefix(dir_listing* listing, const char* prefix, size_t* first) {
+    size_t prefix_len = strlen(prefix);
+    size_t lo = 0;
+    size_t hi = listing->len;
+    // lower bound: first entry >= prefix
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp(listing->entries[mid].name, prefix) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *first = lo;
+    // upper bound: first entry past lo that doesn't start with prefix
+    hi = listing->len;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strncmp(listing->entries[mid].name, prefix, prefix_len) == 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo - *first;
+}
+
+/// @brief d_type when the filesystem reports it, one stat() otherwise (and for symlinks, which may point at a directory)
+bool dir_entry_is_dir(const char* dir, dir_entry* entry) {
+    if (entry->type == DT_DIR) return true;
+    if (entry->type != DT_UNKNOWN && entry->type != DT_LNK) return false;
+
+    char path[PATH_MAX];
+    struct stat st;
+    int len = snprintf(path, sizeof(path), "%s%s", dir, entry->name);
+    return len > 0 && (size_t) len < sizeof(path) && stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+void dir_cache_free(void) {
+    for (size_t i = 0; i < used_slots; ++i) {
+        arena_free(&slots[i].names);
+        free(slots[i].entries);
+    }
+    used_slots = 0;
+}
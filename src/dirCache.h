@@ -0,0 +1,42 @@
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "arena.h"
+
+#define DIR_CACHE_SLOTS 16 // directories remembered for filename completion
+
+typedef struct dir_entry dir_entry;
+struct dir_entry {
+    const char* name;
+    uint32_t len;
+    unsigned char type; // d_type, DT_UNKNOWN if the filesystem doesn't report it
+};
+
+// one directory's entries, sorted in byte order so a prefix is a contiguous range
+typedef struct dir_listing dir_listing;
+struct dir_listing {
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime; // listing is only valid while the directory's mtime matches
+    arena names;
+    dir_entry* entries;
+    size_t len;
+    uint64_t last_used;
+};
+
+dir_listing* dir_cache_find(const struct stat* st);
+dir_listing* dir_cache_claim(const struct stat* st);
+void dir_cache_drop(dir_listing* listing);
+void dir_listing_sort(dir_entry* entries, size_t len);
+size_t dir_listing_prefix(dir_listing* listing, const char* prefix, size_t* first);
+bool dir_entry_is_dir(const char* dir, dir_entry* entry);
+void dir_cache_free(void);
+
+#endif
@@ -0,0 +1,345 @@
+/*
+Filename completion listings read on a worker thread, so TAB never blocks on a slow filesystem.
+
+Every stat() and directory read filename completion does, and the listing cache itself (dirCache.c), belong
+to one worker thread. A TAB hands it the directory and the prefix being completed, then waits on an eventfd
+for the answer, with a deadline and an eye on the terminal:
+- the answer comes in time: the matches come straight out of the cached listing
+- the deadline passes first: the matches among the entries read so far are shown, the worker keeps reading
+  and the next TAB finds the whole listing cached
+- a key is pressed first: the scan is cancelled, the user has moved on
+A TAB in another directory also cancels a scan still running for an earlier one.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "dirFetch.h"
+#include "dirReader.h"
+#include "redirect.h"
+
+static pthread_t worker;
+static bool worker_running = false;
+static int done_fd = -1; // eventfd, written once for every request the worker finishes
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+// guarded by lock
+static char* req_dir = NULL;       // the next request, replaced if another TAB comes before the worker takes it
+static char* req_prefix = NULL;
+static uint64_t req_id = 0;
+static bool req_pending = false;
+static bool stop_requested = false;
+static uint64_t active_id = 0;     // the request the worker is on, 0 when idle
+static const char* active_dir = NULL;
+static dir_listing* scanning = NULL; // the listing being read for it
+static size_t published = 0;       // entries of scanning a TAB past its deadline may look at
+static uint64_t done_id = 0;       // the last request finished, and its answer
+static dir_fetch_status done_status = DIR_FETCH_FAILED;
+static dir_listing* done_listing = NULL;
+static size_t done_first = 0;
+static size_t done_count = 0;
+static bool done_first_is_dir = false;
+
+static atomic_bool cancel_active = false; // the worker drops the scan it's on
+static uint64_t next_id = 0; // readline thread only
+
+static void* worker_main(void* arg);
+static dir_listing* fetch_listing(const char* dir);
+static int scan_listing(dir_listing* listing, const char* dir);
+static bool take_done(uint64_t id, dir_matches* out, dir_fetch_status* status);
+static dir_fetch_status take_partial(uint64_t id, const char* prefix, arena* scratch, dir_matches* out);
+static long elapsed_ms(const struct timespec* since);
+
+/// @brief start the worker, without one dir_fetch() does everything itself and can block
+void dir_fetch_start(void) {
+    if (worker_running) return;
+    done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (done_fd == -1) {
+        perror("completion worker");
+        return;
+    }
+    done_fd = redirect_fd_high(done_fd);
+    stop_requested = false;
+    if (pthread_create(&worker, NULL, worker_main, NULL)) {
+        perror("pthread_create");
+        close(done_fd);
+        done_fd = -1;
+        return;
+    }
+    worker_running = true;
+}
+
+/// @brief the entries of dir starting with prefix, from the worker, see the top of this file
+/// @param dir directory as typed, e.g. "./" or "src/"
+/// @param input_fd the terminal, a key pressed there cancels the fetch, -1 to not watch it
+/// @param scratch copies of partial matches go here
+/// @return how it went, out is filled in for DIR_FETCH_DONE and DIR_FETCH_PARTIAL
+dir_fetch_status dir_fetch(const char* dir, const char* prefix, int input_fd, arena* scratch, dir_matches* out) {
+    memset(out, 0, sizeof(dir_matches));
+    if (!worker_running) { // everything on this thread then, like before there was a worker
+        dir_listing* listing = fetch_listing(dir);
+        if (listing == NULL) return DIR_FETCH_FAILED;
+        size_t first = 0;
+        out->count = dir_listing_prefix(listing, prefix, &first);
+        out->entries = listing->entries + first;
+        out->first_is_dir = out->count && dir_entry_is_dir(dir, out->entries);
+        return DIR_FETCH_DONE;
+    }
+
+    pthread_mutex_lock(&lock);
+    uint64_t id = ++next_id;
+    if (active_id && strcmp(active_dir, dir)) {
+        atomic_store(&cancel_active, true); // nobody is waiting for that directory any more
+    }
+    free(req_dir); // an older request that was never taken, nobody waits for it either
+    free(req_prefix);
+    req_dir = strdup(dir);
+    req_prefix = strdup(prefix);
+    req_id = id;
+    req_pending = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct pollfd fds[2] = {{.fd = done_fd, .events = POLLIN}, {.fd = input_fd, .events = POLLIN}};
+    while (1) {
+        long elapsed = elapsed_ms(&start);
+        if (elapsed >= DIR_FETCH_DEADLINE_MS) return take_partial(id, prefix, scratch, out);
+        // * keys typed before the TAB was even handled would cancel it straight away, so they only count after a moment
+        bool watch_input = input_fd != -1 && elapsed >= DIR_FETCH_TYPEAHEAD_MS;
+        long until = (input_fd == -1 || watch_input) ? DIR_FETCH_DEADLINE_MS : DIR_FETCH_TYPEAHEAD_MS;
+        long wait = until - elapsed;
+        int ready = poll(fds, watch_input ? 2 : 1, (int) wait);
+        if (ready == -1 && errno != EINTR) return take_partial(id, prefix, scratch, out);
+        if (ready <= 0) continue; // EINTR from SIGCHLD, or time to look at the terminal
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(done_fd, &count, sizeof(count)) == -1) {
+                // already drained
+            }
+            dir_fetch_status status;
+            if (take_done(id, out, &status)) return status;
+        }
+        if (watch_input && fds[1].revents) {
+            pthread_mutex_lock(&lock);
+            if (active_id == id) {
+                atomic_store(&cancel_active, true);
+            } else if (req_pending && req_id == id) {
+                req_pending = false; // never started
+            }
+            pthread_mutex_unlock(&lock);
+            return DIR_FETCH_CANCELLED;
+        }
+    }
+}
+
+/// @brief stop the worker and free the cache, a worker stuck in a filesystem that doesn't answer is left behind
+void dir_fetch_stop(void) {
+    if (!worker_running) {
+        dir_cache_free();
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    stop_requested = true;
+    bool busy = active_id != 0;
+    atomic_store(&cancel_active, true);
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    if (busy) { // * the shell is exiting, it doesn't wait on a hung mount and the worker's memory goes with it
+        pthread_detach(worker);
+    } else {
+        pthread_join(worker, NULL);
+        dir_cache_free();
+        free(req_dir);
+        free(req_prefix);
+        req_dir = req_prefix = NULL;
+        req_pending = false;
+        close(done_fd);
+        done_fd = -1;
+    }
+    worker_running = false;
+}
+
+static void* worker_main(void* arg) {
+    (void) arg;
+    // signals are for the shell's main thread
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    char* dir = NULL;
+    char* prefix = NULL;
+    pthread_mutex_lock(&lock);
+    while (1) {
+        while (!req_pending && !stop_requested) {
+            pthread_cond_wait(&wake, &lock);
+        }
+        if (stop_requested) break;
+        free(dir);
+        free(prefix);
+        dir = req_dir;
+        prefix = req_prefix;
+        req_dir = req_prefix = NULL;
+        req_pending = false;
+        uint64_t id = req_id;
+        active_id = id;
+        active_dir = dir;
+        atomic_store(&cancel_active, false);
+        pthread_mutex_unlock(&lock);
+
+        dir_listing* listing = fetch_listing(dir);
+        size_t first = 0;
+        size_t count = listing ? dir_listing_prefix(listing, prefix, &first) : 0;
+        bool first_is_dir = count && dir_entry_is_dir(dir, &listing->entries[first]); // the one stat() completion may need
+
+        pthread_mutex_lock(&lock);
+        active_id = 0;
+        active_dir = NULL;
+        done_id = id;
+        done_status = listing ? DIR_FETCH_DONE : atomic_load(&cancel_active) ? DIR_FETCH_CANCELLED : DIR_FETCH_FAILED;
+        done_listing = listing;
+        done_first = first;
+        done_count = count;
+        done_first_is_dir = first_is_dir;
+        pthread_mutex_unlock(&lock);
+        uint64_t one = 1;
+        if (write(done_fd, &one, sizeof(one)) == -1) {
+            perror("completion worker");
+        }
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    free(dir);
+    free(prefix);
+    return NULL;
+}
+
+/// @brief listing of dir, read again only if the directory changed since it was cached
+/// @return NULL if the directory can't be read or the scan was cancelled
+static dir_listing* fetch_listing(const char* dir) {
+    struct stat st;
+    if (stat(dir, &st) || !S_ISDIR(st.st_mode)) return NULL;
+
+    dir_listing* listing = dir_cache_find(&st);
+    if (listing) return listing;
+    listing = dir_cache_claim(&st);
+    if (scan_listing(listing, dir)) {
+        dir_cache_drop(listing);
+        return NULL;
+    }
+    return listing;
+}
+
+/// @brief read dir into an emptied listing, making the entries visible every DIR_FETCH_PUBLISH for take_partial()
+/// @return 0 on success, 1 if the directory can't be read in full or the scan was cancelled
+static int scan_listing(dir_listing* listing, const char* dir) {
+    dir_reader dr;
+    if (dir_reader_open(&dr, dir)) return 1;
+    pthread_mutex_lock(&lock);
+    scanning = listing;
+    published = 0;
+    pthread_mutex_unlock(&lock);
+
+    int ret = 0;
+    size_t cap = 0;
+    dir_ent* ent;
+    while ((ent = dir_reader_next(&dr))) {
+        if (atomic_load(&cancel_active)) {
+            ret = 1;
+            break;
+        }
+        if (listing->len == cap) {
+            cap = cap ? cap * 2 : 64;
+            pthread_mutex_lock(&lock); // a TAB past its deadline may be copying out of the old array
+            listing->entries = realloc(listing->entries, cap * sizeof(dir_entry));
+            pthread_mutex_unlock(&lock);
+        }
+        size_t len = strlen(ent->d_name);
+        dir_entry* e = &listing->entries[listing->len++];
+        e->name = arena_strndup(&listing->names, ent->d_name, len);
+        e->len = len;
+        e->type = ent->d_type;
+        if (listing->len % DIR_FETCH_PUBLISH == 0) {
+            pthread_mutex_lock(&lock);
+            published = listing->len;
+            pthread_mutex_unlock(&lock);
+        }
+    }
+    if (dir_reader_error(&dr)) ret = 1; // * cut short, caching it would offer a partial list until the mtime changes
+    dir_reader_close(&dr);
+
+    pthread_mutex_lock(&lock); // * sorting moves entries around, so a partial TAB waits for it rather than copy a mess
+    published = listing->len;
+    if (ret == 0) dir_listing_sort(listing->entries, listing->len);
+    scanning = NULL;
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+/// @brief the worker's answer, if it is the one for request id
+/// @param status set to how it went
+/// @return false if the last answer is for an older request
+static bool take_done(uint64_t id, dir_matches* out, dir_fetch_status* status) {
+    pthread_mutex_lock(&lock);
+    if (done_id != id) {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    *status = done_status;
+    if (done_status == DIR_FETCH_DONE) { // * the worker stays idle until the next request, so the listing can be read without the lock
+        out->entries = done_listing->entries + done_first;
+        out->count = done_count;
+        out->first_is_dir = done_first_is_dir;
+    }
+    pthread_mutex_unlock(&lock);
+    return true;
+}
+
+/// @brief past the deadline, copy the matches among the entries read so far and sort them
+/// * a symlink only counts as a directory once the worker stat()s it, never here
+static dir_fetch_status take_partial(uint64_t id, const char* prefix, arena* scratch, dir_matches* out) {
+    dir_fetch_status status;
+    if (take_done(id, out, &status)) return status; // it may have just made it
+
+    size_t prefix_len = strlen(prefix);
+    pthread_mutex_lock(&lock);
+    if (active_id == id && scanning) {
+        dir_entry* matches = arena_alloc(scratch, (published + 1) * sizeof(dir_entry));
+        size_t count = 0;
+        for (size_t i = 0; i < published; ++i) {
+            const dir_entry* e = &scanning->entries[i];
+            if (strncmp(e->name, prefix, prefix_len)) continue;
+            matches[count] = *e;
+            matches[count++].name = arena_strndup(scratch, e->name, e->len); // the worker may drop the listing later
+        }
+        dir_listing_sort(matches, count);
+        out->entries = matches;
+        out->count = count;
+        out->first_is_dir = count && matches[0].type == DT_DIR;
+    }
+    pthread_mutex_unlock(&lock);
+    return DIR_FETCH_PARTIAL;
+}
+
+static long elapsed_ms(const struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
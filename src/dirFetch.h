@@ -0,0 +1,33 @@
+#ifndef DIRFETCH_H
+#define DIRFETCH_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "dirCache.h"
+
+#define DIR_FETCH_DEADLINE_MS 150 // a TAB waits this long for the worker before settling for the entries read so far
+#define DIR_FETCH_TYPEAHEAD_MS 10 // keys already typed don't cancel a TAB the worker answers quicker than this
+#define DIR_FETCH_PUBLISH 256     // entries read between making them visible to a TAB past its deadline
+
+typedef enum {
+    DIR_FETCH_DONE,      // every match
+    DIR_FETCH_PARTIAL,   // the matches among the entries read by the deadline, the worker keeps reading
+    DIR_FETCH_CANCELLED, // a key was pressed first
+    DIR_FETCH_FAILED,    // not a directory that can be read
+} dir_fetch_status;
+
+// the entries of a directory starting with a prefix, sorted, valid until the next dir_fetch()
+typedef struct dir_matches dir_matches;
+struct dir_matches {
+    dir_entry* entries;
+    size_t count;
+    bool first_is_dir; // entries[0] is a directory, or a symlink to one
+};
+
+void dir_fetch_start(void);
+dir_fetch_status dir_fetch(const char* dir, const char* prefix, int input_fd, arena* scratch, dir_matches* out);
+void dir_fetch_stop(void);
+
+#endif
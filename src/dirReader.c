@@ -0,0 +1,71 @@
+/*
+Directory iteration for the PATH, completion and glob scans.
+
+readdir() copies nothing either, but it goes through a DIR the size of its 32kb buffer that's malloc'd per
+directory, and scandir() on top of that malloc's every entry and sorts them all with strcoll, when the
+tries and listings that consume the entries order them themselves. Here one buffer is filled by
+getdents64() and each entry is returned where the kernel put it, "." and ".." already skipped.
+*/
+
+#define _GNU_SOURCE // getdents64
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "dirReader.h"
+
+/// @return 0 on success, -1 if path can't be opened as a directory or there's no memory for the buffer (errno is set)
+int dir_reader_open(dir_reader* r, const char* path) {
+    r->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    r->pos = 0;
+    r->len = 0;
+    r->err = 0;
+    r->buf = NULL;
+    if (r->fd == -1) return -1;
+    r->buf = malloc(DIR_READER_BUF);
+    if (r->buf == NULL) {
+        close(r->fd);
+        r->fd = -1;
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+/// @brief next entry of the directory, other than "." and ".."
+/// @return the entry, valid until the next call, NULL at the end of the directory or on a read error,
+// * see dir_reader_error() for which one
+dir_ent* dir_reader_next(dir_reader* r) {
+    if (r->err) return NULL;
+    while (1) {
+        if (r->pos >= r->len) {
+            ssize_t n = getdents64(r->fd, r->buf, DIR_READER_BUF);
+            if (n == -1) r->err = errno;
+            if (n <= 0) return NULL;
+            r->pos = 0;
+            r->len = n;
+        }
+        dir_ent* ent = (dir_ent*) (r->buf + r->pos);
+        r->pos += ent->d_reclen;
+        const char* name = ent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        return ent;
+    }
+}
+
+/// @brief whether dir_reader_next() stopped because a read failed (EIO, ESTALE on NFS...) and the entries were cut short
+/// @return the errno of the read, 0 if every entry so far was read, which after a NULL means all of them
+int dir_reader_error(const dir_reader* r) {
+    return r->err;
+}
+
+void dir_reader_close(dir_reader* r) {
+    if (r->fd != -1) close(r->fd);
+    free(r->buf);
+    r->fd = -1;
+    r->buf = NULL;
+}
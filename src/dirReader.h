@@ -0,0 +1,35 @@
+#ifndef DIRREADER_H
+#define DIRREADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <dirent.h> // DT_DIR and the other d_type values
+
+#define DIR_READER_BUF 65536 // bytes of entries asked of getdents64() at a time
+
+// one record as getdents64() lays it out (struct linux_dirent64)
+typedef struct dir_ent dir_ent;
+struct dir_ent {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type; // DT_UNKNOWN if the filesystem doesn't report it
+    char d_name[];
+};
+
+// reads a directory straight from getdents64() into one buffer, entries are handed out where they lie
+typedef struct dir_reader dir_reader;
+struct dir_reader {
+    int fd;
+    char* buf;
+    size_t pos;  // next record in buf
+    size_t len;  // bytes of records in buf
+    int err;     // errno of the getdents64() that failed, 0 while reading went fine
+};
+
+int  dir_reader_open(dir_reader* r, const char* path);
+dir_ent* dir_reader_next(dir_reader* r);
+int  dir_reader_error(const dir_reader* r);
+void dir_reader_close(dir_reader* r);
+
+#endif
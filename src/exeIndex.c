@@ -0,0 +1,167 @@
+/*
+On disk cache of the executable completion trie.
+
+The trie is frozen into one position independent image (see trie_freeze) and written to
+~/.cache/cshell/exe-<hash of PATH>.idx. The next shell started with the same PATH mmaps that file
+read only and completes straight out of the mapping, instead of scanning and inserting every executable.
+The file stores a key of the PATH directories and their mtimes, it is only used while every mtime still
+matches, and is replaced (write to a temp file, then rename) whenever a fresh trie gets built.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "exeIndex.h"
+
+static int index_file_path(const char* key, char* buf, size_t buf_len, bool create_dir);
+
+/// @brief the cache key: PATH directories joined by ':' (empty entries dropped) and NUL terminated,
+/// followed by the mtime of each directory as two int64's, -1 for a directory that doesn't exist
+/// * mtimes are taken before anything is scanned, so a directory changing mid scan makes the key stale rather than the cache wrong
+/// @return malloc'd key, MUST BE FREE'D BY CALLER
+char* exe_index_key(const char* path, size_t* key_len) {
+    char* path_copy = strdup(path ? path : "");
+    size_t num_dirs = 0;
+    int64_t* mtimes = NULL;
+    for (char* dir = strtok(path_copy, ":"); dir; dir = strtok(NULL, ":")) {
+        mtimes = realloc(mtimes, (num_dirs + 1) * 2 * sizeof(int64_t));
+        int64_t* mtime = mtimes + 2 * num_dirs++;
+        struct stat st;
+        mtime[0] = mtime[1] = -1;
+        if (stat(dir, &st) == 0) {
+            mtime[0] = st.st_mtim.tv_sec;
+            mtime[1] = st.st_mtim.tv_nsec;
+        }
+    }
+    free(path_copy);
+    char* key = exe_index_key_mtimes(path, mtimes, key_len);
+    free(mtimes);
+    return key;
+}
+
+/// @brief exe_index_key() with the stat()s already done, e.g. by the PATH scan workers
+/// @param mtimes seconds and nanoseconds for each non empty PATH entry in order, both -1 for one that doesn't exist
+/// @return malloc'd key, MUST BE FREE'D BY CALLER
+char* exe_index_key_mtimes(const char* path, const int64_t* mtimes, size_t* key_len) {
+    char* path_copy = strdup(path ? path : "");
+    size_t len = 0;
+    size_t num_dirs = 0;
+    char* key = malloc(strlen(path_copy) + 1);
+
+    // normalized directory list
+    for (char* dir = strtok(path_copy, ":"); dir; dir = strtok(NULL, ":")) {
+        size_t dir_len = strlen(dir);
+        if (len) key[len++] = ':';
+        memcpy(key + len, dir, dir_len);
+        len += dir_len;
+        ++num_dirs;
+    }
+    key[len++] = '\0';
+    free(path_copy);
+
+    // then one mtime per directory
+    key = realloc(key, len + num_dirs * 2 * sizeof(int64_t));
+    memcpy(key + len, mtimes, num_dirs * 2 * sizeof(int64_t));
+    *key_len = len + num_dirs * 2 * sizeof(int64_t);
+    return key;
+}
+
+/// @brief ~/.cache/cshell/exe-<FNV-1a of the directory list>.idx
+/// @return 0 on success, -1 if there is no usable cache directory
+static int index_file_path(const char* key, char* buf, size_t buf_len, bool create_dir) {
+    const char* cache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    int len = 0;
+    if (cache && *cache) {
+        len = snprintf(buf, buf_len, "%s/%s", cache, EXE_INDEX_DIR);
+    } else if (home && *home) {
+        len = snprintf(buf, buf_len, "%s/.cache/%s", home, EXE_INDEX_DIR);
+    } else {
+        return -1;
+    }
+    if (len < 0 || (size_t) len >= buf_len) return -1;
+
+    if (create_dir) {
+        // mkdir -p, only the last two components can realistically be missing
+        char* slash = strrchr(buf, '/');
+        *slash = '\0';
+        mkdir(buf, 0700);
+        *slash = '/';
+        if (mkdir(buf, 0700) && access(buf, W_OK)) return -1;
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* c = key; *c; ++c) {
+        hash ^= (unsigned char) *c;
+        hash *= 1099511628211ull;
+    }
+    int name_len = snprintf(buf + len, buf_len - len, "/exe-%016llx.idx", (unsigned long long) hash);
+    if (name_len < 0 || (size_t) name_len >= buf_len - len) return -1;
+    return 0;
+}
+
+/// @brief map the cached trie for the PATH in key, if one exists and none of the PATH directories changed since it was written
+/// @param key from exe_index_key() or exe_index_key_mtimes()
+/// @return read only trie that trie_free() unmaps, NULL if the cache is missing or stale
+trie* exe_index_load(const char* key, size_t key_len) {
+    char file[PATH_MAX];
+    if (index_file_path(key, file, sizeof(file), false)) {
+        return NULL;
+    }
+
+    trie* root = NULL;
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd != -1 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0); // * read in full anyway for the checksum
+        if (image != MAP_FAILED) {
+            root = trie_map_image(image, st.st_size);
+            if (root == NULL) {
+                munmap(image, st.st_size);
+            } else {
+                size_t user_size = 0;
+                const void* stored = trie_image_user(root, &user_size);
+                if (user_size != key_len || memcmp(stored, key, key_len)) {
+                    trie_free(root); // stale
+                    root = NULL;
+                }
+            }
+        }
+    }
+    if (fd != -1) close(fd);
+    return root;
+}
+
+/// @brief freeze root and atomically replace the cache file for the PATH in key
+/// @param key from exe_index_key(), taken before root was built
+void exe_index_save(trie* root, const char* key, size_t key_len) {
+    char file[PATH_MAX];
+    char tmp[PATH_MAX + 32];
+    if (index_file_path(key, file, sizeof(file), true)) return;
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", file, (long) getpid());
+
+    trie_image* image = trie_freeze(root, key, key_len);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        free(image);
+        return;
+    }
+    bool ok = write(fd, image, image->size) == (ssize_t) image->size;
+    close(fd);
+    free(image);
+    // * rename is atomic, shells that already mapped the old file keep their (unlinked) copy
+    if (!ok || rename(tmp, file)) {
+        unlink(tmp);
+    }
+}
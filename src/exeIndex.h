@@ -0,0 +1,16 @@
+#ifndef EXEINDEX_H
+#define EXEINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "prefixTree.h"
+
+#define EXE_INDEX_DIR "cshell" // under $XDG_CACHE_HOME, or ~/.cache
+
+char* exe_index_key(const char* path, size_t* key_len);
+char* exe_index_key_mtimes(const char* path, const int64_t* mtimes, size_t* key_len);
+trie* exe_index_load(const char* key, size_t key_len);
+void  exe_index_save(trie* root, const char* key, size_t key_len);
+
+#endif
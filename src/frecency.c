@@ -0,0 +1,289 @@
+/*
+How often and how recently every command was run, for ordering completions (frecency).
+
+Each run of a command adds a weight that halves every FRECENCY_HALF_LIFE. Rather than decaying every score
+as time passes, a run at time t adds 2^((t - base) / half life) for a fixed base, so older runs simply
+weigh less and scores compare the same whatever the time is now. The base only moves (scaling every score
+by the same factor) when the weights grow large, and when the file is written.
+
+Scores live in an open addressing hash table keyed by FNV-1a of the name, a lookup per completion candidate
+is one probe or two. The file is a small binary log of name + score written at exit: the file is read again
+then, so runs another session saved meanwhile are kept and this session's own runs added on top, and it
+replaces the old one with a rename. Two shells exiting at the same moment can still lose one's runs.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "frecency.h"
+#include "arena.h"
+
+#define FRECENCY_MAGIC "CSHFREC1"
+#define FRECENCY_REBASE 64.0 // half lives after base before every score is scaled down, keeps them far from overflow
+
+typedef struct frecency_entry frecency_entry;
+struct frecency_entry {
+    const char* name;
+    uint32_t len;
+    uint64_t hash;
+    double score; // relative to base, everything this shell knows of
+    double added; // the part of score from runs in this shell, not in the file yet
+};
+
+// file layout: header, then count records of a double score, a one byte length and the name
+typedef struct frecency_header frecency_header;
+struct frecency_header {
+    char magic[8];
+    int64_t base;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+static bool opened = false;
+static time_t base = 0;
+static arena names; // zeroed is an empty arena
+static frecency_entry* entries = NULL;
+static size_t num_entries = 0;
+static size_t entries_cap = 0;
+static uint32_t* slots = NULL; // hash table of index + 1, 0 if empty
+static size_t slots_cap = 0;
+
+static int frecency_file_path(char* buf, size_t buf_len);
+static uint64_t hash_name(const char* name, size_t len);
+static frecency_entry* find(const char* name, size_t len, uint64_t hash);
+static frecency_entry* insert(const char* name, size_t len);
+static void grow_slots(void);
+static void rebase(time_t now);
+static void load(const char* file, bool merge);
+static void save(const char* file, time_t now);
+static int compare_scores(const void* a, const void* b);
+
+/// @brief load the scores saved by earlier sessions, frecency_close() saves them again
+void frecency_open(void) {
+    char file[PATH_MAX];
+    opened = true;
+    base = time(NULL);
+    if (frecency_file_path(file, sizeof(file)) == 0) load(file, false);
+}
+
+/// @brief count a run of the command name now
+void frecency_add(const char* name) {
+    if (!opened) return; // a script, nothing would save it
+    time_t now = time(NULL);
+    if ((double) (now - base) / FRECENCY_HALF_LIFE > FRECENCY_REBASE) rebase(now);
+    double weight = exp2((double) (now - base) / FRECENCY_HALF_LIFE);
+    frecency_entry* e = insert(name, strlen(name));
+    e->score += weight;
+    e->added += weight;
+}
+
+/// @brief O(1)
+/// @return name's score, 0 if it was never run, only meaningful compared with other scores
+double frecency_score(const char* name, size_t len) {
+    if (num_entries == 0) return 0;
+    frecency_entry* e = find(name, len, hash_name(name, len));
+    return e ? e->score : 0;
+}
+
+/// @brief the highest scoring command that starts with prefix and that accept() takes, e.g. one that still exists
+/// @return NULL if none, valid until frecency_close()
+const char* frecency_best(const char* prefix, bool (*accept)(const char* name)) {
+    size_t prefix_len = strlen(prefix);
+    const frecency_entry* best = NULL;
+    for (size_t i = 0; i < num_entries; ++i) { // at most a few thousand, the file is trimmed to FRECENCY_MAX_ENTRIES
+        const frecency_entry* e = &entries[i];
+        if (e->len < prefix_len || memcmp(e->name, prefix, prefix_len)) continue;
+        if (best && e->score <= best->score) continue;
+        if (accept(e->name)) best = e;
+    }
+    return best ? best->name : NULL;
+}
+
+/// @brief save this session's runs merged with the file, and free everything
+void frecency_close(void) {
+    char file[PATH_MAX];
+    if (opened && frecency_file_path(file, sizeof(file)) == 0) {
+        // * what the file holds now replaces what was loaded at startup, this session's runs go on top
+        for (size_t i = 0; i < num_entries; ++i) {
+            entries[i].score -= entries[i].added;
+        }
+        load(file, true);
+        for (size_t i = 0; i < num_entries; ++i) {
+            entries[i].score += entries[i].added;
+        }
+        save(file, time(NULL));
+    }
+    arena_free(&names);
+    free(entries);
+    free(slots);
+    entries = NULL;
+    slots = NULL;
+    num_entries = entries_cap = slots_cap = 0;
+    base = 0;
+    opened = false;
+}
+
+/// @brief ~/.cshell_frecency
+/// @return 0 on success, -1 if there is no home to keep it in
+static int frecency_file_path(char* buf, size_t buf_len) {
+    const char* home = getenv("HOME");
+    if (!home || !*home) return -1;
+    int len = snprintf(buf, buf_len, "%s/%s", home, FRECENCY_FILE_NAME);
+    return (len < 0 || (size_t) len >= buf_len) ? -1 : 0;
+}
+
+static uint64_t hash_name(const char* name, size_t len) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char) name[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static frecency_entry* find(const char* name, size_t len, uint64_t hash) {
+    if (slots_cap == 0) return NULL;
+    for (size_t i = hash & (slots_cap - 1);; i = (i + 1) & (slots_cap - 1)) {
+        if (slots[i] == 0) return NULL;
+        frecency_entry* e = &entries[slots[i] - 1];
+        if (e->hash == hash && e->len == len && !memcmp(e->name, name, len)) return e;
+    }
+}
+
+/// @brief the entry for name, a new one with a score of 0 if there was none
+static frecency_entry* insert(const char* name, size_t len) {
+    uint64_t hash = hash_name(name, len);
+    frecency_entry* e = find(name, len, hash);
+    if (e) return e;
+
+    if (num_entries == entries_cap) {
+        entries_cap = entries_cap ? entries_cap * 2 : FRECENCY_INIT_CAP;
+        entries = realloc(entries, entries_cap * sizeof(frecency_entry));
+    }
+    if ((num_entries + 1) * 2 > slots_cap) grow_slots(); // at most half full
+    e = &entries[num_entries++];
+    *e = (frecency_entry) {.name = arena_strndup(&names, name, len), .len = (uint32_t) len, .hash = hash};
+    size_t i = hash & (slots_cap - 1);
+    while (slots[i]) {
+        i = (i + 1) & (slots_cap - 1);
+    }
+    slots[i] = (uint32_t) num_entries;
+    return e;
+}
+
+static void grow_slots(void) {
+    slots_cap = slots_cap ? slots_cap * 2 : FRECENCY_INIT_CAP;
+    free(slots);
+    slots = calloc(slots_cap, sizeof(uint32_t));
+    for (size_t k = 0; k < num_entries; ++k) {
+        size_t i = entries[k].hash & (slots_cap - 1);
+        while (slots[i]) {
+            i = (i + 1) & (slots_cap - 1);
+        }
+        slots[i] = (uint32_t) (k + 1);
+    }
+}
+
+/// @brief move base to now, scaling every score down by the weight it had
+static void rebase(time_t now) {
+    double scale = exp2(-(double) (now - base) / FRECENCY_HALF_LIFE);
+    for (size_t i = 0; i < num_entries; ++i) {
+        entries[i].score *= scale;
+        entries[i].added *= scale;
+    }
+    base = now;
+}
+
+/// @brief read the file's scores in
+/// @param merge false to add them to what's there (startup), true to replace the scores of the names it has
+static void load(const char* file, bool merge) {
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+    struct stat st;
+    char* data = NULL;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(frecency_header)) {
+        data = malloc(st.st_size);
+        if (read(fd, data, st.st_size) != st.st_size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    close(fd);
+    if (data == NULL) return;
+
+    frecency_header header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, FRECENCY_MAGIC, sizeof(header.magic)) == 0) {
+        double scale = exp2((double) (header.base - base) / FRECENCY_HALF_LIFE); // from the file's base to ours
+        const char* p = data + sizeof(header);
+        const char* end = data + st.st_size;
+        for (uint32_t i = 0; i < header.count; ++i) {
+            if (end - p < (ptrdiff_t) (sizeof(double) + 1)) break; // truncated
+            double score;
+            memcpy(&score, p, sizeof(double));
+            size_t len = (unsigned char) p[sizeof(double)];
+            p += sizeof(double) + 1;
+            if ((size_t) (end - p) < len) break;
+            frecency_entry* e = insert(p, len);
+            e->score = (merge ? 0 : e->score) + score * scale;
+            p += len;
+        }
+    }
+    free(data);
+}
+
+/// @brief write the best FRECENCY_MAX_ENTRIES scores, rebased to now, to a temp file renamed over file
+static void save(const char* file, time_t now) {
+    rebase(now);
+    frecency_entry** sorted = malloc((num_entries + 1) * sizeof(frecency_entry*));
+    size_t count = 0;
+    for (size_t i = 0; i < num_entries; ++i) {
+        if (entries[i].score >= FRECENCY_MIN_SCORE && entries[i].len <= UCHAR_MAX) sorted[count++] = &entries[i];
+    }
+    qsort(sorted, count, sizeof(frecency_entry*), compare_scores);
+    if (count > FRECENCY_MAX_ENTRIES) count = FRECENCY_MAX_ENTRIES;
+
+    size_t size = sizeof(frecency_header);
+    for (size_t i = 0; i < count; ++i) {
+        size += sizeof(double) + 1 + sorted[i]->len;
+    }
+    char* data = malloc(size);
+    frecency_header header = {.base = (int64_t) now, .count = (uint32_t) count};
+    memcpy(header.magic, FRECENCY_MAGIC, sizeof(header.magic));
+    memcpy(data, &header, sizeof(header));
+    char* p = data + sizeof(header);
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(p, &sorted[i]->score, sizeof(double));
+        p[sizeof(double)] = (char) sorted[i]->len;
+        memcpy(p + sizeof(double) + 1, sorted[i]->name, sorted[i]->len);
+        p += sizeof(double) + 1 + sorted[i]->len;
+    }
+    free(sorted);
+
+    char tmp[PATH_MAX + 32];
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", file, (long) getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd != -1) {
+        bool ok = write(fd, data, size) == (ssize_t) size;
+        close(fd);
+        if (!ok || rename(tmp, file)) unlink(tmp);
+    }
+    free(data);
+}
+
+static int compare_scores(const void* a, const void* b) {
+    double x = (*(frecency_entry* const*) a)->score;
+    double y = (*(frecency_entry* const*) b)->score;
+    return (x < y) - (x > y);
+}
@@ -0,0 +1,19 @@
+#ifndef FRECENCY_H
+#define FRECENCY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define FRECENCY_FILE_NAME ".cshell_frecency" // in $HOME
+#define FRECENCY_HALF_LIFE (7 * 24 * 3600)    // seconds until a run counts half as much
+#define FRECENCY_MAX_ENTRIES 1024             // commands kept in the file, the lowest scores go first
+#define FRECENCY_MIN_SCORE (1.0 / 1024)       // dropped from the file below this, one run ten half lives ago
+#define FRECENCY_INIT_CAP 64                  // must be a power of two
+
+void        frecency_open(void);
+void        frecency_add(const char* name);
+double      frecency_score(const char* name, size_t len);
+const char* frecency_best(const char* prefix, bool (*accept)(const char* name));
+void        frecency_close(void);
+
+#endif
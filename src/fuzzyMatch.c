@@ -0,0 +1,181 @@
+/*
+Fuzzy (subsequence) matching for completion, `set -o fuzzy`.
+
+A query matches a name when its characters appear in the name in the same order, so `gcm` finds
+git-credential-manager and `kctl` finds kubectl. The candidates are kept back to back in one buffer, and
+every query character is looked for 16 bytes at a time with SSE2 where the compiler has it. Most names
+don't match and are dropped after a block or two, only the ones that do get scored.
+
+The score is fzf's v1 algorithm: take the first place the whole query fits, shrink it to the shortest
+window ending there, then add points for every matched character, bonuses for the start of a word and
+for runs of matches, and a penalty for every character skipped. A query without uppercase letters
+matches either case, one with an uppercase letter only its exact case.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fuzzyMatch.h"
+
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_BOUNDARY 8          // first character of the name or of a word in it, after '-', '_', '.'...
+#define BONUS_CAMEL 7             // uppercase after lowercase, or the first digit of a number
+#define BONUS_CONSECUTIVE 4       // right after the previous match, at least
+#define BONUS_FIRST_MULTIPLIER 2  // the first query character says the most about what was meant
+
+static size_t find_byte(const char* s, size_t from, size_t len, unsigned char c, bool fold);
+static bool score_name(const char* name, size_t len, const char* query, size_t query_len, bool fold, int* score);
+static int bonus_at(const char* name, size_t i);
+static int compare_matches(const void* a, const void* b);
+
+static inline bool is_lower(unsigned char c) { return c >= 'a' && c <= 'z'; }
+static inline bool is_upper(unsigned char c) { return c >= 'A' && c <= 'Z'; }
+static inline bool is_digit(unsigned char c) { return c >= '0' && c <= '9'; }
+static inline bool is_word(unsigned char c) { return is_lower(c) || is_upper(c) || is_digit(c) || c >= 0x80; }
+
+// c is lowercase whenever fold is set, see fuzzy_rank()
+static inline bool same_char(unsigned char x, unsigned char c, bool fold) {
+    return (fold && is_lower(c) ? (x | 0x20) : x) == c;
+}
+
+void fuzzy_set_init(fuzzy_set* s) {
+    memset(s, 0, sizeof(fuzzy_set));
+}
+
+void fuzzy_set_add(fuzzy_set* s, const char* name, size_t len) {
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : FUZZY_INIT_CAP;
+        s->spans = realloc(s->spans, s->cap * sizeof(fuzzy_span));
+    }
+    if (s->names_len + len + 1 + FUZZY_PAD > s->names_cap) {
+        if (s->names_cap == 0) s->names_cap = FUZZY_INIT_BYTES;
+        while (s->names_len + len + 1 + FUZZY_PAD > s->names_cap) {
+            s->names_cap *= 2;
+        }
+        s->names = realloc(s->names, s->names_cap);
+    }
+    memcpy(s->names + s->names_len, name, len);
+    s->spans[s->count++] = (fuzzy_span) {.offset = (uint32_t) s->names_len, .len = (uint32_t) len};
+    s->names_len += len + 1;
+    memset(s->names + s->names_len - 1, 0, 1 + FUZZY_PAD); // NUL, and padding that's never uninitialized
+}
+
+/// @brief drop every name but keep the buffers
+void fuzzy_set_clear(fuzzy_set* s) {
+    s->names_len = 0;
+    s->count = 0;
+}
+
+void fuzzy_set_free(fuzzy_set* s) {
+    free(s->names);
+    free(s->spans);
+    fuzzy_set_init(s);
+}
+
+/// @brief score every name in s against query
+/// @param out room for s->count matches
+/// @return how many names matched, in out best first: highest score, then shortest, then in the order they were added
+size_t fuzzy_rank(const fuzzy_set* s, const char* query, fuzzy_match* out) {
+    size_t query_len = strlen(query);
+    bool fold = true; // smart case, like fzf
+    for (size_t q = 0; q < query_len; ++q) {
+        if (is_upper(query[q])) fold = false;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < s->count; ++i) {
+        int score = 0;
+        if (query_len && !score_name(fuzzy_name(s, i), s->spans[i].len, query, query_len, fold, &score)) continue;
+        out[n++] = (fuzzy_match) {.index = (uint32_t) i, .len = s->spans[i].len, .score = score};
+    }
+    if (query_len && n > 1) qsort(out, n, sizeof(fuzzy_match), compare_matches); // an empty query keeps the given order
+    return n;
+}
+
+/// @brief index of the first c in s[from, len), either case of a letter when fold is set
+/// * the SSE2 loop reads up to 15 bytes past len, into the next names or the set's padding
+/// @return len if there is none
+static size_t find_byte(const char* s, size_t from, size_t len, unsigned char c, bool fold) {
+    bool fold_c = fold && is_lower(c);
+#ifdef __SSE2__
+    const __m128i needle = _mm_set1_epi8((char) c);
+    const __m128i case_bit = _mm_set1_epi8(fold_c ? 0x20 : 0);
+    for (size_t i = from; i < len; i += 16) {
+        __m128i block = _mm_or_si128(_mm_loadu_si128((const __m128i*) (s + i)), case_bit);
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (len - i < 16) mask &= (1u << (len - i)) - 1;
+        if (mask) return i + (size_t) __builtin_ctz(mask);
+    }
+#else
+    for (size_t i = from; i < len; ++i) {
+        if (same_char((unsigned char) s[i], c, fold_c)) return i;
+    }
+#endif
+    return len;
+}
+
+/// @brief fzf v1: the shortest window ending where the query first fits, scored left to right
+/// @return false if query isn't a subsequence of name
+static bool score_name(const char* name, size_t len, const char* query, size_t query_len, bool fold, int* score) {
+    size_t end = 0;
+    size_t pos = 0;
+    for (size_t q = 0; q < query_len; ++q) {
+        pos = find_byte(name, pos, len, (unsigned char) query[q], fold);
+        if (pos == len) return false;
+        end = pos++;
+    }
+    // * walking back from the end always succeeds, the forward pass found every character before it
+    size_t start = end + 1;
+    for (size_t q = query_len; q-- > 0;) {
+        do {
+            --start;
+        } while (!same_char((unsigned char) name[start], (unsigned char) query[q], fold));
+    }
+
+    int total = 0;
+    size_t q = 0;
+    bool prev_matched = false;
+    bool in_gap = false;
+    for (size_t i = start; i <= end && q < query_len; ++i) {
+        if (same_char((unsigned char) name[i], (unsigned char) query[q], fold)) {
+            int bonus = bonus_at(name, i);
+            if (prev_matched && bonus < BONUS_CONSECUTIVE) bonus = BONUS_CONSECUTIVE;
+            total += SCORE_MATCH + (q == 0 ? bonus * BONUS_FIRST_MULTIPLIER : bonus);
+            ++q;
+            prev_matched = true;
+            in_gap = false;
+        } else {
+            total += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            prev_matched = false;
+            in_gap = true;
+        }
+    }
+    *score = total;
+    return true;
+}
+
+static int bonus_at(const char* name, size_t i) {
+    unsigned char cur = (unsigned char) name[i];
+    unsigned char prev = i ? (unsigned char) name[i - 1] : 0;
+    if (!is_word(cur)) return 0;
+    if (i == 0 || !is_word(prev)) return BONUS_BOUNDARY;
+    if ((is_lower(prev) && is_upper(cur)) || (!is_digit(prev) && is_digit(cur))) return BONUS_CAMEL;
+    return 0;
+}
+
+static int compare_matches(const void* a, const void* b) {
+    const fuzzy_match* x = a;
+    const fuzzy_match* y = b;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    if (x->len != y->len) return x->len < y->len ? -1 : 1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
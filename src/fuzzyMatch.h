@@ -0,0 +1,46 @@
+#ifndef FUZZYMATCH_H
+#define FUZZYMATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FUZZY_PAD 16          // readable bytes past the last name, the matcher loads 16 at a time
+#define FUZZY_INIT_CAP 256    // names
+#define FUZZY_INIT_BYTES 4096
+
+typedef struct fuzzy_span fuzzy_span;
+struct fuzzy_span {
+    uint32_t offset; // into names
+    uint32_t len;
+};
+
+// the candidates of a fuzzy completion, every name NUL terminated back to back in one buffer
+typedef struct fuzzy_set fuzzy_set;
+struct fuzzy_set {
+    char* names;
+    size_t names_len;
+    size_t names_cap;
+    fuzzy_span* spans;
+    size_t count;
+    size_t cap;
+};
+
+// one name the query is a subsequence of
+typedef struct fuzzy_match fuzzy_match;
+struct fuzzy_match {
+    uint32_t index; // into the set's spans
+    uint32_t len;
+    int32_t score;
+};
+
+static inline const char* fuzzy_name(const fuzzy_set* s, size_t i) {
+    return s->names + s->spans[i].offset;
+}
+
+void   fuzzy_set_init(fuzzy_set* s);
+void   fuzzy_set_add(fuzzy_set* s, const char* name, size_t len);
+void   fuzzy_set_clear(fuzzy_set* s);
+void   fuzzy_set_free(fuzzy_set* s);
+size_t fuzzy_rank(const fuzzy_set* s, const char* query, fuzzy_match* out);
+
+#endif
@@ -1,100 +1,139 @@
 /*
-History feature for shell, up/down arrow, listing history.
+History feature for shell, up/down arrow, reverse search (Ctrl-R), listing history.
 */
 
 #define _DEFAULT_SOURCE
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <ctype.h>
 #include <curses.h>
 #include <readline/readline.h>
 
 #include "history.h"
 #include "historyList.h"
+#include "historySearch.h"
+
+#define SEARCH_QUERY_CAP 256
 
 history_list* history = NULL;
 
-static bool first_up_press = true;
-static char* unsaved_text = NULL;
+static char* unsaved_text = NULL; // line being typed when UP was first pressed
+
+static void show_line(const char* line);
+static void show_match(const char* match, const char* query);
 
 void init_history_readline(void) {
     rl_bind_keyseq("\033[A", history_up_arrow);
     rl_bind_keyseq("\033[B", history_down_arrow);
+    rl_bind_keyseq("\\C-r", history_reverse_search);
 }
 
-int history_up_arrow(int count, int key) {
-    char* line = NULL;
+static void show_line(const char* line) {
+    rl_replace_line(line, 0);
+    rl_point = strlen(line);
+    rl_redisplay();
+}
 
-    if (!history || !history->curr) return 0;
+int history_up_arrow(int count, int key) {
+    if (!history || history->curr == 0) return 0;
 
-    if (first_up_press) { // save line and go to tail
+    if (history->curr == history->len) { // leaving the line being typed, save it for the way back down
         free(unsaved_text);
         unsaved_text = strdup(rl_line_buffer);
-        line = history->curr->cmd;
-        first_up_press = false;
-    } 
-    else if (history->curr->prev) {
-        line = history->curr->prev->cmd;
-        history->curr = history->curr->prev;
-    } 
-    else {
-        return 0;
     }
-    
-    rl_replace_line(line, 0);  
-    rl_point = strlen(line);
-    rl_redisplay();
-    
+    --history->curr;
+    show_line(history_at(history, history->curr));
     return 0;
 }
 
 int history_down_arrow(int count, int key) {
-    char* line = NULL;
-
-    if (!history || !history->curr) return 0;
-
-    if (history->curr->next) {
-        line = history->curr->next->cmd;
-        history->curr = history->curr->next;
-    } 
-    // at tail but not displaying unsaved line buffer before first UP was pressed
-    else if (!first_up_press) {
-        line = unsaved_text;
-        first_up_press = true;
-        rl_replace_line(line, 0);
-        rl_point = strlen(line);
-        rl_redisplay();
-        free(unsaved_text);
-        unsaved_text = NULL;
-        return 0;
-    } 
-    else { 
+    if (!history || history->curr >= history->len) return 0;
+
+    ++history->curr;
+    if (history->curr < history->len) {
+        show_line(history_at(history, history->curr));
         return 0;
     }
+    // back past the newest entry, to the line that was being typed before the first UP
+    show_line(unsaved_text ? unsaved_text : "");
+    free(unsaved_text);
+    unsaved_text = NULL;
+    return 0;
+}
 
-    rl_replace_line(line, 0);
-    rl_point = strlen(line);
+static void show_match(const char* match, const char* query) {
+    rl_replace_line(match, 0);
+    rl_point = strstr(match, query) - match; // cursor on the match like bash
     rl_redisplay();
+}
 
+/// @brief incremental reverse search, bound to Ctrl-R
+/// * typing narrows the search, Ctrl-R again steps to the next best match, backspace widens it again,
+/// * Ctrl-G puts the original line back, any other key leaves the match on the line and is then handled as usual
+int history_reverse_search(int count, int key) {
+    if (!history) return 0;
+
+    char* original = strdup(rl_line_buffer);
+    int original_point = rl_point;
+    char query[SEARCH_QUERY_CAP] = "";
+    size_t query_len = 0;
+    search_result results[SEARCH_MAX_RESULTS];
+    size_t num_results = 0;
+    size_t selected = 0;
+
+    while (1) {
+        rl_message("(%sreverse-i-search)`%s': ", (query_len && !num_results) ? "failed " : "", query);
+        if (num_results) {
+            show_match(history_get(history, results[selected].num), query);
+        } else {
+            rl_redisplay(); // a failed search keeps showing the last match
+        }
+
+        int c = rl_read_key();
+        if (c == CTRL('r')) {
+            if (selected + 1 < num_results) ++selected;
+            continue;
+        }
+        if (c == CTRL('g')) {
+            rl_replace_line(original, 0);
+            rl_point = original_point;
+            break;
+        }
+        if (c == RUBOUT || c == CTRL('h')) {
+            if (query_len) query[--query_len] = '\0';
+        } else if (c != EOF && isprint(c) && query_len < SEARCH_QUERY_CAP - 1) {
+            query[query_len++] = c;
+            query[query_len] = '\0';
+        } else {
+            if (c != EOF) rl_execute_next(c); // Enter runs the match, arrows and the like edit it
+            if (num_results) { // the arrow keys carry on from the match
+                if (history->curr == history->len) {
+                    free(unsaved_text);
+                    unsaved_text = strdup(original);
+                }
+                history->curr = results[selected].num - history->base;
+            }
+            break;
+        }
+        num_results = history_search(history, query, results);
+        selected = 0;
+    }
+    free(original);
+    rl_clear_message();
     return 0;
 }
 
 void list_history(int n) {
+    if (!history) return; // scripts keep no history
       // * i need to check negative separately before safely casting, otherwise 0xFFFFF(...) is always larger than any size_t value
     if ((n > 0) && ((size_t) n > history->len)) {
         printf("input length exceeds history length, history length = %zu\n", history->len);
         return;
     }
 
-    int list_start = (n != -1) ? history->len - n : 0;
-    history_node* temp = history->head;
-
-    for (size_t i = 0; i < list_start; ++i) {
-        temp = temp->next;
-    }
-
-    for (size_t i = list_start; temp != NULL; ++i) {
-        printf("\t%ld  %s\n", i + history->base, temp->cmd);
-        temp = temp->next;
+    size_t list_start = (n != -1) ? history->len - n : 0;
+    for (size_t i = list_start; i < history->len; ++i) {
+        printf("\t%zu  %s\n", i + history->base, history_at(history, i));
     }
 }
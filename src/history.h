@@ -9,6 +9,7 @@ void  list_history(int n);
 
 int   history_up_arrow(int count, int key);
 int   history_down_arrow(int count, int key);
+int   history_reverse_search(int count, int key);
 
 void  init_history_readline(void);
 
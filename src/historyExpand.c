@@ -0,0 +1,190 @@
+/*
+Bash style history expansion, applied to the line before it is tokenized.
+
+    !!          the previous command
+    !n  !-n     command number n as `history` lists it, the n'th previous one
+    !prefix     the newest command starting with prefix
+    ^old^new^   the previous command with the first old replaced by new, only at the start of the line
+
+Nothing is expanded inside single quotes, after a backslash, or when the '!' is followed by a blank, '=' or '('.
+
+!prefix is answered by a radix trie of every distinct command, where each node keeps the newest history number
+of the commands below it (trie_set_value), so the lookup walks the prefix and nothing else, however long
+the history is. Like the Ctrl-R index the trie catches up with new entries lazily and is rebuilt once the
+history ring has turned over.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "historyExpand.h"
+#include "prefixTree.h"
+
+typedef struct expand_buf expand_buf;
+struct expand_buf {
+    char* data;
+    size_t len;
+    size_t cap;
+};
+
+static trie* prefix_index = NULL;
+static history_list* indexed = NULL;
+static size_t indexed_upto = 0;
+static size_t built_base = 0;
+
+static void sync_index(history_list* h);
+static void buf_append(expand_buf* buf, const char* s, size_t n);
+static size_t resolve_event(history_list* h, const char* p, const char** event);
+static int quick_substitution(history_list* h, const char* line, char** expanded);
+
+/// @brief index every entry added since the last call, rebuilding once the ring turned over
+static void sync_index(history_list* h) {
+    if (prefix_index == NULL || h != indexed || h->base > built_base + h->cap || indexed_upto > h->base + h->len) {
+        trie_free(prefix_index);
+        prefix_index = trie_create();
+        indexed = h;
+        built_base = h->base;
+        indexed_upto = h->base;
+    }
+    size_t end = h->base + h->len;
+    for (size_t num = indexed_upto > h->base ? indexed_upto : h->base; num < end; ++num) {
+        char* cmd = (char*) history_get(h, num);
+        trie_insert(prefix_index, cmd);
+        trie_set_value(prefix_index, cmd, num); // numbers only grow, so this always becomes the newest along the path
+    }
+    indexed_upto = end;
+}
+
+static void buf_append(expand_buf* buf, const char* s, size_t n) {
+    if (buf->len + n + 1 > buf->cap) {
+        while (buf->len + n + 1 > buf->cap) {
+            buf->cap = buf->cap ? buf->cap * 2 : 128;
+        }
+        buf->data = realloc(buf->data, buf->cap);
+    }
+    memcpy(buf->data + buf->len, s, n);
+    buf->len += n;
+    buf->data[buf->len] = '\0';
+}
+
+/// @brief find the command an event designator after a '!' refers to
+/// @param p just past the '!'
+/// @param event set to the command, NULL if there is no such event
+/// @return bytes of p the designator takes up, 0 if p doesn't start one and the '!' is literal
+static size_t resolve_event(history_list* h, const char* p, const char** event) {
+    size_t newest = h->base + h->len - 1;
+    *event = NULL;
+    if (*p == '!') {
+        *event = h->len ? history_get(h, newest) : NULL;
+        return 1;
+    }
+    if (isdigit((unsigned char) *p) || (*p == '-' && isdigit((unsigned char) p[1]))) {
+        char* end = NULL;
+        long n = strtol(p, &end, 10);
+        if (n > 0) {
+            *event = history_get(h, n);
+        } else if (n < 0 && (size_t) -n <= h->len) {
+            *event = history_get(h, newest + 1 + n);
+        }
+        return end - p;
+    }
+
+    // !prefix runs to the next blank or shell metacharacter
+    size_t len = strcspn(p, " \t;&|<>()\"'");
+    if (len == 0) return 0;
+    char prefix[AC_BUF_CAP];
+    if (len >= sizeof(prefix)) return len;
+    memcpy(prefix, p, len);
+    prefix[len] = '\0';
+    sync_index(h);
+    trie* subtree = trie_find_prefix(prefix_index, prefix);
+    if (subtree) *event = history_get(h, subtree->value); // NULL if even the newest one was dropped from the ring
+    return len;
+}
+
+/// @brief ^old^new^: the previous command with the first old replaced by new
+/// @return 1 if expanded, -1 on error
+static int quick_substitution(history_list* h, const char* line, char** expanded) {
+    const char* old = line + 1;
+    const char* old_end = strchr(old, '^');
+    const char* new = old_end ? old_end + 1 : old + strlen(old);
+    const char* new_end = strchr(new, '^');
+    size_t old_len = old_end ? (size_t) (old_end - old) : strlen(old);
+    size_t new_len = new_end ? (size_t) (new_end - new) : strlen(new);
+    const char* rest = new_end ? new_end + 1 : new + new_len;
+
+    const char* prev = h->len ? history_at(h, h->len - 1) : NULL;
+    const char* found = NULL;
+    if (prev && old_len) {
+        char* pattern = strndup(old, old_len);
+        found = strstr(prev, pattern);
+        free(pattern);
+    }
+    if (found == NULL) {
+        fprintf(stderr, "%s: substitution failed\n", line);
+        return -1;
+    }
+
+    expand_buf buf = {0};
+    buf_append(&buf, prev, found - prev);
+    buf_append(&buf, new, new_len);
+    buf_append(&buf, found + old_len, strlen(found + old_len));
+    buf_append(&buf, rest, strlen(rest));
+    *expanded = buf.data;
+    return 1;
+}
+
+/// @brief expand history references in line
+/// @param expanded set to the expanded line when there was something to expand, MUST BE FREE'D BY CALLER
+/// @return 1 if expanded, 0 if the line has no history references, -1 on error (already reported)
+int history_expand(history_list* h, const char* line, char** expanded) {
+    *expanded = NULL;
+    if (line[0] == '^') return quick_substitution(h, line, expanded);
+    if (!strchr(line, '!')) return 0;
+
+    expand_buf buf = {0};
+    bool in_single = false;
+    bool in_double = false;
+    bool changed = false;
+    const char* copied = line; // start of the bytes not appended to buf yet
+    for (const char* p = line; *p; ++p) {
+        if (*p == '\\' && !in_single && p[1]) {
+            ++p; // an escaped '!' stays for the tokenizer to unescape
+            continue;
+        }
+        if (*p == '\'' && !in_double) in_single = !in_single;
+        if (*p == '"' && !in_single) in_double = !in_double;
+        if (*p != '!' || in_single) continue;
+        char next = p[1];
+        if (next == '\0' || next == ' ' || next == '\t' || next == '=' || next == '(' || (in_double && next == '"')) continue;
+
+        const char* event = NULL;
+        size_t len = resolve_event(h, p + 1, &event);
+        if (len == 0) continue;
+        if (event == NULL) {
+            fprintf(stderr, "!%.*s: event not found\n", (int) len, p + 1);
+            free(buf.data);
+            return -1;
+        }
+        buf_append(&buf, copied, p - copied);
+        buf_append(&buf, event, strlen(event));
+        copied = p + 1 + len;
+        p += len;
+        changed = true;
+    }
+    if (!changed) return 0;
+    buf_append(&buf, copied, strlen(copied));
+    *expanded = buf.data;
+    return 1;
+}
+
+void history_expand_free(void) {
+    trie_free(prefix_index);
+    prefix_index = NULL;
+    indexed = NULL;
+}
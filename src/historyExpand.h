@@ -0,0 +1,9 @@
+#ifndef HISTORYEXPAND_H
+#define HISTORYEXPAND_H
+
+#include "historyList.h"
+
+int  history_expand(history_list* h, const char* line, char** expanded);
+void history_expand_free(void);
+
+#endif
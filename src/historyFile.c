@@ -0,0 +1,203 @@
+/*
+Persistent history, shared by every shell writing to the same file.
+
+The file is an append-only log of commands, one per line. Each new command is a single write() on an
+O_APPEND descriptor, so concurrent sessions never interleave within an entry and nothing is ever rewritten.
+At startup the file is mmap'd and the history list copies out only the last HISTSIZE lines, found with
+memrchr from the end, so a long history file costs no more to load than a short one.
+
+Entries other live sessions append after startup are merged with `history -n`, which reads the log from
+where this shell last stopped and skips the records this shell wrote itself (their offsets are known
+from the descriptor's own file position after each write).
+*/
+
+#define _GNU_SOURCE // memrchr
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "historyFile.h"
+#include "history.h"
+#include "redirect.h"
+
+static int log_fd = -1;
+static off_t read_pos = 0;      // everything before this is in the list, always just past a newline
+static off_t* own_records = NULL; // start of each record this shell appended at or after read_pos, ascending
+static size_t num_own = 0;
+static size_t own_cap = 0;
+
+static int history_file_path(char* buf, size_t buf_len);
+static size_t read_range(history_list* h, int fd, off_t from, off_t to, off_t* stop);
+
+/// @brief $HISTFILE, or ~/.cshell_history
+/// @return 0 on success, -1 if history shouldn't be saved (HISTFILE set to "" or no home)
+static int history_file_path(char* buf, size_t buf_len) {
+    const char* histfile = getenv("HISTFILE");
+    const char* home = getenv("HOME");
+    int len = 0;
+    if (histfile) {
+        if (!*histfile) return -1;
+        len = snprintf(buf, buf_len, "%s", histfile);
+    } else if (home && *home) {
+        len = snprintf(buf, buf_len, "%s/%s", home, HISTORY_FILE_NAME);
+    } else {
+        return -1;
+    }
+    return (len < 0 || (size_t) len >= buf_len) ? -1 : 0;
+}
+
+/// @brief add the complete lines of fd's [from, to) to the history, the whole file is mapped rather than read
+/// @param stop set to just past the last newline read, the partial line after it is left for next time
+/// @return number of entries added
+static size_t read_range(history_list* h, int fd, off_t from, off_t to, off_t* stop) {
+    *stop = from;
+    if (to <= from) return 0;
+    size_t len = to - from;
+    size_t added = 0;
+
+    if (from == 0) { // startup and -r, the list only copies out the last HISTSIZE lines
+        char* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) return 0;
+        char* last_nl = memrchr(map, '\n', len); // cut the partial line a concurrent writer might still be in the middle of
+        len = last_nl ? (size_t) (last_nl - map) + 1 : 0;
+        added = add_history_lines(h, map, len);
+        munmap(map, to - from);
+        *stop = len;
+        num_own = 0; // none of our records can be past what was just read
+        return added;
+    }
+
+    // the tail other sessions appended, usually small
+    char* strings = malloc(len);
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(fd, strings + got, len - got, from + got);
+        if (n <= 0) break;
+        got += n;
+    }
+    char* last_nl = memrchr(strings, '\n', got);
+    len = last_nl ? (size_t) (last_nl - strings) + 1 : 0;
+    *stop = from + len;
+
+    // records this shell wrote are already in the list, blank them into empty lines which the list skips
+    size_t kept = 0;
+    for (size_t i = 0; i < num_own; ++i) {
+        off_t rec = own_records[i];
+        if (rec < from || rec >= *stop) {
+            if (rec >= *stop) own_records[kept++] = rec;
+            continue;
+        }
+        char* p = strings + (rec - from);
+        char* nl = memchr(p, '\n', strings + len - p);
+        memset(p, '\n', nl - p);
+    }
+    num_own = kept;
+
+    added = add_history_lines(h, strings, len);
+    free(strings);
+    return added;
+}
+
+/// @brief open the history file for appending and load everything already in it
+/// @return 0 on success, 1 if there is no history file to use
+int history_file_open(history_list* h) {
+    char path[PATH_MAX];
+    if (history_file_path(path, sizeof(path))) return 1;
+
+    log_fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (log_fd == -1) return 1;
+    log_fd = redirect_fd_high(log_fd);
+    struct stat st;
+    if (fstat(log_fd, &st) == -1) {
+        history_file_close();
+        return 1;
+    }
+    read_range(h, log_fd, 0, st.st_size, &read_pos);
+    return 0;
+}
+
+void history_file_close(void) {
+    if (log_fd != -1) close(log_fd);
+    log_fd = -1;
+    free(own_records);
+    own_records = NULL;
+    num_own = own_cap = 0;
+    read_pos = 0;
+}
+
+/// @brief append cmd to the history file as one record
+/// * a single write on an O_APPEND descriptor, so another session's entry can never land inside it
+/// @return 0 on success, 1 if it couldn't be saved
+int history_file_append(const char* cmd) {
+    if (log_fd == -1) return 1;
+
+    size_t len = strlen(cmd);
+    char* record = malloc(len + 1);
+    memcpy(record, cmd, len);
+    record[len] = '\n';
+    ssize_t n = write(log_fd, record, len + 1);
+    free(record);
+    if (n != (ssize_t) len + 1) return 1; // a short write leaves a partial line, which readers wait out
+
+    // O_APPEND moved this descriptor's offset to just past our record, whatever the others wrote since
+    off_t end = lseek(log_fd, 0, SEEK_CUR);
+    if (end != -1) {
+        if (num_own == own_cap) {
+            own_cap = own_cap ? own_cap * 2 : 16;
+            own_records = realloc(own_records, own_cap * sizeof(off_t));
+        }
+        own_records[num_own++] = end - (off_t) (len + 1);
+    }
+    return 0;
+}
+
+/// @brief merge the entries other sessions appended since the last read
+/// @return number of entries added
+size_t history_file_read_new(history_list* h) {
+    if (log_fd == -1) return 0;
+    struct stat st;
+    if (fstat(log_fd, &st) == -1) return 0;
+    if (st.st_size < read_pos) { // truncated behind our back, start over from the top
+        read_pos = 0;
+        num_own = 0;
+    }
+    return read_range(h, log_fd, read_pos, st.st_size, &read_pos);
+}
+
+/// @brief append the whole file to the history again, like bash's history -r
+/// @return number of entries added
+size_t history_file_read_all(history_list* h) {
+    if (log_fd == -1) return 0;
+    struct stat st;
+    if (fstat(log_fd, &st) == -1) return 0;
+    return read_range(h, log_fd, 0, st.st_size, &read_pos);
+}
+
+/// @brief history -a, -n or -r
+/// * -a is there for scripts written for bash, every entry is already appended as it is entered
+/// @return 0 on success, 1 on error
+int history_file_cmd(char** argv) {
+    if (log_fd == -1) {
+        fprintf(stderr, "history: no history file\n");
+        return 1;
+    }
+    if (!strcmp(argv[1], "-a")) {
+        return 0;
+    } else if (!strcmp(argv[1], "-n")) {
+        history_file_read_new(history);
+        return 0;
+    } else if (!strcmp(argv[1], "-r")) {
+        history_file_read_all(history);
+        return 0;
+    }
+    fprintf(stderr, "history: %s: invalid option\n", argv[1]);
+    return 1;
+}
@@ -0,0 +1,17 @@
+#ifndef HISTORYFILE_H
+#define HISTORYFILE_H
+
+#include <stddef.h>
+
+#include "historyList.h"
+
+#define HISTORY_FILE_NAME ".cshell_history" // in $HOME, unless $HISTFILE names another file
+
+int    history_file_open(history_list* h);
+void   history_file_close(void);
+int    history_file_append(const char* cmd);
+size_t history_file_read_new(history_list* h);
+size_t history_file_read_all(history_list* h);
+int    history_file_cmd(char** argv);
+
+#endif
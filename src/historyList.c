@@ -1,47 +1,127 @@
-#define _DEFAULT_SOURCE
+/*
+Bounded command history: a ring of the last HISTSIZE commands with the strings in an arena.
+
+Any entry is found by index arithmetic, so listing the last n entries or stepping through them with the
+arrow keys never walks a list. The arena only ever grows at the end, the dropped entries' strings are
+reclaimed by copying the kept ones into a fresh arena once the dead bytes outnumber the live ones,
+so memory stays proportional to HISTSIZE however long the session runs.
+*/
+
+#define _GNU_SOURCE // memrchr
+
+#include <stdbool.h>
 
 #include "historyList.h"
 
+static void compact_strings(history_list* h);
+static void push_entry(history_list* h, const char* cmd, size_t len);
 
-history_list* create_history_list(void) {
+history_list* create_history_list(size_t cap) {
     history_list* h = malloc(sizeof(history_list));
-    h->head = NULL;
-    h->tail = NULL;
-    h->curr = NULL;
+    h->cap = cap ? cap : 1;
+    h->entries = malloc(h->cap * sizeof(char*));
+    h->head = 0;
     h->len = 0;
     h->base = 1;
+    h->curr = 0;
+    arena_init(&h->strings);
+    h->live_bytes = 0;
+    h->dead_bytes = 0;
     return h;
 }
 
-void add_history_entry(history_list* h, char* cmd) {
+/// @brief copy the kept entries into a fresh arena and drop the old one
+static void compact_strings(history_list* h) {
+    arena fresh;
+    arena_init(&fresh);
+    for (size_t i = 0; i < h->len; ++i) {
+        char** entry = &h->entries[(h->head + i) % h->cap];
+        *entry = arena_strndup(&fresh, *entry, strlen(*entry));
+    }
+    arena_free(&h->strings);
+    h->strings = fresh;
+    h->dead_bytes = 0;
+}
+
+static void push_entry(history_list* h, const char* cmd, size_t len) {
+    if (h->len == h->cap) { // full, the oldest entry makes room
+        size_t dropped = strlen(h->entries[h->head]) + 1;
+        h->live_bytes -= dropped;
+        h->dead_bytes += dropped;
+        h->head = (h->head + 1) % h->cap;
+        --h->len;
+        ++h->base;
+    }
+    h->entries[(h->head + h->len) % h->cap] = arena_strndup(&h->strings, cmd, len);
+    ++h->len;
+    h->live_bytes += len + 1;
+    h->curr = h->len;
+    if (h->dead_bytes > h->live_bytes && h->dead_bytes > ARENA_MIN_CHUNK) compact_strings(h);
+}
+
+void add_history_entry(history_list* h, const char* cmd) {
     if (h == NULL || cmd == NULL) return;
-    history_node* entry = malloc(sizeof(history_node));
-    entry->cmd = strdup(cmd);
-    entry->next = NULL;
-    entry->prev = h->tail;
-    
-
-    if (h->head == NULL) {
-        h->tail = h->head = entry;
-    } else {
-        h->tail->next = entry;
+    push_entry(h, cmd, strlen(cmd));
+}
+
+/// @brief add the '\n' terminated lines of a buffer, like the history file, skipping empty ones
+/// * only the last cap lines can be kept, so they are found from the end and nothing before them is read
+/// @return number of entries added
+size_t add_history_lines(history_list* h, const char* lines, size_t len) {
+    const char* start = lines + len;
+    size_t count = 0;
+    while (start > lines && count < h->cap) { // back to the start of the cap'th last line
+        const char* nl = memrchr(lines, '\n', start - 1 - lines);
+        const char* line = nl ? nl + 1 : lines;
+        if (start - 1 > line) ++count; // not empty
+        start = line;
     }
-    h->tail = entry;
-    h->curr = entry;
-    ++(h->len);
+    const char* end = lines + len;
+    for (const char* line = start; line < end; ) {
+        const char* nl = memchr(line, '\n', end - line);
+        if (nl == NULL) break;
+        if (nl != line) push_entry(h, line, nl - line);
+        line = nl + 1;
+    }
+    return count;
+}
+
+/// @brief keep at most cap entries from now on, dropping the oldest if there are more
+void resize_history_list(history_list* h, size_t cap) {
+    if (cap == 0) cap = 1;
+    size_t keep = h->len < cap ? h->len : cap;
+    char** entries = malloc(cap * sizeof(char*));
+    for (size_t i = 0; i < keep; ++i) {
+        entries[i] = h->entries[(h->head + h->len - keep + i) % h->cap];
+    }
+    for (size_t i = 0; i < h->len - keep; ++i) {
+        h->live_bytes -= strlen(h->entries[(h->head + i) % h->cap]) + 1;
+    }
+    free(h->entries);
+    h->entries = entries;
+    h->base += h->len - keep;
+    h->cap = cap;
+    h->head = 0;
+    h->len = keep;
+    h->curr = keep;
+    compact_strings(h);
+}
+
+/// @brief $HISTSIZE if it is a positive number, HISTORY_DEFAULT_SIZE otherwise
+size_t history_size_setting(void) {
+    const char* size = getenv("HISTSIZE");
+    char* end = NULL;
+    unsigned long n = size ? strtoul(size, &end, 10) : 0;
+    return (size && *size && *end == '\0' && n > 0) ? n : HISTORY_DEFAULT_SIZE;
 }
 
 void free_history_list(history_list* h) {
     if (h == NULL) return;
 
-    history_node* curr_node = h->head;
-    while (curr_node != NULL) {
-        history_node* next = curr_node->next;
-        free(curr_node->cmd);
-        free(curr_node);
-        curr_node = next; 
-    }
-    h->head = NULL;
-    h->tail = NULL;
-    h->curr = NULL;
-}
\ No newline at end of file
+    free(h->entries);
+    h->entries = NULL;
+    arena_free(&h->strings);
+    h->len = 0;
+    h->live_bytes = 0;
+    h->dead_bytes = 0;
+}
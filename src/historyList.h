@@ -5,25 +5,40 @@
 #include <stdlib.h>
 #include <string.h>
 
-typedef struct history_node history_node;
-struct history_node {
-    history_node* next;
-    history_node* prev;
-    char* cmd;
-};
+#include "arena.h"
 
-typedef struct history_list history_list;
+#define HISTORY_DEFAULT_SIZE 1000 // entries kept when $HISTSIZE isn't set
 
+// the last cap commands, oldest first. Entry i (0 is the oldest) has history number base + i
+// and lives in entries[(head + i) % cap], its string in the arena
+typedef struct history_list history_list;
 struct history_list {
-    history_node* head;
-    history_node* tail;
-    history_node* curr;
+    char** entries;
+    size_t cap;
+    size_t head;
     size_t len;
     size_t base;
+    size_t curr;        // entry the arrow keys are showing, len while a new line is being typed
+    arena strings;
+    size_t live_bytes;  // bytes of the kept entries' strings
+    size_t dead_bytes;  // bytes of dropped entries still in the arena, compacted away once they outnumber the live ones
 };
 
-history_list* create_history_list(void);
-void add_history_entry(history_list* h, char* cmd);
+history_list* create_history_list(size_t cap);
+void add_history_entry(history_list* h, const char* cmd);
+size_t add_history_lines(history_list* h, const char* lines, size_t len);
+void resize_history_list(history_list* h, size_t cap);
+size_t history_size_setting(void);
 void free_history_list(history_list* h);
 
-#endif
\ No newline at end of file
+/// @brief entry i, 0 being the oldest still kept, NULL past the end
+static inline const char* history_at(const history_list* h, size_t i) {
+    return i < h->len ? h->entries[(h->head + i) % h->cap] : NULL;
+}
+
+/// @brief the entry with history number num as `history` prints it, NULL if it was dropped or doesn't exist yet
+static inline const char* history_get(const history_list* h, size_t num) {
+    return num >= h->base ? history_at(h, num - h->base) : NULL;
+}
+
+#endif
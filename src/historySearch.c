@@ -0,0 +1,319 @@
+/*
+Trigram index over the history for incremental reverse search (Ctrl-R).
+
+Every distinct command gets an id the first time it is entered, along with how often it was run and the
+history number of its newest run. Each trigram (three consecutive bytes) maps to the ascending list of ids
+of the commands containing it. A query of three or more bytes intersects the lists of its trigrams, so only
+commands containing all of them are compared with strstr, however long the history is. Shorter queries
+can't narrow anything down and just scan the newest SEARCH_SHORT_SCAN entries.
+
+Matches are ranked by frequency weighted by recency, and the same command is only listed once.
+
+The index is brought up to date lazily before each query, by indexing the entries added since the last one.
+Entries the ring dropped are skipped while querying, and once the whole ring has turned over since the
+index was built it is rebuilt from scratch, so it never holds more than about twice HISTSIZE commands.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "historySearch.h"
+
+#define SEARCH_RECENCY 256.0 // a command run this many commands ago counts half as much as one just run
+
+typedef struct search_cmd search_cmd;
+struct search_cmd {
+    uint64_t hash;
+    size_t last;    // history number of the newest run
+    uint32_t count; // runs seen since the index was built
+};
+
+// ids of the commands containing one trigram, ascending
+typedef struct posting posting;
+struct posting {
+    uint32_t gram; // the three bytes, with bit 24 set so that 0 marks an empty slot
+    uint32_t len;
+    uint32_t cap;
+    uint32_t* ids;
+};
+
+static history_list* indexed = NULL; // history the index was built for
+static size_t indexed_upto = 0;      // history number of the next entry to index
+static size_t built_base = 0;        // history->base when the index was last built
+
+static search_cmd* cmds = NULL;
+static size_t num_cmds = 0;
+static size_t cmds_cap = 0;
+static uint32_t* cmd_slots = NULL;   // hash table of id + 1, 0 if empty
+static size_t cmd_slots_cap = 0;
+
+static posting* grams = NULL;        // hash table of trigram -> posting
+static size_t grams_cap = 0;
+static size_t num_grams = 0;
+
+static uint64_t hash_cmd(const char* s);
+static uint32_t hash_gram(uint32_t gram);
+static void reset_index(history_list* h);
+static uint32_t* find_cmd_slot(history_list* h, const char* cmd, uint64_t hash);
+static void grow_cmd_slots(void);
+static posting* find_gram(uint32_t gram);
+static void grow_grams(void);
+static void add_gram(uint32_t gram, uint32_t id);
+static void index_entry(history_list* h, size_t num, const char* cmd);
+static double score(const search_cmd* cmd, size_t newest);
+static size_t add_result(search_result* results, size_t len, size_t num, double score);
+static bool has_result(const search_result* results, size_t len, size_t num);
+static size_t intersect(uint32_t* ids, size_t len, const posting* p);
+static int cmp_posting_len(const void* a, const void* b);
+
+/// @brief FNV-1a, 64 bit so that a match on the hash alone is as good as a string compare
+static uint64_t hash_cmd(const char* s) {
+    uint64_t h = 14695981039346656037ull;
+    for (; *s; ++s) {
+        h ^= (unsigned char) *s;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint32_t hash_gram(uint32_t gram) {
+    return gram * 2654435761u; // Knuth's multiplicative hash, the low bits of a trigram are just its last byte
+}
+
+static void reset_index(history_list* h) {
+    for (size_t i = 0; i < grams_cap; ++i) {
+        free(grams[i].ids);
+    }
+    free(grams);
+    free(cmds);
+    free(cmd_slots);
+    grams = NULL;
+    cmds = NULL;
+    cmd_slots = NULL;
+    grams_cap = num_grams = 0;
+    cmds_cap = num_cmds = 0;
+    cmd_slots_cap = 0;
+    indexed = h;
+    built_base = h ? h->base : 0;
+    indexed_upto = built_base;
+}
+
+/// @brief linear probe for cmd, cmd_slots_cap is always a power of two
+/// @return slot holding cmd's id + 1, or the empty slot where it would be inserted
+static uint32_t* find_cmd_slot(history_list* h, const char* cmd, uint64_t hash) {
+    size_t mask = cmd_slots_cap - 1;
+    size_t i = hash & mask;
+    while (cmd_slots[i]) {
+        search_cmd* c = &cmds[cmd_slots[i] - 1];
+        if (c->hash == hash) {
+            const char* newest = history_get(h, c->last);
+            if (newest == NULL || !strcmp(newest, cmd)) break; // a dropped one can only be compared by hash
+        }
+        i = (i + 1) & mask;
+    }
+    return &cmd_slots[i];
+}
+
+static void grow_cmd_slots(void) {
+    size_t new_cap = cmd_slots_cap ? cmd_slots_cap * 2 : SEARCH_INIT_CAP;
+    uint32_t* new_slots = calloc(new_cap, sizeof(uint32_t));
+    for (size_t id = 0; id < num_cmds; ++id) { // every id is in the table, no need to look at the old slots
+        size_t i = cmds[id].hash & (new_cap - 1);
+        while (new_slots[i]) {
+            i = (i + 1) & (new_cap - 1);
+        }
+        new_slots[i] = id + 1;
+    }
+    free(cmd_slots);
+    cmd_slots = new_slots;
+    cmd_slots_cap = new_cap;
+}
+
+/// @brief linear probe for gram
+/// @return its posting, or the empty slot where it would go (gram == 0)
+static posting* find_gram(uint32_t gram) {
+    size_t mask = grams_cap - 1;
+    size_t i = hash_gram(gram) & mask;
+    while (grams[i].gram && grams[i].gram != gram) {
+        i = (i + 1) & mask;
+    }
+    return &grams[i];
+}
+
+static void grow_grams(void) {
+    posting* old = grams;
+    size_t old_cap = grams_cap;
+    grams_cap = grams_cap ? grams_cap * 2 : SEARCH_INIT_CAP;
+    grams = calloc(grams_cap, sizeof(posting));
+    for (size_t i = 0; i < old_cap; ++i) {
+        if (old[i].gram) *find_gram(old[i].gram) = old[i];
+    }
+    free(old);
+}
+
+/// @brief add id to gram's posting, ids come in ascending order so a repeat can only be the last one
+static void add_gram(uint32_t gram, uint32_t id) {
+    if ((num_grams + 1) * 10 > grams_cap * 7) grow_grams();
+    posting* p = find_gram(gram);
+    if (p->gram == 0) {
+        p->gram = gram;
+        ++num_grams;
+    }
+    if (p->len && p->ids[p->len - 1] == id) return;
+    if (p->len == p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 4;
+        p->ids = realloc(p->ids, p->cap * sizeof(uint32_t));
+    }
+    p->ids[p->len++] = id;
+}
+
+static void index_entry(history_list* h, size_t num, const char* cmd) {
+    if ((num_cmds + 1) * 10 > cmd_slots_cap * 7) grow_cmd_slots();
+    uint64_t hash = hash_cmd(cmd);
+    uint32_t* slot = find_cmd_slot(h, cmd, hash);
+    if (*slot) { // seen before, its trigrams are already indexed
+        cmds[*slot - 1].last = num;
+        ++cmds[*slot - 1].count;
+        return;
+    }
+
+    if (num_cmds == cmds_cap) {
+        cmds_cap = cmds_cap ? cmds_cap * 2 : SEARCH_INIT_CAP;
+        cmds = realloc(cmds, cmds_cap * sizeof(search_cmd));
+    }
+    uint32_t id = num_cmds++;
+    cmds[id] = (search_cmd) {.hash = hash, .last = num, .count = 1};
+    *slot = id + 1;
+
+    const unsigned char* s = (const unsigned char*) cmd;
+    for (size_t i = 0; s[i] && s[i + 1] && s[i + 2]; ++i) {
+        add_gram(1u << 24 | s[i] << 16 | s[i + 1] << 8 | s[i + 2], id);
+    }
+}
+
+/// @brief index every entry added to h since the last call, rebuilding if the ring turned over since the last build
+void history_search_sync(history_list* h) {
+    if (h != indexed || h->base > built_base + h->cap || indexed_upto > h->base + h->len) {
+        reset_index(h);
+    }
+    size_t end = h->base + h->len;
+    for (size_t num = indexed_upto > h->base ? indexed_upto : h->base; num < end; ++num) {
+        index_entry(h, num, history_get(h, num));
+    }
+    indexed_upto = end;
+}
+
+static double score(const search_cmd* cmd, size_t newest) {
+    return cmd->count / (1.0 + (newest - cmd->last) / SEARCH_RECENCY);
+}
+
+/// @brief insert into the best SEARCH_MAX_RESULTS so far, kept best first, newer first on a tie
+/// @return new number of results
+static size_t add_result(search_result* results, size_t len, size_t num, double score) {
+    size_t i = len < SEARCH_MAX_RESULTS ? len : SEARCH_MAX_RESULTS - 1;
+    if (len == SEARCH_MAX_RESULTS) {
+        search_result* worst = &results[i];
+        if (score < worst->score || (score == worst->score && num < worst->num)) return len;
+    }
+    while (i > 0 && (results[i - 1].score < score || (results[i - 1].score == score && results[i - 1].num < num))) {
+        results[i] = results[i - 1];
+        --i;
+    }
+    results[i] = (search_result) {.num = num, .score = score};
+    return len < SEARCH_MAX_RESULTS ? len + 1 : len;
+}
+
+static bool has_result(const search_result* results, size_t len, size_t num) {
+    for (size_t i = 0; i < len; ++i) {
+        if (results[i].num == num) return true;
+    }
+    return false;
+}
+
+/// @brief keep the ids that are also in p, both ascending
+/// @return number kept
+static size_t intersect(uint32_t* ids, size_t len, const posting* p) {
+    size_t kept = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < len; ++i) {
+        // gallop: p is usually much longer than what is left of ids
+        size_t step = 1;
+        while (j + step < p->len && p->ids[j + step] < ids[i]) {
+            j += step;
+            step *= 2;
+        }
+        while (j < p->len && p->ids[j] < ids[i]) {
+            ++j;
+        }
+        if (j == p->len) break;
+        if (p->ids[j] == ids[i]) ids[kept++] = ids[i];
+    }
+    return kept;
+}
+
+static int cmp_posting_len(const void* a, const void* b) {
+    uint32_t la = (*(const posting**) a)->len;
+    uint32_t lb = (*(const posting**) b)->len;
+    return (la > lb) - (la < lb);
+}
+
+/// @brief best matches for query (a substring of the command), each distinct command once
+/// @param results room for SEARCH_MAX_RESULTS, filled best first
+/// @return number of results
+size_t history_search(history_list* h, const char* query, search_result* results) {
+    history_search_sync(h);
+    size_t query_len = strlen(query);
+    size_t newest = h->base + h->len - 1;
+    size_t len = 0;
+    if (h->len == 0 || query_len == 0) return 0;
+
+    if (query_len < 3) { // no trigram to look up, the newest entries are the likely ones anyway
+        size_t scan = h->len < SEARCH_SHORT_SCAN ? h->len : SEARCH_SHORT_SCAN;
+        for (size_t i = 0; i < scan; ++i) {
+            const char* cmd = history_at(h, h->len - 1 - i);
+            if (!strstr(cmd, query)) continue;
+            search_cmd* c = &cmds[*find_cmd_slot(h, cmd, hash_cmd(cmd)) - 1];
+            if (!has_result(results, len, c->last)) len = add_result(results, len, c->last, score(c, newest));
+        }
+        return len;
+    }
+
+    size_t num_query_grams = query_len - 2;
+    posting** lists = malloc(num_query_grams * sizeof(posting*));
+    const unsigned char* q = (const unsigned char*) query;
+    for (size_t i = 0; i < num_query_grams; ++i) {
+        posting* p = grams_cap ? find_gram(1u << 24 | q[i] << 16 | q[i + 1] << 8 | q[i + 2]) : NULL;
+        if (p == NULL || p->gram == 0) { // some trigram was never seen, nothing can match
+            free(lists);
+            return 0;
+        }
+        lists[i] = p;
+    }
+    qsort(lists, num_query_grams, sizeof(posting*), cmp_posting_len); // start from the rarest
+
+    size_t num_ids = lists[0]->len;
+    uint32_t* ids = malloc(num_ids * sizeof(uint32_t));
+    memcpy(ids, lists[0]->ids, num_ids * sizeof(uint32_t));
+    for (size_t i = 1; i < num_query_grams && num_ids; ++i) {
+        if (lists[i] != lists[i - 1]) num_ids = intersect(ids, num_ids, lists[i]);
+    }
+
+    // the trigrams all being there doesn't mean they are next to each other, check the real thing
+    for (size_t i = 0; i < num_ids; ++i) {
+        search_cmd* c = &cmds[ids[i]];
+        const char* cmd = history_get(h, c->last);
+        if (cmd && strstr(cmd, query)) len = add_result(results, len, c->last, score(c, newest));
+    }
+    free(ids);
+    free(lists);
+    return len;
+}
+
+void history_search_free(void) {
+    reset_index(NULL);
+}
@@ -0,0 +1,23 @@
+#ifndef HISTORYSEARCH_H
+#define HISTORYSEARCH_H
+
+#include <stddef.h>
+
+#include "historyList.h"
+
+#define SEARCH_MAX_RESULTS 64    // best matches kept per query, what Ctrl-R cycles through
+#define SEARCH_SHORT_SCAN 4096   // newest entries scanned for queries too short to have a trigram
+#define SEARCH_INIT_CAP 1024     // must be a power of two
+
+// one match of history_search(), best first
+typedef struct search_result search_result;
+struct search_result {
+    size_t num;     // history number of the newest occurrence
+    double score;
+};
+
+size_t history_search(history_list* h, const char* query, search_result* results);
+void   history_search_sync(history_list* h);
+void   history_search_free(void);
+
+#endif
@@ -0,0 +1,412 @@
+/*
+Job control: the job table, background jobs and the jobs/fg/bg/wait builtins.
+
+Every command line that starts processes becomes a job with its own process group. A foreground job gets the
+terminal and the shell waits for it to finish or stop (^Z), a job started with `&` is registered and left running.
+SIGCHLD only writes a byte to a self-pipe; the readline loop polls that pipe next to stdin (see shell_getc in
+readline_init.c) and reaps with WNOHANG, so background jobs are collected while the shell sits at the prompt and
+their changes are reported before the next one, like bash does.
+*/
+
+#define _GNU_SOURCE // pipe2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "jobs.h"
+#include "launch.h"
+#include "redirect.h"
+
+#define INIT_JOBS_CAP 8
+
+int shell_tty = -1;
+bool job_control = false;
+
+static job** table = NULL; // table[id - 1], NULL for a free id
+static size_t table_cap = 0;
+
+static int signal_pipe[2] = {-1, -1}; // SIGCHLD and SIGINT write here, the readline loop polls the read end
+static volatile sig_atomic_t interrupted = 0;
+static struct termios shell_tmodes;
+
+static void on_signal(int sig);
+static void update_proc(pid_t pid, int status);
+static void update_state(job* j);
+static job* current_job(void);
+static job* parse_job_spec(const char* spec, const char* cmd);
+static void print_job(job* j, const char* state);
+static int last_status(job* j);
+
+/// @brief install the SIGCHLD handler, and for an interactive shell take over the terminal for job control
+/// * a script's commands stay in the shell's process group, so ^C at the terminal reaches them and the shell alike
+void jobs_init(bool interactive) {
+    if (pipe2(signal_pipe, O_CLOEXEC | O_NONBLOCK)) {
+        perror("pipe");
+        exit(1);
+    }
+    signal_pipe[0] = redirect_fd_high(signal_pipe[0]);
+    signal_pipe[1] = redirect_fd_high(signal_pipe[1]);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    job_control = interactive;
+    if (interactive && tcgetpgrp(STDIN_FILENO) == getpgrp()) {
+        shell_tty = STDIN_FILENO;
+        tcgetattr(shell_tty, &shell_tmodes);
+        // ^C interrupts whatever the shell is doing (the line being edited, `wait`) instead of killing it,
+        // no SA_RESTART so a blocking waitpid returns EINTR
+        sa.sa_flags = 0;
+        sigaction(SIGINT, &sa, NULL);
+        // ^Z and terminal access are for jobs, the shell itself must never be stopped by them
+        signal(SIGTSTP, SIG_IGN);
+        signal(SIGTTIN, SIG_IGN);
+        signal(SIGTTOU, SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+    }
+}
+
+/// @brief at exit, stopped jobs are hung up and continued so they don't linger, running ones are left alone
+void jobs_free(void) {
+    for (size_t i = 0; i < table_cap; ++i) {
+        if (table[i] && table[i]->state == JOB_STOPPED) {
+            kill(-table[i]->pgid, SIGHUP);
+            kill(-table[i]->pgid, SIGCONT);
+        }
+        if (table[i]) {
+            free(table[i]->command);
+            free(table[i]);
+        }
+    }
+    free(table);
+    table = NULL;
+    table_cap = 0;
+    close(signal_pipe[0]);
+    close(signal_pipe[1]);
+}
+
+static void on_signal(int sig) {
+    int saved_errno = errno;
+    if (sig == SIGINT) interrupted = 1;
+    char c = (char) sig;
+    if (write(signal_pipe[1], &c, 1) == -1) {
+        // pipe full, there is already a wakeup pending
+    }
+    errno = saved_errno;
+}
+
+/// @brief read end of the self-pipe, readable whenever a child changed state or ^C was pressed
+int jobs_signal_fd(void) {
+    return signal_pipe[0];
+}
+
+/// @brief drain the self-pipe and report whether ^C was pressed since the last call
+bool jobs_take_interrupt(void) {
+    char buf[64];
+    while (read(signal_pipe[0], buf, sizeof(buf)) > 0) {}
+    bool was = interrupted;
+    interrupted = 0;
+    return was;
+}
+
+/// @brief collect every child that changed state without blocking
+void jobs_reap(void) {
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) {
+        update_proc(pid, status);
+    }
+}
+
+/// @brief report background jobs that finished or stopped since the last prompt, finished ones leave the table
+/// * a script only drops the finished ones, like other shells it doesn't report them
+void jobs_notify(void) {
+    jobs_reap();
+    for (size_t i = 0; i < table_cap; ++i) {
+        job* j = table[i];
+        if (j == NULL || j->notified) continue;
+        if (j->state == JOB_DONE && !job_control) {
+            job_remove(j);
+        } else if (j->state == JOB_DONE) {
+            int status = last_status(j);
+            if (status == 0) {
+                print_job(j, "Done");
+            } else {
+                char state[32];
+                snprintf(state, sizeof(state), "Exit %d", status);
+                print_job(j, state);
+            }
+            job_remove(j);
+        } else if (j->state == JOB_STOPPED) {
+            print_job(j, "Stopped");
+            j->notified = true;
+        }
+    }
+}
+
+/// @brief add a job to the table under the lowest free id
+/// @param pids one per stage, -1 for a stage that never started
+/// @param command text shown by jobs, copied
+job* job_create(const pid_t* pids, size_t num_procs, pid_t pgid, const char* command) {
+    size_t slot = 0;
+    while (slot < table_cap && table[slot]) {
+        ++slot;
+    }
+    if (slot == table_cap) {
+        size_t new_cap = table_cap ? table_cap * 2 : INIT_JOBS_CAP;
+        table = realloc(table, new_cap * sizeof(job*));
+        memset(table + table_cap, 0, (new_cap - table_cap) * sizeof(job*));
+        table_cap = new_cap;
+    }
+
+    job* j = calloc(1, sizeof(job) + num_procs * sizeof(job_proc));
+    j->id = slot + 1;
+    j->pgid = pgid;
+    j->command = strdup(command);
+    j->num_procs = num_procs;
+    for (size_t i = 0; i < num_procs; ++i) {
+        j->procs[i].pid = pids[i];
+        j->procs[i].status = 127; // what a stage that never started reports
+        j->procs[i].state = pids[i] > 0 ? JOB_RUNNING : JOB_DONE;
+    }
+    update_state(j);
+    table[slot] = j;
+    return j;
+}
+
+void job_remove(job* j) {
+    table[j->id - 1] = NULL;
+    free(j->command);
+    free(j);
+}
+
+/// @brief give the job the terminal and wait until every process finished or the job stopped, then take the terminal back
+/// @param cont send SIGCONT first, for fg on a stopped job
+void job_wait_foreground(job* j, bool cont) {
+    // * the children ask for the terminal too, this covers the ones that haven't got that far yet
+    if (shell_tty != -1 && j->pgid > 0) {
+        if (cont && j->has_tmodes) tcsetattr(shell_tty, TCSADRAIN, &j->tmodes);
+        launch_set_terminal(shell_tty, j->pgid);
+    }
+    if (cont && j->pgid > 0) {
+        kill(-j->pgid, SIGCONT);
+        for (size_t i = 0; i < j->num_procs; ++i) {
+            if (j->procs[i].state == JOB_STOPPED) j->procs[i].state = JOB_RUNNING;
+        }
+        update_state(j);
+    }
+
+    while (j->state == JOB_RUNNING) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, WUNTRACED); // any child, a background job finishing meanwhile gets its update too
+        if (pid == -1) {
+            if (errno == EINTR) continue; // ^C or SIGCHLD, the job has the terminal so ^C went to it as well
+            for (size_t i = 0; i < j->num_procs; ++i) { // ECHILD, whatever is left was reaped by someone else
+                if (j->procs[i].state == JOB_RUNNING) j->procs[i].state = JOB_DONE;
+            }
+            update_state(j);
+            break;
+        }
+        update_proc(pid, status);
+    }
+    jobs_take_interrupt(); // wakeups for this job are handled, don't make the prompt look for them
+
+    if (shell_tty != -1) {
+        if (j->state == JOB_STOPPED) {
+            j->has_tmodes = tcgetattr(shell_tty, &j->tmodes) == 0;
+        }
+        launch_set_terminal(shell_tty, getpgrp());
+        tcsetattr(shell_tty, TCSADRAIN, &shell_tmodes);
+    }
+
+    if (j->state == JOB_STOPPED) {
+        printf("\n");
+        print_job(j, "Stopped");
+        j->notified = true;
+    } else {
+        bool sigint = false;
+        for (size_t i = 0; i < j->num_procs; ++i) {
+            sigint |= j->procs[i].status == 128 + SIGINT;
+        }
+        if (sigint) printf("\n"); // ^C leaves the cursor after the echoed ^C
+        j->notified = true;
+    }
+}
+
+/// @brief announce a job started with `&`, like `[1] 4242`
+void job_background(job* j) {
+    if (!job_control) return;
+    printf("[%d] %ld\n", j->id, (long) j->pgid);
+}
+
+/// @brief `jobs` lists every job with its state
+int jobs_cmd(char** argv) {
+    (void) argv;
+    jobs_reap();
+    for (size_t i = 0; i < table_cap; ++i) {
+        job* j = table[i];
+        if (j == NULL) continue;
+        print_job(j, j->state == JOB_RUNNING ? "Running" : j->state == JOB_STOPPED ? "Stopped" : "Done");
+        if (j->state == JOB_DONE) {
+            job_remove(j);
+        } else {
+            j->notified = true;
+        }
+    }
+    return 0;
+}
+
+/// @brief `fg [%n]` continues a job in the foreground
+/// @return the job's exit status, or 1 if there is no such job
+int fg_cmd(char** argv) {
+    job* j = parse_job_spec(argv[1], "fg");
+    if (j == NULL) return 1;
+    printf("%s\n", j->command);
+    job_wait_foreground(j, true);
+    int status = j->state == JOB_STOPPED ? 128 + SIGTSTP : last_status(j);
+    if (j->state == JOB_DONE) job_remove(j);
+    return status;
+}
+
+/// @brief `bg [%n]` continues a stopped job in the background
+int bg_cmd(char** argv) {
+    job* j = parse_job_spec(argv[1], "bg");
+    if (j == NULL) return 1;
+    if (j->state == JOB_STOPPED) {
+        kill(-j->pgid, SIGCONT);
+        for (size_t i = 0; i < j->num_procs; ++i) {
+            if (j->procs[i].state == JOB_STOPPED) j->procs[i].state = JOB_RUNNING;
+        }
+        update_state(j);
+    }
+    printf("[%d]+ %s &\n", j->id, j->command);
+    j->notified = true;
+    return 0;
+}
+
+/// @brief `wait` waits for every background job, `wait %n` or `wait pid` for one of them
+/// @return exit status of the job waited for, 0 when waiting for all of them, 130 if ^C interrupted it
+int wait_cmd(char** argv) {
+    job* target = NULL;
+    if (argv[1]) {
+        if (argv[1][0] == '%') {
+            target = parse_job_spec(argv[1], "wait");
+        } else {
+            pid_t pid = (pid_t) strtol(argv[1], NULL, 10);
+            for (size_t i = 0; i < table_cap && !target; ++i) {
+                for (size_t k = 0; table[i] && k < table[i]->num_procs; ++k) {
+                    if (table[i]->procs[k].pid == pid) target = table[i];
+                }
+            }
+            if (target == NULL) printf("wait: pid %s is not a child of this shell\n", argv[1]);
+        }
+        if (target == NULL) return 127;
+    }
+
+    jobs_take_interrupt();
+    while (1) {
+        bool pending = false;
+        for (size_t i = 0; i < table_cap; ++i) {
+            if (table[i] && (target == NULL || table[i] == target) && table[i]->state == JOB_RUNNING) pending = true;
+        }
+        if (!pending) break;
+
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, WUNTRACED);
+        if (pid == -1) {
+            if (errno == EINTR && jobs_take_interrupt()) {
+                printf("\n");
+                return 130;
+            }
+            if (errno == EINTR) continue;
+            break;
+        }
+        update_proc(pid, status);
+    }
+    if (target == NULL) return 0;
+    int status = target->state == JOB_STOPPED ? 128 + SIGTSTP : last_status(target);
+    if (target->state == JOB_DONE) job_remove(target); // nothing left to report, bash drops it too
+    return status;
+}
+
+/// @brief record a waitpid() result on the process it belongs to
+static void update_proc(pid_t pid, int status) {
+    for (size_t i = 0; i < table_cap; ++i) {
+        job* j = table[i];
+        for (size_t k = 0; j && k < j->num_procs; ++k) {
+            if (j->procs[k].pid != pid) continue;
+            job_proc* p = &j->procs[k];
+            if (WIFSTOPPED(status)) {
+                p->state = JOB_STOPPED;
+            } else if (WIFCONTINUED(status)) {
+                p->state = JOB_RUNNING;
+            } else {
+                p->state = JOB_DONE;
+                p->status = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+            }
+            job_state before = j->state;
+            update_state(j);
+            if (j->state != before) j->notified = false;
+            return;
+        }
+    }
+    // not one of ours, e.g. a job that was already dropped
+}
+
+static void update_state(job* j) {
+    bool running = false;
+    bool stopped = false;
+    for (size_t i = 0; i < j->num_procs; ++i) {
+        running |= j->procs[i].state == JOB_RUNNING;
+        stopped |= j->procs[i].state == JOB_STOPPED;
+    }
+    j->state = running ? JOB_RUNNING : stopped ? JOB_STOPPED : JOB_DONE;
+}
+
+/// @brief the job `+` refers to: the newest stopped job, otherwise the newest one
+static job* current_job(void) {
+    job* newest = NULL;
+    for (size_t i = table_cap; i-- > 0; ) {
+        if (table[i] == NULL) continue;
+        if (table[i]->state == JOB_STOPPED) return table[i];
+        if (newest == NULL) newest = table[i];
+    }
+    return newest;
+}
+
+/// @brief %n, %+ or nothing for the current job
+/// @return NULL after printing an error if there is no such job
+static job* parse_job_spec(const char* spec, const char* cmd) {
+    if (spec == NULL || !strcmp(spec, "%+") || !strcmp(spec, "%%")) {
+        job* j = current_job();
+        if (j == NULL) printf("%s: current: no such job\n", cmd);
+        return j;
+    }
+    const char* num = spec[0] == '%' ? spec + 1 : spec;
+    char* end = NULL;
+    long id = strtol(num, &end, 10);
+    if (*num == '\0' || *end || id < 1 || (size_t) id > table_cap || table[id - 1] == NULL) {
+        printf("%s: %s: no such job\n", cmd, spec);
+        return NULL;
+    }
+    return table[id - 1];
+}
+
+static void print_job(job* j, const char* state) {
+    printf("[%d]%c  %-22s %s\n", j->id, j == current_job() ? '+' : ' ', state, j->command);
+}
+
+/// @brief exit status of a finished job is the status of its last stage, like $?
+static int last_status(job* j) {
+    return j->procs[j->num_procs - 1].status;
+}
@@ -0,0 +1,56 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <termios.h>
+#include <sys/types.h>
+
+typedef enum job_state {
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE,
+} job_state;
+
+typedef struct job_proc job_proc;
+struct job_proc {
+    pid_t pid;       // -1 for a stage that never started
+    int status;      // exit status once done, 128+sig if a signal killed it
+    job_state state;
+};
+
+// one pipeline started from one command line, a single command is a pipeline of one
+typedef struct job job;
+struct job {
+    int id;                 // %id in jobs/fg/bg/wait
+    pid_t pgid;
+    job_state state;        // RUNNING while any process runs, STOPPED once every live one is stopped
+    bool notified;          // the last state change was already reported
+    bool has_tmodes;
+    struct termios tmodes;  // terminal modes the job had when it was stopped, restored by fg
+    char* command;
+    size_t num_procs;
+    job_proc procs[];
+};
+
+extern int shell_tty;     // the terminal, if the shell is its foreground process group and can hand it to commands
+extern bool job_control; // interactive, every command gets its own process group
+
+void jobs_init(bool interactive);
+void jobs_free(void);
+int  jobs_signal_fd(void);
+bool jobs_take_interrupt(void);
+void jobs_reap(void);
+void jobs_notify(void);
+
+job* job_create(const pid_t* pids, size_t num_procs, pid_t pgid, const char* command);
+void job_remove(job* j);
+void job_wait_foreground(job* j, bool cont);
+void job_background(job* j);
+
+int  jobs_cmd(char** argv);
+int  fg_cmd(char** argv);
+int  bg_cmd(char** argv);
+int  wait_cmd(char** argv);
+
+#endif
@@ -0,0 +1,142 @@
+/*
+Starting external commands.
+
+fork() copies the shell's page tables, which costs time proportional to the shell's resident size, and an
+ASan build carrying the executable trie is not small. With `set -o spawn` commands are started with
+posix_spawn instead, which glibc implements with clone(CLONE_VM | CLONE_VFORK): the child borrows the
+shell's memory until it execs, so nothing is copied. The pipe and redirect dup2's become spawn file actions,
+joining the pipeline's process group and taking the terminal become spawn attributes.
+The fork path stays the default, and is still what runs builtins inside a pipeline.
+*/
+
+#define _GNU_SOURCE // posix_spawn_file_actions_addtcsetpgrp_np
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include <spawn.h>
+#include <unistd.h>
+
+#include "launch.h"
+
+extern char** environ;
+
+bool launch_spawn = false;
+
+// the shell handles or ignores these itself, a command starts with the default behaviour
+static const int reset_signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGPIPE, SIGCHLD};
+#define NUM_RESET_SIGNALS (sizeof(reset_signals) / sizeof(reset_signals[0]))
+
+static pid_t launch_posix_spawn(const char* path, char** argv, const launch_attr* attr);
+
+/// @brief start path as a child process, using the backend picked with `set -o spawn`
+/// @param path executable, a name without a '/' is searched for in PATH
+/// @param argv NULL terminated arguments, argv[0] included
+/// @param attr fd changes, process group and terminal for the child
+/// @return pid of the child, -1 if it could not be started (already reported on stderr)
+pid_t launch_process(const char* path, char** argv, const launch_attr* attr) {
+    fflush(stdout); // the shell's own output so far goes first, a script's stdout is fully buffered
+    if (launch_spawn) {
+        return launch_posix_spawn(path, argv, attr);
+    }
+    pid_t pid = launch_fork(attr);
+    if (pid == 0) { // child process
+        if (strchr(path, '/')) {
+            execv(path, argv);
+        } else {
+            execvp(path, argv);
+        }
+        fprintf(stderr, "%s: ", path);
+        perror("execv");
+        _exit(127);
+    }
+    return pid;
+}
+
+/// @brief fork() and set the child up as described by attr, for children that run shell code instead of exec'ing
+/// @return like fork(): 0 in the child, the child's pid in the shell, -1 on failure (already reported)
+pid_t launch_fork(const launch_attr* attr) {
+    fflush(stdout); // or the child would flush a copy of whatever is still buffered
+    pid_t pid = fork(); // gotta fork otherwise if we run execv on the current process, its process image gets replaced and we can never return back to the current program
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        if (attr->pgid != -1) setpgid(0, attr->pgid);
+        if (attr->tty_fd != -1) launch_set_terminal(attr->tty_fd, getpgrp());
+        for (size_t i = 0; i < NUM_RESET_SIGNALS; ++i) {
+            signal(reset_signals[i], SIG_DFL);
+        }
+        for (size_t i = 0; i < attr->num_fds; ++i) {
+            const launch_fd* fd = &attr->fds[i];
+            if (fd->target != -1 && fd->fd != fd->target) {
+                dup2(fd->fd, fd->target);
+            }
+            if (fd->fd != fd->target && !fd->keep) close(fd->fd);
+        }
+        return 0;
+    }
+    // * the shell sets the group too, whichever of the two runs first wins the race against the next stage joining it
+    if (attr->pgid != -1) setpgid(pid, attr->pgid ? attr->pgid : pid);
+    return pid;
+}
+
+static pid_t launch_posix_spawn(const char* path, char** argv, const launch_attr* attr) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t spawn_attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&spawn_attr);
+
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    sigset_t defaults;
+    sigset_t mask;
+    sigemptyset(&defaults);
+    sigemptyset(&mask);
+    for (size_t i = 0; i < NUM_RESET_SIGNALS; ++i) {
+        sigaddset(&defaults, reset_signals[i]);
+    }
+    posix_spawnattr_setsigdefault(&spawn_attr, &defaults);
+    posix_spawnattr_setsigmask(&spawn_attr, &mask);
+    if (attr->pgid != -1) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&spawn_attr, attr->pgid);
+    }
+    posix_spawnattr_setflags(&spawn_attr, flags);
+
+    // * runs after the process group is set, and before the dup2's below so tty_fd is still the shell's
+    if (attr->tty_fd != -1) posix_spawn_file_actions_addtcsetpgrp_np(&actions, attr->tty_fd);
+    for (size_t i = 0; i < attr->num_fds; ++i) {
+        const launch_fd* fd = &attr->fds[i];
+        if (fd->target != -1 && fd->fd != fd->target) {
+            posix_spawn_file_actions_adddup2(&actions, fd->fd, fd->target);
+        }
+        if (fd->fd != fd->target && !fd->keep) posix_spawn_file_actions_addclose(&actions, fd->fd);
+    }
+
+    pid_t pid = -1;
+    // * glibc reports a failed exec here instead of in the child, so there is no half started process to reap
+    int err = strchr(path, '/') ? posix_spawn(&pid, path, &actions, &spawn_attr, argv, environ)
+                                : posix_spawnp(&pid, path, &actions, &spawn_attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&spawn_attr);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", path, strerror(err));
+        return -1;
+    }
+    return pid;
+}
+
+/// @brief make pgid the terminal's foreground process group
+/// * SIGTTOU is blocked around it, a background group asking for the terminal would otherwise be stopped
+void launch_set_terminal(int tty_fd, pid_t pgid) {
+    sigset_t ttou;
+    sigset_t old;
+    sigemptyset(&ttou);
+    sigaddset(&ttou, SIGTTOU);
+    sigprocmask(SIG_BLOCK, &ttou, &old);
+    tcsetpgrp(tty_fd, pgid);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
@@ -0,0 +1,31 @@
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// one fd change made in the child before it execs: dup2(fd, target) then close(fd), or just close(fd) if target is -1
+typedef struct launch_fd launch_fd;
+struct launch_fd {
+    int fd;
+    int target;
+    bool keep; // no close(fd) after the dup2, for n>&m where m is still in use
+};
+
+// how the child is set up before it execs
+typedef struct launch_attr launch_attr;
+struct launch_attr {
+    const launch_fd* fds; // applied in order
+    size_t num_fds;
+    pid_t pgid;           // -1 to stay in the shell's process group, 0 for a new group led by the child, otherwise the group to join
+    int tty_fd;           // terminal to hand to the child's process group, -1 to leave it alone
+};
+
+extern bool launch_spawn; // `set -o spawn`, launch with posix_spawn instead of fork + exec
+
+pid_t launch_process(const char* path, char** argv, const launch_attr* attr);
+pid_t launch_fork(const launch_attr* attr);
+void  launch_set_terminal(int tty_fd, pid_t pgid);
+
+#endif
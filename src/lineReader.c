@@ -0,0 +1,93 @@
+/*
+Buffered line reader for scripts, shell -c and commands piped into the shell.
+
+readline() is for a human at a terminal: it sets up the terminal and redraws the line on every key.
+A script is read a LINE_READER_CHUNK at a time instead, and each line is handed out in place,
+NUL terminated, without copying it.
+
+Commands share the shell's stdin, so reading ahead would steal input meant for them when the script itself
+comes from stdin. For a regular file, line_reader_sync() seeks the descriptor back to the end of the current
+line before a command runs. A pipe can't be rewound, so like dash the read ahead is simply not available to
+the commands.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "lineReader.h"
+
+void line_reader_init_fd(line_reader* r, int fd) {
+    struct stat st;
+    r->fd = fd;
+    r->cap = LINE_READER_CHUNK;
+    r->buf = malloc(r->cap + 1);
+    r->start = r->end = 0;
+    r->eof = false;
+    r->seekable = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+void line_reader_init_str(line_reader* r, const char* str) {
+    size_t len = strlen(str);
+    r->fd = -1;
+    r->cap = len;
+    r->buf = malloc(len + 1);
+    memcpy(r->buf, str, len);
+    r->start = 0;
+    r->end = len;
+    r->eof = true;
+    r->seekable = false;
+}
+
+/// @brief next line without its newline, the last one doesn't need one
+/// @return line inside the reader's buffer, valid until the next call, NULL at the end of the input
+char* line_reader_next(line_reader* r) {
+    while (1) {
+        char* nl = memchr(r->buf + r->start, '\n', r->end - r->start);
+        if (nl || (r->eof && r->start < r->end)) {
+            char* line = r->buf + r->start;
+            char* line_end = nl ? nl : r->buf + r->end;
+            *line_end = '\0'; // buf has a spare byte past cap for a last line without a newline
+            r->start = line_end - r->buf + (nl != NULL);
+            return line;
+        }
+        if (r->eof) return NULL;
+
+        // move the partial line to the front, and grow if a single line fills the whole buffer
+        memmove(r->buf, r->buf + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+        if (r->end == r->cap) {
+            r->cap *= 2;
+            r->buf = realloc(r->buf, r->cap + 1);
+        }
+        ssize_t n = read(r->fd, r->buf + r->end, r->cap - r->end);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n < 0) perror("read");
+            r->eof = true;
+        } else {
+            r->end += n;
+        }
+    }
+}
+
+/// @brief give back the read ahead, so a command started now reads its input from right after the current line
+void line_reader_sync(line_reader* r) {
+    if (!r->seekable || r->start == r->end) return;
+    if (lseek(r->fd, -(off_t) (r->end - r->start), SEEK_CUR) != -1) {
+        r->start = r->end = 0;
+        r->eof = false;
+    }
+}
+
+void line_reader_free(line_reader* r) {
+    free(r->buf);
+    r->buf = NULL;
+}
@@ -0,0 +1,27 @@
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define LINE_READER_CHUNK 65536 // bytes asked of read() at a time
+
+// reads a script a big chunk at a time and hands it out line by line, without readline
+typedef struct line_reader line_reader;
+struct line_reader {
+    int fd;        // -1 when reading from a string (shell -c)
+    char* buf;
+    size_t start;  // first byte not handed out yet
+    size_t end;    // end of the bytes read so far
+    size_t cap;
+    bool eof;
+    bool seekable; // a regular file, see line_reader_sync()
+};
+
+void  line_reader_init_fd(line_reader* r, int fd);
+void  line_reader_init_str(line_reader* r, const char* str);
+char* line_reader_next(line_reader* r);
+void  line_reader_sync(line_reader* r);
+void  line_reader_free(line_reader* r);
+
+#endif
@@ -8,20 +8,20 @@ Allows pipelined commands, command history, and output redirection.
 
 Fixes/Improvements:
 - //TODO. change printf's to gnu readline buffer variables instead.
-- //TODO. export command does not add new PATH to executable trie
 - //TODO. job control for processes
 */
 
-#define _DEFAULT_SOURCE
+#define _GNU_SOURCE // pipe2
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
 
 #include <fcntl.h>
 #include <unistd.h>
-#include <dirent.h>
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -30,323 +30,349 @@ Fixes/Improvements:
 #include "autocomplete.h"
 #include "historyList.h"
 #include "history.h"
+#include "historyFile.h"
+#include "historySearch.h"
+#include "historyExpand.h"
 #include "readline_init.h"
-
+#include "pathCache.h"
+#include "pathWatcher.h"
+#include "tokenizer.h"
+#include "launch.h"
+#include "jobs.h"
+#include "lineReader.h"
+#include "redirect.h"
+#include "frecency.h"
+#include "pathGlob.h"
+
+int run_interactive(void);
+int run_script(line_reader* reader, bool rewind_stdin);
+char* heredoc_readline(void);
+char* heredoc_script_line(void);
+int run_line(char* line);
+int last_status(void);
 int handle_inputs(const char* input);
-char** tokenize(char* line);
-
-int handle_out_redir(char** argv);
-
-int _spawn_process(int input_fd, int output_fd, char** command);
-int* _get_pipeline_indices(char** argv, int* pipe_cnt);
-int _fork_pipes(char** argv, int* pipe_idx_arr, int num_pipes);
-int handle_pipelines(char** argv);
+void record_commands(const token_list* tokens);
+int handle_command(token_list* tokens);
+char* command_text(token_list* tokens);
+
+pid_t _spawn_process(int input_fd, int output_fd, char** command, pid_t pgid, const redirect_list* redirs);
+size_t stage_fds(int input_fd, int output_fd, const redirect_list* redirs, launch_fd* fds);
+bool can_run_in_shell(char* command);
+bool can_run_in_pipeline(char* command);
+int run_builtin_fds(char** argv, const launch_fd* fds, size_t num_fds);
+pid_t fork_builtin(char** argv, const launch_attr* attr);
+int* _get_pipeline_indices(token_list* tokens, int* pipe_cnt);
+int handle_pipelines(token_list* tokens);
+void finish_command(pid_t* pids, size_t num_pids, pid_t pgid);
+void set_status(const int* statuses, size_t num_statuses);
+const char* shell_var_lookup(const char* name, const char* subscript);
 
 int find_exe_files(const char* filename, char** exe_path);
-void run_exe_files(char** argv, char* fullpath);
+void run_exe_files(char** argv, char* fullpath, const launch_fd* fds, size_t num_fds);
 
 void type_cmd(char** arg, char** exe_path);
 void echo_cmd(char** msg);
 void print_working_dir();
 void change_dir(char** argv);
+void hash_cmd(char** argv);
+void export_cmd(char** argv);
+void set_cmd(char** argv);
 
 int is_builtin(char* command);
 int run_builtin(char** argv);
 
+// `set -o name` / `set +o name`
+typedef struct shell_option shell_option;
+struct shell_option {
+    const char* name;
+    bool* value;
+};
+
+static shell_option shell_options[] = {
+    {"spawn", &launch_spawn}, // start commands with posix_spawn instead of fork + exec
+    {"fuzzy", &ac_fuzzy},     // complete subsequences (`gcm` to git-credential-manager) when no name starts with the word
+    {NULL, NULL},
+};
+
+#define BUILTIN_OUT_BUF 65536 // stdout buffer of a builtin writing into a pipe or file, instead of a flush per line
+
+static char builtin_out_buf[BUILTIN_OUT_BUF];
+// builtins that change the shell, in a pipeline they keep running in a copy of it like in bash so the change is lost
+static const char* stateful_builtins[] = {"cd", "export", "set", "hash", "fg", "bg", "wait", NULL};
+static bool run_in_background = false; // the command being run was followed by &
+static char* current_command = NULL;   // its text, for the job table
+static line_reader* script_reader = NULL; // the script being run, heredoc bodies are its next lines
+static bool script_rewind = false;
+
+// exit status of every command in the last pipeline, $? is the last one and ${PIPESTATUS[i]} each of them
+static int* pipe_status = NULL;
+static size_t pipe_status_len = 0;
+
+/// @brief `shell` reads commands from the terminal, `shell -c 'cmd'` runs cmd, `shell file` runs a script,
+/// and with stdin not a terminal the commands piped in are run. Only the first gets readline, completion and history
+/// @return exit status of the last command, or the one given to exit
 int main(int argc, char* argv[]) {
+    bool interactive = argc == 1 && isatty(STDIN_FILENO);
+    jobs_init(interactive);
+    tokenize_var_lookup = shell_var_lookup;
+    set_status((int[]) {0}, 1);
 
-    char* line = NULL;
+    if (interactive) {
+        run_interactive();
+    } else {
+        line_reader reader;
+        int fd = STDIN_FILENO;
+        if (argc > 2 && !strcmp(argv[1], "-c")) {
+            line_reader_init_str(&reader, argv[2]);
+        } else if (argc > 1 && !strcmp(argv[1], "-c")) {
+            fprintf(stderr, "%s: -c: option requires an argument\n", argv[0]);
+            return 2;
+        } else {
+            if (argc > 1 && (fd = open(argv[1], O_RDONLY | O_CLOEXEC)) == -1) {
+                fprintf(stderr, "%s: %s: %s\n", argv[0], argv[1], strerror(errno));
+                return 127;
+            }
+            fd = redirect_fd_high(fd); // * the script stays open while it runs, `cat <&3` must not read it
+            line_reader_init_fd(&reader, fd);
+        }
+        run_script(&reader, fd == STDIN_FILENO && reader.fd != -1);
+        line_reader_free(&reader);
+        if (fd != STDIN_FILENO) close(fd);
+    }
+
+    int status = last_status();
+    path_cache_free();
+    free(pipe_status);
+    jobs_free();
+    return status;
+}
+
+/// @brief the readline loop, with completion, history and job notifications
+/// @return once exit is run or the terminal is closed (^D)
+int run_interactive(void) {
     init_readline();
     init_ac();
-    history = create_history_list();
+    history = create_history_list(history_size_setting());
+    history_file_open(history); // shared with the other sessions, no history file just means nothing is saved
+    frecency_open(); // how often and how recently each command ran, completion lists the top ones first
+    redirect_heredoc_reader = heredoc_readline;
 
     while (1) {
-        line = readline("$ ");
+        jobs_notify(); // background jobs that finished or stopped since the last prompt
+        char* line = readline("$ ");
+        if (line == NULL) { // ^D
+            printf("exit\n");
+            break;
+        }
+        if (!*line) {
+            free(line);
+            continue;
+        }
 
-        if (line != NULL && *line) {
-            add_history_entry(history, line);
-        } 
-        else {
+        char* expanded = NULL;
+        int expand_result = history_expand(history, line, &expanded);
+        if (expand_result < 0) { // event not found, the line isn't run or remembered
+            set_status((int[]) {1}, 1);
             free(line);
             continue;
         }
-        if (handle_inputs(line)) {
+        if (expand_result > 0) { // shown like bash, and remembered expanded
             free(line);
-            break; // exit cmd
+            line = expanded;
+            printf("%s\n", line);
         }
+        add_history_entry(history, line);
+        history_file_append(line);
 
+        int done = run_line(line);
         free(line);
+        if (done) break; // exit cmd
     }
     cleanup_ac();
     free_history_list(history);
+    history_file_close();
+    history_search_free();
+    history_expand_free();
+    frecency_close();
     return 0;
 }
 
-/// @brief tokenizes string for handling, then parses each argument and executes commands
-/// @param input user input 
-/// @return 1 for break command to end program, 0 otherwise
-int handle_inputs(const char* input) {
-    char* inputDup = (char*) strdup(input); // since strtok is destructive 
-    char* ptr = inputDup;
-    // since I dont know the size of exe_path, declare as NULL and pass it's address into find_exe_files()
-    char* exe_path = NULL; // NOTE. for some reason, executing a file in PATH does not need the full path, so this is kinda useless
+/// @brief a heredoc body line typed at the "> " prompt, kept out of the history
+char* heredoc_readline(void) {
+    static char* line = NULL;
+    free(line);
+    line = readline("> ");
+    return line;
+}
 
-    char** argv = tokenize(ptr);
+/// @brief a heredoc body line, the script's next line
+char* heredoc_script_line(void) {
+    char* line = line_reader_next(script_reader);
+    if (line && script_rewind) line_reader_sync(script_reader);
+    return line;
+}
 
-    if (!(*argv)) { // failed to tokenize 
-        free(inputDup);
-        free(argv);
-        return 0; 
-    }
-    if (!handle_out_redir(argv)) {
-        free(inputDup);
-        free(argv);
-        return 0;
-    } 
-    else if (!handle_pipelines(argv)) {
-        free(inputDup);
-        free(argv);
-        return 0;
-    } 
-    else if (!strncmp(argv[0], "exit", 4)) { // separate case since run_builtin() calls exit(0)
-        free(inputDup);
-        free(argv);
-        return 1;
-    }
-    else if (is_builtin(argv[0])) {
-        run_builtin(argv);
-        free(inputDup);
-        free(argv);
-        return 0;
-    } 
-    else if (find_exe_files(argv[0], &exe_path)) {
-        run_exe_files(argv, exe_path);
-    } 
-    else {
-        printf("%s: not found\n", argv[0]);
+/// @brief run every line of a script, no prompt and nothing of readline's
+/// @param rewind_stdin the script is the shell's stdin, so the commands must not lose input to the reader's read ahead
+/// @return once exit is run or the input ends
+int run_script(line_reader* reader, bool rewind_stdin) {
+    script_reader = reader;
+    script_rewind = rewind_stdin;
+    redirect_heredoc_reader = heredoc_script_line;
+    char* line = NULL;
+    while ((line = line_reader_next(reader))) {
+        jobs_notify(); // background jobs that finished are dropped quietly
+        if (rewind_stdin) line_reader_sync(reader);
+        if (run_line(line)) break;
     }
-    if (exe_path) free(exe_path);
-    free(argv);
-    free(inputDup);
     return 0;
 }
 
-/// @brief Categorizing args as IN_DOUBLE, IN_SINGLE, OUTSIDE, using quote rules.
-/// @param line the shell input to be tokenized
-/// @return argv, NULL terminated array of strings that contain the tokens
-char** tokenize(char* line) {
-
-    typedef enum token {
-        IN_DOUBLE, IN_SINGLE, OUTSIDE
-    } token_t;
-
-    token_t state = OUTSIDE;
-    char** argv = NULL;
-    size_t argc = 0;
-    char* token = NULL;
-
-    bool token_done = true;
-    
-    // strip leading whitespaces
-    while(*line == ' ') { ++line; }
-
-    char* ptr = line;
-
-    while(*ptr) {
-        // continue processing on token or start new one
-        if (state == OUTSIDE) {
-            // strip leading whitespaces before starting new token
-            // * since extra spaces between tokens are collapsed to just one
-            while(*ptr == ' ') {
-                ++ptr;
-            }
-
-            if (*ptr == '\0') break; // reached the end
+/// @brief run one line of input, blank lines do nothing
+/// @return 1 if it was exit
+int run_line(char* line) {
+    const char* p = line + strspn(line, " \t");
+    if (*p == '\0') return 0;
+    return handle_inputs(p);
+}
 
-            token = ptr;
+/// @brief $?, what the shell exits with
+int last_status(void) {
+    return pipe_status_len ? pipe_status[pipe_status_len - 1] : 0;
+}
 
-            if (*ptr == '"') {
-                    state = IN_DOUBLE;
-                    // does not include the quote char
-                    if (token_done) { token = ++ptr; }
-            } else if (*ptr == '\'') {
-                    state = IN_SINGLE;
-                    if (token_done) { token = ++ptr; }
-            } else {
-                state = OUTSIDE; 
-            }
-            // first realloc call with NULL is treated as malloc, doing +2 to account for final NULL entry
-            // * note the use of sizeof(char*) since argv is an array of strings!
-            if (token_done) {
-                argv = realloc(argv, sizeof(char*) * (argc + 2));
-                argv[argc++] = token;
-                token_done = false;
+/// @brief tokenizes string for handling, then runs each command of it, everything before a '&' in the background
+/// @param input user input 
+/// @return 1 for break command to end program, 0 otherwise
+int handle_inputs(const char* input) {
+    token_list tokens;
+    tokenize(input, &tokens);
+    path_glob_tokens(&tokens); // *.c, src/**/*.h
+    record_commands(&tokens);
+
+    int ret = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= tokens.len && !ret; ++i) {
+        if (i < tokens.len && tokens.kinds[i] != TOK_AMP) continue;
+        if (i == start) { // nothing before this '&', or the line ended right after one
+            if (i < tokens.len) {
+                fprintf(stderr, "syntax error near unexpected token `&'\n");
+                set_status((int[]) {2}, 1);
             }
+            break;
         }
-        // processing current token
-        switch(state) {
-            case IN_SINGLE:
-                // condition is irrelevant since if we parsed till the end of a string without closing quote
-                // that is an illegal quote
-                while (*ptr) {
-                    if (*ptr == '\'') {
-                        // only start a new token if the char after ' is a SPACE
-                        if (*(ptr + 1) == ' ') {
-                            *(ptr++) = '\0'; // end current token by replacing '
-                            token_done = true;
-                        } else {
-                            memmove(ptr, ptr + 1, strlen(ptr + 1) + 1);
-                        }
-                        break;
-                    }
-                    ++ptr;
-                }
-                state = OUTSIDE;
-                break;
-            case IN_DOUBLE:
-                while (*ptr) {
-                    // preserve backslash rules
-                    if (*ptr == '\\' && (ptr[1] == '"' || ptr[1] == '\\' || ptr[1] == '$')) {
-                        memmove(ptr, ptr + 1, strlen(ptr + 1) + 1);
-                    } else if (*ptr == '"') {
-                        // only start a new token if the char after " is a SPACE
-                        if (ptr[1] == ' ') {
-                            *(ptr++) = '\0'; // end current token on "
-                            token_done = true;
-                        } else {
-                            memmove(ptr, ptr + 1, strlen(ptr + 1) + 1);
-                        }
-                        break;
-                    }
-                    ++ptr; 
-                }
-                state = OUTSIDE;
-                break;
-            // OUTSIDE
-            default: 
-                while (*ptr) {
-                    // preserve backslashed literal
-                    if (*ptr == '\\') {
-                        memmove(ptr, ptr + 1, strlen(ptr + 1) + 1);
-                    // unescaped space signals start of new token
-                    } else if (*ptr == ' ') {
-                        token_done = true;
-                        break;
-                    // current token will switch state
-                    } else if (*ptr == '\'' || *ptr == '"') {
-                        break;
-                    }
-                    ++ptr;
-                }
-                // since we didnt move pointer after breaking on a space, space gets overwritten
-                if (token_done && *ptr != '\0') { *(ptr++) = '\0'; }
-                state = OUTSIDE;
-        }
-    }
-    if (argv) {
-        argv[argc] = NULL;
-    } else {
-        argv = malloc(sizeof(char*));
-        *argv = NULL;
-    }
-    return argv;
+        token_list command = {.argv = tokens.argv + start, .kinds = tokens.kinds + start, .len = i - start, .buf = NULL};
+        if (i < tokens.len) tokens.argv[i] = NULL; // end this command's arguments at the '&'
+        run_in_background = i < tokens.len;
+        current_command = command_text(&command);
+        ret = handle_command(&command);
+        free(current_command);
+        current_command = NULL;
+        start = i + 1;
+    }
+    run_in_background = false;
+    token_list_free(&tokens);
+    return ret;
 }
-/// @brief
-/// THE CHAR(S) ">" MUST BE THEIR OWN TOKEN (SEPERATED BY SPACES) TO BE PARSED CORRECTLY
-/// @param argv 
-/// @return 
-int handle_out_redir(char** argv) {
-    bool out_reder = false;
-    bool err_reder = false;
-    int append_out = 0;
-    int append_err = 0;
-    int trunc = 0;
-    int saved_stream = -1;
-    int stream = -1;
-    int fd = 0;
-    int result = -1;
-    int output_idx = -1;
-    char* fname = NULL;
-
-    for (int i = 0; argv[i]; ++i) {
-        out_reder = !strcmp(argv[i], ">") || !strcmp(argv[i], "1>");
-        err_reder = !strcmp(argv[i], "2>");
-        if (!strcmp(argv[i], "1>>") || !strcmp(argv[i], ">>")) {
-            append_out = O_APPEND;
-        } else if (!strcmp(argv[i], "2>>") || !strcmp(argv[i], ">>")) {
-            append_err = O_APPEND;
-        }
-        // set open() flags and stream depending on command
-        if (out_reder || append_out) {
-            stream = STDOUT_FILENO;
-            trunc = append_out ? 0 : O_TRUNC; // trunc and append are mutually exclusive
-        } else if (err_reder || append_err) {
-            stream = STDERR_FILENO;
-            trunc = append_err ? 0 : O_TRUNC;
-        } else {
-            continue;
-        }
 
-        output_idx = i;
-        fname = argv[i + 1];
-       
-        if (fflush(NULL)) { // * flush buffer before changing which fd stdx refers to, that way we dont get any undefined behaviour (was a pain to debug!)
-            perror("fflush before dup2");
-            exit(1);
-        }
-        fd = open(fname, O_CREAT | trunc | O_RDWR | append_out | append_err, S_IRWXU); // create file if DNE, or fully truncate it if it does, set mode of created file to read, write, ex permissions
-        if (fd == -1) {
-            perror("open file");
-            exit(1);
-        }
-        saved_stream = dup(stream); // * REMEMBER TO SAVE ORIGINAL STDx FD (1) SO THAT AFTER THE FUNCTION FINISHES WE CAN PRINT TO STDx INSTEAD OF THE FILE
-        result = dup2(fd, stream); // stdx_fileno now refers to fd
-        if (result == -1) {
-            perror("dup2 fd");
-            exit(1);
+/// @brief count a run of every command on the line, the first word of each pipeline stage, for completion ranking
+/// * paths like ./build.sh are left out, they aren't what command completion offers
+void record_commands(const token_list* tokens) {
+    bool command_next = true;
+    for (size_t i = 0; i < tokens->len; ++i) {
+        token_kind kind = tokens->kinds[i];
+        if (kind == TOK_PIPE || kind == TOK_AMP) {
+            command_next = true;
+        } else if (token_is_redir(kind)) {
+            ++i; // its file, fd or heredoc delimiter
+        } else if (command_next) {
+            if (*tokens->argv[i] && !strchr(tokens->argv[i], '/')) frecency_add(tokens->argv[i]);
+            command_next = false;
         }
-        close(fd);
-        break;
     }
+}
 
-    if (output_idx < 0) return 1;
+/// @brief parses one command's arguments and executes it
+/// @param tokens the command, a slice of the line's tokens
+/// @return 1 for break command to end program, 0 otherwise
+int handle_command(token_list* tokens) {
+    // since I dont know the size of exe_path, declare as NULL and pass it's address into find_exe_files()
+    char* exe_path = NULL; // NOTE. for some reason, executing a file in PATH does not need the full path, so this is kinda useless
+    char** argv = tokens->argv;
 
-    // execute the command whose output gets redirected
-    char* exe_path = NULL;
-    if (find_exe_files(argv[0], &exe_path)) {
-        argv[output_idx] = NULL; // don't treat any tokens past here as arguments
-        run_exe_files(argv, exe_path);
-        free(exe_path);
-    } else {
-        perror("failed to find executable");
+    if (!(*argv)) { // nothing to run
+        return 0; 
     }
-    // once executed, revert back to stdx!
-    if (saved_stream >= 0) {
-        dup2(saved_stream, stream);
-        close(saved_stream); // always close duplicate fds
-    } else {
-        perror("stdout");
-        exit(1);
+    if (!handle_pipelines(tokens)) {
+        return 0;
     }
-    return 0;
+
+    redirect_list redirs;
+    int err = redirect_parse(tokens, &redirs);
+    int ret = 0;
+    if (err) {
+        set_status((int[]) {err}, 1);
+    }
+    else if (!(*argv)) { // only redirects, like `> file`, opening the files was all there is to do
+        set_status((int[]) {0}, 1);
+    }
+    else if (!strcmp(argv[0], "exit")) { // separate case since run_builtin() calls exit(0)
+        if (argv[1]) set_status((int[]) {atoi(argv[1]) & 0xff}, 1); // otherwise the shell exits with the last status
+        ret = 1;
+    }
+    else if (is_builtin(argv[0]) && run_in_background) { // runs in a forked copy of the shell, as a job
+        pid_t pid = _spawn_process(STDIN_FILENO, STDOUT_FILENO, argv, 0, &redirs);
+        finish_command(&pid, 1, pid > 0 ? pid : 0);
+    }
+    else if (is_builtin(argv[0])) { // in the shell, with its fds pointed wherever the redirects say meanwhile
+        int status = run_builtin_fds(argv, redirs.fds, redirs.len);
+        set_status((int[]) {status < 0 ? 1 : status}, 1);
+    } 
+    else if (find_exe_files(argv[0], &exe_path)) {
+        run_exe_files(argv, exe_path, redirs.fds, redirs.len);
+    } 
+    else {
+        printf("%s: not found\n", argv[0]);
+        set_status((int[]) {127}, 1);
+    }
+    redirect_list_free(&redirs);
+    if (exe_path) free(exe_path);
+    return ret;
+}
+
+/// @brief the command's tokens joined by spaces, how jobs shows it
+/// @return malloc'd string, MUST BE FREE'D BY CALLER
+char* command_text(token_list* tokens) {
+    size_t len = 0;
+    for (size_t i = 0; i < tokens->len; ++i) {
+        len += strlen(tokens->argv[i]) + 1;
+    }
+    char* text = malloc(len + 1);
+    text[0] = '\0';
+    char* end = text;
+    for (size_t i = 0; i < tokens->len; ++i) {
+        if (i) *end++ = ' ';
+        end = stpcpy(end, tokens->argv[i]);
+    }
+    return text;
 }
 
 /// @brief 
-/// @param argv 
+/// @param tokens 
 /// @return 
-int* _get_pipeline_indices(char** argv, int* pipe_cnt) {
+int* _get_pipeline_indices(token_list* tokens, int* pipe_cnt) {
     int* pipe_idx_arr = NULL;
     // count indices to malloc array
     int pipe_cntr = 0;
-    for (int i = 0; argv[i]; ++i) {
-        if (!strcmp(argv[i], "|")) ++pipe_cntr;
+    for (size_t i = 0; i < tokens->len; ++i) {
+        if (tokens->kinds[i] == TOK_PIPE) ++pipe_cntr;
     }
     if (pipe_cntr == 0) return NULL;
     pipe_idx_arr = malloc((pipe_cntr + 1) * sizeof(int)); // use '-1' sentinel
     // store pipeline indices to be split on
     int curr_idx = 0;
-    for (int i = 0; argv[i]; ++i) {
-        if (!strcmp(argv[i], "|")) {
+    for (size_t i = 0; i < tokens->len; ++i) {
+        if (tokens->kinds[i] == TOK_PIPE) {
             pipe_idx_arr[curr_idx++] = i;
         }
     }
@@ -355,98 +381,300 @@ int* _get_pipeline_indices(char** argv, int* pipe_cnt) {
     return pipe_idx_arr;
 }
 
-int _spawn_process(int input_fd, int output_fd, char** command) {
-    pid_t parent = fork();
-    if (!parent) {
-        if (input_fd != STDOUT_FILENO) {
-            dup2(input_fd, STDIN_FILENO);
-            close(input_fd);
-        }
-        if (output_fd != STDIN_FILENO) {
-            dup2(output_fd, STDOUT_FILENO);
-            close(output_fd);
-        }
+/// @brief the fd changes of one pipeline stage, its pipe ends first and then its own redirects, like `cmd 2>&1 | less` needs
+/// @param fds room for redirs->len + 2
+/// @return number of fds filled in
+size_t stage_fds(int input_fd, int output_fd, const redirect_list* redirs, launch_fd* fds) {
+    size_t num_fds = 0;
+    if (input_fd != STDIN_FILENO) fds[num_fds++] = (launch_fd) {.fd = input_fd, .target = STDIN_FILENO};
+    if (output_fd != STDOUT_FILENO) fds[num_fds++] = (launch_fd) {.fd = output_fd, .target = STDOUT_FILENO};
+    memcpy(fds + num_fds, redirs->fds, redirs->len * sizeof(launch_fd));
+    return num_fds + redirs->len;
+}
 
-        if (is_builtin(command[0])) { // NOTE. assuming builtin is always the first command
-            int status = run_builtin(command);
-            exit(status);
-        }
-        
-        return execvp(command[0], command); // decision made not to use my find_exe_files function here
-        perror("execvp"); 
-        exit(1);
+/// @brief start one stage of a pipeline in process group pgid
+/// @param pgid 0 to start a new group led by this stage
+/// @param redirs the stage's own redirects, applied after the pipe ends
+/// @return pid of the stage, -1 if it could not be started
+pid_t _spawn_process(int input_fd, int output_fd, char** command, pid_t pgid, const redirect_list* redirs) {
+    launch_fd* fds = malloc((redirs->len + 2) * sizeof(launch_fd));
+    size_t num_fds = stage_fds(input_fd, output_fd, redirs, fds);
+    // a background job doesn't get the terminal
+    launch_attr attr = {.fds = fds, .num_fds = num_fds, .pgid = job_control ? pgid : -1, .tty_fd = run_in_background ? -1 : shell_tty};
+
+    pid_t pid;
+    if (is_builtin(command[0])) { // a builtin needs a copy of the shell to run in
+        pid = fork_builtin(command, &attr);
+    } else {
+        // decision made not to use my find_exe_files function here, a bare name is searched for in PATH
+        pid = launch_process(command[0], command, &attr);
     }
-    return 0;
+    free(fds);
+    return pid;
 }
 
-int _fork_pipes(char** argv, int* pipe_idx_arr, int num_pipes) {
-    int fd[2]; // [0] for read, [1] for write
-    int inputfd = STDIN_FILENO;
-    int size = 0;
-    char** argv1 = NULL;
+/// @brief whether a builtin can run in the shell process itself, exit would end the shell instead of a pipeline stage
+bool can_run_in_shell(char* command) {
+    return is_builtin(command) == 1 && strcmp(command, "exit");
+}
 
-    for (int i = 0; i < num_pipes; ++i) {
-        if (pipe(fd)) {
-            perror("pipe");
-            exit(1);
+/// @brief whether a pipeline stage can run in the shell process, only builtins that just print something
+bool can_run_in_pipeline(char* command) {
+    if (!can_run_in_shell(command)) return false;
+    for (const char** builtin = stateful_builtins; *builtin; ++builtin) {
+        if (!strcmp(command, *builtin)) return false;
+    }
+    return true;
+}
+
+/// @brief run a builtin in the shell with its fds pointed elsewhere until it returns
+/// * stdout is fully buffered meanwhile, and SIGPIPE ignored so a reader that quit early ends the builtin's output
+/// * with EPIPE instead of killing the shell
+/// @param fds applied like launch.c does in a child, except that no fd is closed, they are the caller's to close
+/// @return what run_builtin() returned
+int run_builtin_fds(char** argv, const launch_fd* fds, size_t num_fds) {
+    int saved[REDIR_FD_MIN]; // the shell's own fd for each of 0-9 that gets changed, -1 if it wasn't open
+    bool changed[REDIR_FD_MIN] = {false};
+    fflush(stdout);
+    fflush(stderr);
+    for (size_t i = 0; i < num_fds; ++i) {
+        int target = fds[i].target == -1 ? fds[i].fd : fds[i].target;
+        if (target < REDIR_FD_MIN && !changed[target]) {
+            changed[target] = true;
+            saved[target] = fcntl(target, F_DUPFD_CLOEXEC, REDIR_FD_MIN);
         }
-        if (i == 0) {
-            size = pipe_idx_arr[i];
-        } else {
-            size = pipe_idx_arr[i] - pipe_idx_arr[i - 1] - 1;
+        if (fds[i].target == -1) {
+            close(fds[i].fd);
+        } else if (fds[i].fd != fds[i].target) {
+            dup2(fds[i].fd, fds[i].target);
         }
-        argv1 = malloc(sizeof(char*) * (size + 1)); // +1 for NULL sentinel
-        argv1[size] = NULL;
-        size_t start = (i == 0) ? 0 : pipe_idx_arr[i - 1] + 1;
-        memcpy(argv1, argv + start, size * sizeof(char*));
-        _spawn_process(inputfd, fd[1], argv1);
-        free(argv1);
-        close(fd[1]); // parent can only be here at this point
-        inputfd = fd[0]; // inputfd for next command is the read end of the pipe
     }
-    if (inputfd != STDIN_FILENO) {
-        dup2(inputfd, STDIN_FILENO);
-        close(inputfd);
+    setvbuf(stdout, builtin_out_buf, _IOFBF, sizeof(builtin_out_buf));
+    struct sigaction ignore = {.sa_handler = SIG_IGN};
+    struct sigaction old_pipe;
+    sigaction(SIGPIPE, &ignore, &old_pipe);
+
+    int status = run_builtin(argv);
+
+    fflush(stdout);
+    fflush(stderr);
+    clearerr(stdout);
+    clearerr(stderr);
+    sigaction(SIGPIPE, &old_pipe, NULL);
+    for (int target = 0; target < REDIR_FD_MIN; ++target) {
+        if (!changed[target]) continue;
+        if (saved[target] == -1) {
+            close(target);
+            continue;
+        }
+        dup2(saved[target], target);
+        close(saved[target]);
     }
-    // NOTE: I decided not to call waitpid on all the child processes since I believe that 
-    // this approach is easy to understand and has the necessary parallelization
-    char** last_cmd = argv + pipe_idx_arr[num_pipes - 1] + 1;
+    setvbuf(stdout, NULL, isatty(STDOUT_FILENO) ? _IOLBF : _IOFBF, BUFSIZ);
+    return status;
+}
 
-    if (is_builtin(last_cmd[0])) { // NOTE. assuming builtin is always the first command
-        int status = run_builtin(last_cmd);
-        exit(status);
-    }
-    return execvp(last_cmd[0], last_cmd);
+/// @brief run a builtin in a forked copy of the shell, for a pipeline stage in the middle or a background job
+/// @return pid of the copy, -1 if the fork failed
+pid_t fork_builtin(char** argv, const launch_attr* attr) {
+    pid_t pid = launch_fork(attr);
+    if (pid == 0) {
+        setvbuf(stdout, builtin_out_buf, _IOFBF, sizeof(builtin_out_buf)); // stdout may have been line buffered for the terminal
+        int status = run_builtin(argv);
+        if (status < 0) status = 1;
+        fflush(NULL);
+        _exit(status); // * not exit(), the forked copy must not run the shell's atexit/leak checks with the watcher thread gone
+    }
+    return pid;
 }
 
-/// @brief 
-/// @param argv 
-/// @return 
-int handle_pipelines(char** argv) {
+/// @brief launch every stage straight from the shell into one process group, then wait for all of them
+/// * a builtin as the last stage runs in the shell once the others started, like `ls | history 5`
+/// * otherwise a builtin first stage does, after the rest started so its output has a reader, like `history | grep foo`
+/// * anywhere else, or in the background, a builtin still gets a forked copy of the shell
+/// * every stage's redirects are opened before anything starts, and apply after its pipe ends, so `ls 2>&1 | wc` counts errors too
+/// @param tokens 
+/// @return 1 if there is no pipe, 0 once the pipeline ran
+int handle_pipelines(token_list* tokens) {
+    char** argv = tokens->argv;
     int pipe_cnt = 0;
-    int* pipe_idx_arr = _get_pipeline_indices(argv, &pipe_cnt); // ! notice that we can't use my ARRAY_LEN macro on this pointer since sizeof() only works on arrays whose length are known at compile time
+    int* pipe_idx_arr = _get_pipeline_indices(tokens, &pipe_cnt); // ! notice that we can't use my ARRAY_LEN macro on this pointer since sizeof() only works on arrays whose length are known at compile time
     if (pipe_idx_arr == NULL) { 
-        free(pipe_idx_arr); 
         return 1; 
     } 
+    size_t num_stages = pipe_cnt + 1;
+    size_t* starts = malloc(num_stages * sizeof(size_t));
+    redirect_list* stage_redirs = calloc(num_stages, sizeof(redirect_list));
+    int err = 0;
+    for (size_t i = 0; i < num_stages && !err; ++i) {
+        size_t start = (i == 0) ? 0 : pipe_idx_arr[i - 1] + 1;
+        size_t end = (i == num_stages - 1) ? tokens->len : (size_t) pipe_idx_arr[i];
+        starts[i] = start;
+        if (start == end) { // nothing between two pipes
+            fprintf(stderr, "syntax error near unexpected token `|'\n");
+            err = 2;
+            break;
+        }
+        // * the stage's slice of the line, compacted to its words with a NULL where they end
+        token_list stage = {.argv = argv + start, .kinds = tokens->kinds + start, .len = end - start};
+        err = redirect_parse(&stage, &stage_redirs[i]);
+    }
+    if (err) {
+        set_status((int[]) {err}, 1);
+        for (size_t i = 0; i < num_stages; ++i) {
+            redirect_list_free(&stage_redirs[i]);
+        }
+        free(stage_redirs);
+        free(starts);
+        free(pipe_idx_arr);
+        return 0;
+    }
 
-    pid_t parent = fork(); 
-    int status = 0;
+    size_t in_shell = num_stages; // the stage run by the shell itself, num_stages for none
+    if (!run_in_background) {
+        char* last_cmd = argv[starts[num_stages - 1]];
+        if (last_cmd && can_run_in_pipeline(last_cmd)) {
+            in_shell = num_stages - 1;
+        } else if (argv[0] && can_run_in_pipeline(argv[0])) {
+            in_shell = 0;
+        }
+    }
+    // -1 where the status comes from the job, otherwise the status of a stage that never became a process
+    int* stage_status = malloc(num_stages * sizeof(int));
+    launch_fd* fds = NULL; // the in-shell stage's fd changes
+    int first_out = -1; // write end of the first pipe, kept open for a builtin first stage
 
-    if (!parent) { 
-        if (_fork_pipes(argv, pipe_idx_arr, pipe_cnt) == -1) {
+    pid_t* pids = malloc(num_stages * sizeof(pid_t));
+    pid_t pgid = 0; // the first stage that starts leads the group
+    int inputfd = STDIN_FILENO;
+    for (size_t i = 0; i < num_stages; ++i) {
+        int fd[2] = {-1, -1}; // [0] for read, [1] for write
+        bool last = i == num_stages - 1;
+        // * close on exec, so no stage holds on to a pipe end it doesn't use and every reader sees EOF
+        if (!last && pipe2(fd, O_CLOEXEC)) {
             perror("pipe");
             exit(1);
         }
+        char** command = argv + starts[i];
+        stage_status[i] = -1;
+        if (command[0] == NULL) { // only redirects, like `> f | cat`
+            pids[i] = 0;
+            stage_status[i] = 0;
+        } else if (i == in_shell && last) {
+            pids[i] = 0;
+            fds = malloc((stage_redirs[i].len + 2) * sizeof(launch_fd));
+            size_t num_fds = stage_fds(inputfd, STDOUT_FILENO, &stage_redirs[i], fds);
+            int status = run_builtin_fds(command, fds, num_fds);
+            stage_status[i] = status < 0 ? 1 : status;
+        } else if (i == in_shell) {
+            pids[i] = 0;
+            first_out = fd[1];
+        } else {
+            pids[i] = _spawn_process(inputfd, last ? STDOUT_FILENO : fd[1], command, pgid, &stage_redirs[i]);
+        }
+        if (pgid == 0 && pids[i] > 0) pgid = pids[i];
+
+        if (inputfd != STDIN_FILENO) close(inputfd);
+        if (!last && fd[1] != first_out) close(fd[1]);
+        inputfd = fd[0]; // inputfd for next command is the read end of the pipe
+    }
+    if (first_out != -1) {
+        fds = malloc((stage_redirs[0].len + 2) * sizeof(launch_fd));
+        size_t num_fds = stage_fds(STDIN_FILENO, first_out, &stage_redirs[0], fds);
+        int status = run_builtin_fds(argv, fds, num_fds);
+        stage_status[0] = status < 0 ? 1 : status;
+        close(first_out); // the next stage sees EOF
+    }
+    finish_command(pids, num_stages, pgid);
+    if (pipe_status_len == num_stages) { // not if the rest was stopped
+        for (size_t i = 0; i < num_stages; ++i) {
+            if (stage_status[i] != -1) pipe_status[i] = stage_status[i];
+        }
     }
-    do {
-        waitpid(parent, &status, WUNTRACED); // reap childprocess, WUNTRACED for better reporting on process state
-    } while (!WIFEXITED(status) && !WIFSIGNALED(status)); // wait while the child did NOT end normally AND did NOT end by a signal
-    
+    for (size_t i = 0; i < num_stages; ++i) {
+        redirect_list_free(&stage_redirs[i]);
+    }
+    free(stage_redirs);
+    free(stage_status);
+    free(fds);
+    free(starts);
+    free(pids);
     free(pipe_idx_arr);
     return 0;
 }
 
+/// @brief make the processes just launched for the current command a job, and wait for it unless it was started with &
+/// @param pids pids of the pipeline in order, -1 for a stage that didn't start
+/// @param pgid process group of the command, 0 if nothing started
+void finish_command(pid_t* pids, size_t num_pids, pid_t pgid) {
+    job* j = job_create(pids, num_pids, pgid, current_command ? current_command : "");
+    if (run_in_background) {
+        if (pgid > 0) {
+            job_background(j);
+            set_status((int[]) {0}, 1);
+        } else {
+            job_remove(j);
+            set_status((int[]) {127}, 1);
+        }
+        return;
+    }
+
+    job_wait_foreground(j, false);
+    if (j->state == JOB_STOPPED) { // ^Z, stays in the job table for fg/bg
+        set_status((int[]) {128 + SIGTSTP}, 1);
+        return;
+    }
+    int* statuses = malloc(num_pids * sizeof(int));
+    for (size_t i = 0; i < num_pids; ++i) {
+        statuses[i] = j->procs[i].status;
+    }
+    set_status(statuses, num_pids);
+    free(statuses);
+    job_remove(j);
+}
+
+/// @brief record the exit statuses of the last pipeline (a single command is a pipeline of one)
+void set_status(const int* statuses, size_t num_statuses) {
+    pipe_status = realloc(pipe_status, num_statuses * sizeof(int));
+    memcpy(pipe_status, statuses, num_statuses * sizeof(int));
+    pipe_status_len = num_statuses;
+}
+
+/// @brief shell variables for the tokenizer: $? and PIPESTATUS, everything else comes from the environment
+const char* shell_var_lookup(const char* name, const char* subscript) {
+    static char* value = NULL; // valid until the next call
+    static size_t value_cap = 0;
+    size_t needed = pipe_status_len * 12 + 1; // an int and a space each
+
+    if (!strcmp(name, "?")) {
+        needed = 12;
+        subscript = NULL;
+    } else if (strcmp(name, "PIPESTATUS")) {
+        return NULL;
+    }
+    if (needed > value_cap) {
+        value = realloc(value, needed);
+        value_cap = needed;
+    }
+
+    if (!strcmp(name, "?")) {
+        snprintf(value, value_cap, "%d", pipe_status[pipe_status_len - 1]);
+    } else if (subscript && (!strcmp(subscript, "@") || !strcmp(subscript, "*"))) {
+        size_t len = 0;
+        value[0] = '\0';
+        for (size_t i = 0; i < pipe_status_len; ++i) {
+            len += snprintf(value + len, value_cap - len, i ? " %d" : "%d", pipe_status[i]);
+        }
+    } else {
+        // $PIPESTATUS is the first element, like any array
+        char* end = NULL;
+        long idx = subscript ? strtol(subscript, &end, 10) : 0;
+        if ((subscript && (*end || end == subscript)) || idx < 0 || (size_t) idx >= pipe_status_len) return NULL;
+        snprintf(value, value_cap, "%d", pipe_status[idx]);
+    }
+    return value;
+}
+
 void type_cmd(char** argv, char** exe_path) {
     const char* type = argv[1];
 
@@ -471,76 +699,23 @@ void echo_cmd(char** argv) {
     printf("\n");
 }
 
-/// @brief my own version of the access() function that attempts to find a file name in PATH
+/// @brief my own version of the access() function that attempts to find a file name in PATH, answered from the command hash table
 /// @param filename executable file to find in PATH
 /// @param exe_path buffer that gets malloc'd with full file path
 /// @return 1 for success, 0 for failure
 int find_exe_files(const char *filename, char **exe_path) {
-    // search for executable programs in PATH
-    const char* path = getenv("PATH");
-    // if we do not duplicate the path then we are actually editing the PATH environment everytime we tokenize on dir upon calling this func!
-    char* path_copy = strdup(path);
-    char* scan = path_copy;
-    char* curr_path = strtok(scan, ":");
-    bool exe_found = false;
-    // search through the list of all executable files in each PATH directory
-    while (curr_path) {
-        struct dirent** exe_list = NULL; // *MUST DECLARE AS NULL OTHERWISE ON EDGE CASE THAT FIRST DIRECTRORY SEARCHED GIVES ERR OR 0 ENTRIES, YOU ARE FREEING UNITIALIZED MEMORY!
-        int num_exe = scandir(curr_path, &exe_list, NULL, alphasort);
-        if (num_exe <= 0) { // error or 0 entries in array
-            curr_path = strtok(NULL, ":");
-            if (exe_list) free(exe_list);
-            continue;
-        }
-        for (int i = 0; i < num_exe; ++i) {
-            if (!strcmp(exe_list[i]->d_name, filename)) {
-                size_t buf_len = strlen(curr_path) + strlen(filename) + 2; // +1 for '/'
-                *exe_path = malloc(buf_len);
-                snprintf(*exe_path, buf_len, "%s/%s", curr_path, filename);
-                
-                // ensure matching filename is actually regular and exeuctable
-                struct stat st;
-                if (stat(*exe_path, &st) == 0) {
-                    if (S_ISREG(st.st_mode) && (st.st_mode & S_IXUSR)) {
-                        exe_found = true;
-                        break;
-                    }
-                }
-                free(*exe_path);
-            }
-        }
-
-        for (int i = 0; i < num_exe; ++i) {
-            free(exe_list[i]);
-        }
-        free(exe_list);
-
-        if (exe_found) break;
-        curr_path = strtok(NULL, ":");
-    }
-    free(path_copy);
-
-    if (exe_found) return 1;
-    return 0;
+    return path_cache_lookup(filename, exe_path);
 }
 
-/// @brief creates child process that executes command
+/// @brief creates child process that executes command and waits for it
 /// @param argv list of tokens
 /// @param fullpath path of exe, decision was made to use this in conjunction with exec instead of execvp because i implemented my own function to search in PATH
-void run_exe_files(char** argv, char* fullpath) {
-    pid_t pid = fork(); // gotta fork otherwise if we run execv on the current process, its process image gets replaced and we can never return back to the current program
-    int status = 0;
-    if (pid < 0) {
-        perror("fork failed before running exe");
-        exit(1);
-    } else if (!pid) { // child process
-        execv(fullpath, argv);
-        perror("execv");
-    } else { // parent process
-        do {
-            waitpid(pid, &status, WUNTRACED); // reap childprocess
-        } while (!WIFEXITED(status) && !WIFSIGNALED(status)); // wait while the child did NOT end normally AND did NOT end by a signal
-    }
+/// @param fds redirections applied in the child only, see launch_attr
+void run_exe_files(char** argv, char* fullpath, const launch_fd* fds, size_t num_fds) {
+    // its own process group with the terminal, so ^C stops the command and not the shell
+    launch_attr attr = {.fds = fds, .num_fds = num_fds, .pgid = job_control ? 0 : -1, .tty_fd = run_in_background ? -1 : shell_tty};
+    pid_t pid = launch_process(fullpath, argv, &attr);
+    finish_command(&pid, 1, pid > 0 ? pid : 0);
 }
 
 void print_working_dir() {
@@ -569,6 +744,79 @@ void change_dir(char** argv) {
     }
 }
 
+/// @brief `hash` lists remembered command locations, `hash -r` forgets them, `hash name...` looks names up and remembers them
+/// @param argv list of tokens
+void hash_cmd(char** argv) {
+    if (!argv[1]) {
+        path_cache_list();
+        return;
+    }
+    for (size_t i = 1; argv[i]; ++i) {
+        if (!strcmp(argv[i], "-r")) {
+            path_cache_reset();
+        } else if (!path_cache_add(argv[i])) {
+            printf("hash: %s: not found\n", argv[i]);
+        }
+    }
+}
+
+/// @brief `export NAME=VALUE...` sets environment variables, with no arguments lists them
+/// @param argv list of tokens
+void export_cmd(char** argv) {
+    extern char** environ;
+    if (!argv[1]) {
+        for (char** env = environ; *env; ++env) {
+            printf("declare -x %s\n", *env);
+        }
+        return;
+    }
+    for (size_t i = 1; argv[i]; ++i) {
+        char* eq = strchr(argv[i], '=');
+        if (!eq) continue; // already in the environment or unset, either way nothing to do
+        if (eq == argv[i]) {
+            printf("export: `%s': not a valid identifier\n", argv[i]);
+            continue;
+        }
+        *eq = '\0';
+        setenv(argv[i], eq + 1, 1);
+        if (!strcmp(argv[i], "PATH")) {
+            path_watcher_path_changed(eq + 1); // rebuild the executable completion trie in the background
+        }
+        else if (!strcmp(argv[i], "HISTSIZE")) {
+            resize_history_list(history, history_size_setting());
+        }
+        *eq = '=';
+    }
+}
+
+/// @brief `set -o name` turns a shell option on, `set +o name` off, `set -o` alone lists them
+/// @param argv list of tokens
+void set_cmd(char** argv) {
+    if (!argv[1] || (!strcmp(argv[1], "-o") && !argv[2])) {
+        for (shell_option* opt = shell_options; opt->name; ++opt) {
+            printf("%-15s %s\n", opt->name, *opt->value ? "on" : "off");
+        }
+        return;
+    }
+    for (size_t i = 1; argv[i]; ++i) {
+        bool on = !strcmp(argv[i], "-o");
+        if ((!on && strcmp(argv[i], "+o")) || !argv[i + 1]) {
+            printf("set: usage: set [-o|+o option]\n");
+            return;
+        }
+        const char* name = argv[++i];
+        shell_option* opt = shell_options;
+        while (opt->name && strcmp(opt->name, name)) {
+            ++opt;
+        }
+        if (!opt->name) {
+            printf("set: %s: invalid option name\n", name);
+            return;
+        }
+        *opt->value = on;
+    }
+}
+
 int is_builtin(char* command) {
     if (command == NULL) return -1;
     for (const char** builtin = builtin_cmds; *builtin; ++builtin) {
@@ -598,8 +846,11 @@ int run_builtin(char** argv) {
         return 0;
     }
     else if (!strcmp(argv[0], "history")) {
+        if (argv[1] && argv[1][0] == '-') { // -a, -n, -r
+            return history_file_cmd(argv);
+        }
         // limiting history entries
-        if (argv[1] && argv[1][0] >= '0' && argv[1][0] <= '9') {
+        else if (argv[1] && argv[1][0] >= '0' && argv[1][0] <= '9') {
             list_history(atoi(argv[1]));
         } else { // full list
             list_history(-1);
@@ -612,5 +863,29 @@ int run_builtin(char** argv) {
         if (exe_path) free(exe_path);
         return 0;
     }
+    else if (!strcmp(argv[0], "hash")) {
+        hash_cmd(argv);
+        return 0;
+    }
+    else if (!strcmp(argv[0], "export")) {
+        export_cmd(argv);
+        return 0;
+    }
+    else if (!strcmp(argv[0], "set")) {
+        set_cmd(argv);
+        return 0;
+    }
+    else if (!strcmp(argv[0], "jobs")) {
+        return jobs_cmd(argv);
+    }
+    else if (!strcmp(argv[0], "fg")) {
+        return fg_cmd(argv);
+    }
+    else if (!strcmp(argv[0], "bg")) {
+        return bg_cmd(argv);
+    }
+    else if (!strcmp(argv[0], "wait")) {
+        return wait_cmd(argv);
+    }
     return -1;
 }
\ No newline at end of file
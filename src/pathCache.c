@@ -0,0 +1,234 @@
+/*
+Command hash table, like bash's `hash`. Maps a command name to the absolute path it resolved to in PATH.
+Entries are filled lazily on first lookup, and the whole table is dropped whenever $PATH
+changes or one of its directories is modified (mtime changes on create/delete/rename).
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#include <sys/stat.h>
+
+#include "pathCache.h"
+
+typedef struct path_dir path_dir;
+struct path_dir {
+    char* dir;
+    struct timespec mtime;
+    bool exists;
+};
+
+static path_cache_entry* table = NULL;
+static size_t table_cap = 0;
+static size_t table_len = 0;
+
+static char* cached_path_env = NULL; // copy of $PATH the cache was built against
+static path_dir* dirs = NULL;
+static size_t num_dirs = 0;
+
+static unsigned int hash_str(const char* s);
+static path_cache_entry* find_slot(const char* name, unsigned int hash);
+static void table_grow(void);
+static void load_path_dirs(const char* path);
+static void free_path_dirs(void);
+static void validate_cache(void);
+static char* resolve_in_path(const char* name);
+
+/// @brief FNV-1a
+static unsigned int hash_str(const char* s) {
+    unsigned int h = 2166136261u;
+    for (; *s; ++s) {
+        h ^= (unsigned char) *s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/// @brief linear probe for name, table_cap is always a power of two
+/// @return slot holding name, or the empty slot where it would be inserted
+static path_cache_entry* find_slot(const char* name, unsigned int hash) {
+    size_t mask = table_cap - 1;
+    size_t i = hash & mask;
+    while (table[i].name) {
+        if (table[i].hash == hash && !strcmp(table[i].name, name)) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &table[i];
+}
+
+static void table_grow(void) {
+    path_cache_entry* old = table;
+    size_t old_cap = table_cap;
+
+    table_cap = old_cap ? old_cap * 2 : PATH_CACHE_INIT_CAP;
+    table = calloc(table_cap, sizeof(path_cache_entry));
+    if (table == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < old_cap; ++i) {
+        if (old[i].name) {
+            *find_slot(old[i].name, old[i].hash) = old[i];
+        }
+    }
+    free(old);
+}
+
+static void free_path_dirs(void) {
+    for (size_t i = 0; i < num_dirs; ++i) {
+        free(dirs[i].dir);
+    }
+    free(dirs);
+    dirs = NULL;
+    num_dirs = 0;
+    free(cached_path_env);
+    cached_path_env = NULL;
+}
+
+/// @brief split PATH into dirs[] and record each directory's mtime
+static void load_path_dirs(const char* path) {
+    free_path_dirs();
+    cached_path_env = strdup(path);
+
+    char* path_copy = strdup(path); // strtok is destructive
+    char* curr_path = strtok(path_copy, ":");
+    while (curr_path) {
+        dirs = realloc(dirs, sizeof(path_dir) * (num_dirs + 1));
+        path_dir* d = &dirs[num_dirs++];
+        struct stat st;
+        d->dir = strdup(curr_path);
+        d->exists = (stat(curr_path, &st) == 0);
+        d->mtime = d->exists ? st.st_mtim : (struct timespec){0};
+        curr_path = strtok(NULL, ":");
+    }
+    free(path_copy);
+}
+
+/// @brief drop every entry if $PATH was changed or a PATH directory was modified since the last lookup
+static void validate_cache(void) {
+    const char* path = getenv("PATH");
+    if (path == NULL) path = "";
+
+    if (cached_path_env == NULL || strcmp(cached_path_env, path)) {
+        path_cache_reset();
+        load_path_dirs(path);
+        return;
+    }
+    // one stat per PATH directory, instead of a full directory listing
+    for (size_t i = 0; i < num_dirs; ++i) {
+        struct stat st;
+        bool exists = (stat(dirs[i].dir, &st) == 0);
+        if (exists != dirs[i].exists || (exists &&
+            (st.st_mtim.tv_sec != dirs[i].mtime.tv_sec || st.st_mtim.tv_nsec != dirs[i].mtime.tv_nsec))) {
+            path_cache_reset();
+            load_path_dirs(path);
+            return;
+        }
+    }
+}
+
+/// @brief probe each PATH directory for name with a single stat() each
+/// @return malloc'd full path of the first regular, executable match, NULL if none
+static char* resolve_in_path(const char* name) {
+    char buf[PATH_MAX];
+    for (size_t i = 0; i < num_dirs; ++i) {
+        if (!dirs[i].exists) continue;
+
+        int len = snprintf(buf, sizeof(buf), "%s/%s", dirs[i].dir, name);
+        if (len < 0 || (size_t) len >= sizeof(buf)) continue;
+        // ensure matching filename is actually regular and executable
+        struct stat st;
+        if (stat(buf, &st) == 0 && S_ISREG(st.st_mode) && (st.st_mode & S_IXUSR)) {
+            return strdup(buf);
+        }
+    }
+    return NULL;
+}
+
+/// @brief find name in the hash table, resolving it through PATH and caching it on a miss
+/// @param name command name, names containing '/' are never looked up in PATH
+/// @param exe_path gets malloc'd with the full file path, MUST BE FREE'D BY CALLER
+/// @return 1 for success, 0 for failure
+int path_cache_lookup(const char* name, char** exe_path) {
+    if (name == NULL || *name == '\0' || strchr(name, '/')) return 0;
+
+    validate_cache();
+
+    unsigned int hash = hash_str(name);
+    if (table) {
+        path_cache_entry* e = find_slot(name, hash);
+        if (e->name) {
+            ++e->hits;
+            *exe_path = strdup(e->path);
+            return 1;
+        }
+    }
+
+    char* resolved = resolve_in_path(name);
+    if (resolved == NULL) return 0; // misses are not cached, same as bash
+
+    // keep load factor under 1/2
+    if ((table_len + 1) * 2 > table_cap) {
+        table_grow();
+    }
+    path_cache_entry* e = find_slot(name, hash);
+    e->name = strdup(name);
+    e->path = resolved;
+    e->hash = hash;
+    e->hits = 1;
+    ++table_len;
+
+    *exe_path = strdup(resolved);
+    return 1;
+}
+
+/// @brief `hash name`, resolve name and remember it without counting a hit
+/// @return 1 for success, 0 if name was not found in PATH
+int path_cache_add(const char* name) {
+    char* exe_path = NULL;
+    if (!path_cache_lookup(name, &exe_path)) return 0;
+    free(exe_path);
+    --find_slot(name, hash_str(name))->hits;
+    return 1;
+}
+
+/// @brief `hash -r`, forget every remembered location
+void path_cache_reset(void) {
+    for (size_t i = 0; i < table_cap; ++i) {
+        free(table[i].name);
+        free(table[i].path);
+    }
+    if (table) {
+        memset(table, 0, table_cap * sizeof(path_cache_entry));
+    }
+    table_len = 0;
+}
+
+/// @brief `hash` with no arguments
+void path_cache_list(void) {
+    if (table_len == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+    printf("hits\tcommand\n");
+    for (size_t i = 0; i < table_cap; ++i) {
+        if (table[i].name) {
+            printf("%4zu\t%s\n", table[i].hits, table[i].path);
+        }
+    }
+}
+
+void path_cache_free(void) {
+    path_cache_reset();
+    free(table);
+    table = NULL;
+    table_cap = 0;
+    free_path_dirs();
+}
@@ -0,0 +1,23 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <stddef.h>
+
+#define PATH_CACHE_INIT_CAP 64 // must be a power of two
+
+// bash style command hash table: command name -> resolved absolute path
+typedef struct path_cache_entry path_cache_entry;
+struct path_cache_entry {
+    char* name;
+    char* path;
+    size_t hits;
+    unsigned int hash;
+};
+
+int  path_cache_lookup(const char* name, char** exe_path);
+int  path_cache_add(const char* name);
+void path_cache_reset(void);
+void path_cache_list(void);
+void path_cache_free(void);
+
+#endif
@@ -0,0 +1,409 @@
+/*
+Pathname expansion: `*`, `?`, `[...]` and `**` in the words of a command line.
+
+A pattern is compiled once per word. It is split at '/' into components:
+- A component without glob characters is a literal, appended to the path without reading anything.
+- `**` on its own is any number of directories.
+- Anything else becomes a matcher. Its leading literal bytes are a memcmp prefix. The literal bytes after
+  its last '*' are a suffix checked from the end. Every [...] class is a 256 bit set.
+So `*.log` is a suffix compare per entry, and `exe_12*` a prefix compare.
+
+Each directory is read straight from getdents64 (dirReader.c) and every entry goes through the
+component's matcher as it comes. Nothing is listed or sorted but the matches. Those are appended to one
+buffer, sorted per word, and the command's argv is then built once at its final size.
+
+Like sh:
+- A pattern that matches nothing stays as it was typed.
+- Names starting with '.' only match a component that starts with a literal '.'.
+- `**` doesn't descend into hidden directories, or follow symlinks to directories.
+- Redirect targets and here-document delimiters are never expanded.
+Matching is bytewise, a '?' is one byte of a multibyte character.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <sys/stat.h>
+
+#include "pathGlob.h"
+#include "dirReader.h"
+
+// state of one expansion, the directory being read is path[0, len)
+typedef struct glob_walk glob_walk;
+struct glob_walk {
+    const path_glob* g;
+    glob_matches* out;
+    char path[PATH_MAX];
+};
+
+static void compile_comp(path_glob* g, glob_comp* c, const char* p, size_t n);
+static size_t compile_class(const char* p, size_t n, uint64_t* bits);
+static bool match_comp(const glob_comp* c, const char* name);
+static bool match_ops(const glob_op* ops, size_t num_ops, const char* s);
+static void walk(glob_walk* w, size_t len, size_t comp);
+static size_t append_name(glob_walk* w, size_t len, const char* name);
+static bool is_dir(glob_walk* w, const dir_ent* ent, bool follow);
+static void add_match(glob_walk* w, size_t len);
+static int compare_offsets(const void* a, const void* b);
+
+static const char* sort_names = NULL; // compare_offsets()'s names, the shell only globs on its main thread
+
+/// @brief compile pattern, as tokenize() leaves a TOK_GLOB: a backslash makes the next byte literal
+/// @return 0 on success, -1 if nothing in it is a glob after all (like a '[' without its ']'), g is still freed
+int path_glob_compile(path_glob* g, const char* pattern) {
+    memset(g, 0, sizeof(path_glob));
+    arena_init(&g->mem);
+    size_t len = strlen(pattern);
+    g->absolute = pattern[0] == '/';
+    g->dirs_only = len > 1 && pattern[len - 1] == '/' && pattern[len - 2] != '\\';
+    g->comps = arena_alloc(&g->mem, (len / 2 + 1) * sizeof(glob_comp)); // every component but the last takes a '/'
+
+    bool magic = false;
+    size_t start = 0;
+    for (size_t i = 0; i <= len; ++i) {
+        if (i < len && pattern[i] == '\\' && i + 1 < len) {
+            ++i;
+            continue;
+        }
+        if (i < len && pattern[i] != '/') continue;
+        if (i > start) { // empty components, from "//" or the ends, are skipped
+            glob_comp* c = &g->comps[g->num_comps++];
+            compile_comp(g, c, pattern + start, i - start);
+            if (c->kind != GLOB_COMP_LITERAL) magic = true;
+        }
+        start = i + 1;
+    }
+    return magic ? 0 : -1;
+}
+
+/// @brief append every path g matches to out, sorted
+/// @return number of matches added
+size_t path_glob_expand(const path_glob* g, glob_matches* out) {
+    glob_walk w = {.g = g, .out = out};
+    size_t first = out->count;
+    size_t len = 0;
+    if (g->absolute) w.path[len++] = '/';
+    w.path[len] = '\0';
+    walk(&w, len, 0);
+
+    sort_names = out->names;
+    qsort(out->offsets + first, out->count - first, sizeof(size_t), compare_offsets);
+    return out->count - first;
+}
+
+void path_glob_free(path_glob* g) {
+    arena_free(&g->mem);
+    memset(g, 0, sizeof(path_glob));
+}
+
+void glob_matches_free(glob_matches* m) {
+    free(m->names);
+    free(m->offsets);
+    memset(m, 0, sizeof(glob_matches));
+}
+
+/// @brief expand every TOK_GLOB of a line into the file names it matches, in place
+/// * the ones that match nothing, and redirect targets, are left as the words they were typed as
+void path_glob_tokens(token_list* tokens) {
+    glob_matches matches = {0};
+    size_t* firsts = NULL; // per token, its first match in matches
+    size_t* counts = NULL; // and how many, 0 keeps the word
+    size_t new_len = 0;
+    for (size_t i = 0; i < tokens->len; ++i) {
+        if (tokens->kinds[i] != TOK_GLOB) {
+            ++new_len;
+            continue;
+        }
+        if (firsts == NULL) {
+            firsts = malloc(tokens->len * sizeof(size_t));
+            counts = malloc(tokens->len * sizeof(size_t));
+        }
+        path_glob g = {0};
+        size_t count = 0;
+        bool redirect = i > 0 && token_is_redir(tokens->kinds[i - 1]);
+        if (!redirect && path_glob_compile(&g, tokens->argv[i]) == 0) {
+            firsts[i] = matches.count;
+            count = path_glob_expand(&g, &matches);
+        }
+        path_glob_free(&g);
+        counts[i] = count;
+        if (count == 0) { // * a plain word again, quoted parts and all
+            token_unescape(tokens->argv[i]);
+            tokens->kinds[i] = TOK_WORD;
+        }
+        new_len += count ? count : 1;
+    }
+    if (matches.count == 0) {
+        free(firsts);
+        free(counts);
+        glob_matches_free(&matches);
+        return;
+    }
+
+    // the new argv and kinds in one block like tokenize() allocates them, sized once
+    char* block = malloc((new_len + 1) * (sizeof(char*) + sizeof(token_kind)));
+    char** argv = (char**) block;
+    token_kind* kinds = (token_kind*) (argv + new_len + 1);
+    size_t argc = 0;
+    for (size_t i = 0; i < tokens->len; ++i) {
+        if (tokens->kinds[i] != TOK_GLOB) {
+            argv[argc] = tokens->argv[i];
+            kinds[argc++] = tokens->kinds[i];
+            continue;
+        }
+        for (size_t k = 0; k < counts[i]; ++k) {
+            argv[argc] = matches.names + matches.offsets[firsts[i] + k];
+            kinds[argc++] = TOK_WORD;
+        }
+    }
+    argv[argc] = NULL;
+    free(tokens->argv); // the old block
+    tokens->argv = argv;
+    tokens->kinds = kinds;
+    tokens->len = argc;
+    tokens->globbed = matches.names;
+    free(matches.offsets);
+    free(firsts);
+    free(counts);
+}
+
+/// @brief compile the component p[0, n), with its backslash escapes
+static void compile_comp(path_glob* g, glob_comp* c, const char* p, size_t n) {
+    memset(c, 0, sizeof(glob_comp));
+    if (n == 2 && p[0] == '*' && p[1] == '*') {
+        c->kind = GLOB_COMP_GLOBSTAR;
+        return;
+    }
+
+    glob_op* ops = arena_alloc(&g->mem, n * sizeof(glob_op)); // every op takes at least a byte of the pattern
+    size_t num_ops = 0;
+    bool magic = false;
+    for (size_t i = 0; i < n; ++i) {
+        glob_op op = {.kind = GLOB_OP_CHAR, .c = (unsigned char) p[i]};
+        if (p[i] == '\\' && i + 1 < n) {
+            op.c = (unsigned char) p[++i];
+        } else if (p[i] == '*') {
+            magic = true;
+            if (num_ops && ops[num_ops - 1].kind == GLOB_OP_STAR) continue; // `a**b` is `a*b`
+            op.kind = GLOB_OP_STAR;
+        } else if (p[i] == '?') {
+            magic = true;
+            op.kind = GLOB_OP_ANY;
+        } else if (p[i] == '[') {
+            uint64_t* bits = arena_alloc(&g->mem, 4 * sizeof(uint64_t));
+            size_t used = compile_class(p + i, n - i, bits);
+            if (used) { // otherwise a '[' without its ']' is just a '['
+                magic = true;
+                op.kind = GLOB_OP_CLASS;
+                op.bits = bits;
+                i += used - 1;
+            }
+        }
+        ops[num_ops++] = op;
+    }
+
+    // the literal ends, checked with memcmp before any op runs
+    size_t prefix_ops = 0;
+    while (prefix_ops < num_ops && ops[prefix_ops].kind == GLOB_OP_CHAR) {
+        ++prefix_ops;
+    }
+    char* prefix = arena_alloc(&g->mem, prefix_ops + 1);
+    for (size_t k = 0; k < prefix_ops; ++k) {
+        prefix[k] = (char) ops[k].c;
+    }
+    prefix[prefix_ops] = '\0';
+    c->prefix = prefix;
+    c->prefix_len = prefix_ops;
+    c->kind = magic ? GLOB_COMP_PATTERN : GLOB_COMP_LITERAL;
+    if (!magic) return;
+    c->ops = ops + prefix_ops;
+    c->num_ops = num_ops - prefix_ops;
+
+    size_t suffix_start = c->num_ops;
+    while (suffix_start > 0 && c->ops[suffix_start - 1].kind == GLOB_OP_CHAR) {
+        --suffix_start;
+    }
+    if (suffix_start > 0 && c->ops[suffix_start - 1].kind == GLOB_OP_STAR) {
+        char* suffix = arena_alloc(&g->mem, c->num_ops - suffix_start + 1);
+        for (size_t k = suffix_start; k < c->num_ops; ++k) {
+            suffix[k - suffix_start] = (char) c->ops[k].c;
+        }
+        c->suffix = suffix;
+        c->suffix_len = c->num_ops - suffix_start;
+        c->star_suffix = suffix_start == 1;
+    }
+}
+
+/// @brief compile the class at p[0] == '[': `[abc]`, `[a-z]`, `[!a]` or `[^a]`, a ']' right after the '[' is literal
+/// @param bits set to the bytes it takes
+/// @return bytes of p it takes, 0 if there is no closing ']'
+static size_t compile_class(const char* p, size_t n, uint64_t* bits) {
+    memset(bits, 0, 4 * sizeof(uint64_t));
+    size_t i = 1;
+    bool negate = i < n && (p[i] == '!' || p[i] == '^');
+    if (negate) ++i;
+    for (bool first = true; i < n; first = false) {
+        if (p[i] == ']' && !first) {
+            if (negate) {
+                for (int k = 0; k < 4; ++k) bits[k] = ~bits[k];
+            }
+            return i + 1;
+        }
+        if (p[i] == '\\' && i + 1 < n) ++i;
+        unsigned lo = (unsigned char) p[i++];
+        unsigned hi = lo;
+        if (i + 1 < n && p[i] == '-' && p[i + 1] != ']') {
+            i += (p[i + 1] == '\\' && i + 2 < n) ? 2 : 1;
+            hi = (unsigned char) p[i++];
+        }
+        for (unsigned c = lo; c <= hi; ++c) {
+            bits[c >> 6] |= 1ull << (c & 63);
+        }
+    }
+    return 0;
+}
+
+static bool match_comp(const glob_comp* c, const char* name) {
+    if (name[0] == '.' && !(c->prefix_len && c->prefix[0] == '.')) return false; // hidden
+    size_t len = strlen(name);
+    if (len < c->prefix_len + c->suffix_len) return false;
+    if (memcmp(name, c->prefix, c->prefix_len)) return false;
+    if (c->suffix_len && memcmp(name + len - c->suffix_len, c->suffix, c->suffix_len)) return false;
+    if (c->star_suffix) return true;
+    return match_ops(c->ops, c->num_ops, name + c->prefix_len);
+}
+
+/// @brief wildcard match that only ever backtracks to the last '*', so it is linear but for the bytes a '*' retries
+static bool match_ops(const glob_op* ops, size_t num_ops, const char* s) {
+    size_t i = 0;
+    size_t star = SIZE_MAX; // the last '*' seen, and the byte it was tried up to
+    const char* star_s = NULL;
+    while (*s) {
+        if (i < num_ops) {
+            const glob_op* op = &ops[i];
+            unsigned char c = (unsigned char) *s;
+            if (op->kind == GLOB_OP_STAR) {
+                star = i++;
+                star_s = s;
+                continue;
+            }
+            if ((op->kind == GLOB_OP_CHAR && op->c == c) || op->kind == GLOB_OP_ANY ||
+                (op->kind == GLOB_OP_CLASS && (op->bits[c >> 6] >> (c & 63) & 1))) {
+                ++i;
+                ++s;
+                continue;
+            }
+        }
+        if (star == SIZE_MAX) return false;
+        i = star + 1; // the '*' takes one more byte
+        s = ++star_s;
+    }
+    while (i < num_ops && ops[i].kind == GLOB_OP_STAR) {
+        ++i;
+    }
+    return i == num_ops;
+}
+
+/// @brief match component comp and the ones after it inside the directory path[0, len), which ends in '/' unless empty
+static void walk(glob_walk* w, size_t len, size_t comp) {
+    const path_glob* g = w->g;
+    const glob_comp* c = &g->comps[comp];
+    bool last = comp + 1 == g->num_comps;
+
+    if (c->kind == GLOB_COMP_LITERAL) {
+        size_t name_len = append_name(w, len, c->prefix);
+        if (name_len == 0) return;
+        struct stat st;
+        if (!last) {
+            w->path[name_len] = '/';
+            w->path[name_len + 1] = '\0';
+            walk(w, name_len + 1, comp + 1); // * a missing directory just fails to open there
+        } else if (lstat(w->path, &st) == 0 && (!g->dirs_only || (stat(w->path, &st) == 0 && S_ISDIR(st.st_mode)))) {
+            add_match(w, name_len);
+        }
+        return;
+    }
+
+    if (c->kind == GLOB_COMP_GLOBSTAR && !last) walk(w, len, comp + 1); // no directories at all
+    w->path[len] = '\0';
+    dir_reader r;
+    if (dir_reader_open(&r, len ? w->path : ".")) return;
+    dir_ent* ent;
+    while ((ent = dir_reader_next(&r))) {
+        if (c->kind == GLOB_COMP_GLOBSTAR) {
+            if (ent->d_name[0] == '.') continue;
+            size_t name_len = append_name(w, len, ent->d_name);
+            if (name_len == 0) continue;
+            bool dir = is_dir(w, ent, false);
+            if (last && (!g->dirs_only || dir)) add_match(w, name_len);
+            if (dir) {
+                w->path[name_len] = '/';
+                w->path[name_len + 1] = '\0';
+                walk(w, name_len + 1, comp);
+            }
+            continue;
+        }
+        if (!match_comp(c, ent->d_name)) continue;
+        size_t name_len = append_name(w, len, ent->d_name);
+        if (name_len == 0) continue;
+        if (last) {
+            if (!g->dirs_only || is_dir(w, ent, true)) add_match(w, name_len);
+        } else if (ent->d_type == DT_DIR || ent->d_type == DT_LNK || ent->d_type == DT_UNKNOWN) {
+            w->path[name_len] = '/';
+            w->path[name_len + 1] = '\0';
+            walk(w, name_len + 1, comp + 1);
+        }
+    }
+    if (dir_reader_error(&r)) { // * the matches read before it still count, like a directory that can't be opened
+        w->path[len] = '\0';
+        fprintf(stderr, "glob: %s: %s\n", len ? w->path : ".", strerror(dir_reader_error(&r)));
+    }
+    dir_reader_close(&r);
+}
+
+/// @brief put name after the directory path[0, len)
+/// @return the new length, 0 if it doesn't fit in PATH_MAX with a '/' after it
+static size_t append_name(glob_walk* w, size_t len, const char* name) {
+    size_t name_len = strlen(name);
+    if (len + name_len + 2 > sizeof(w->path)) return 0;
+    memcpy(w->path + len, name, name_len + 1);
+    return len + name_len;
+}
+
+/// @brief the entry just appended to path is a directory, d_type saves the stat() unless it's unknown or a symlink
+static bool is_dir(glob_walk* w, const dir_ent* ent, bool follow) {
+    if (ent->d_type == DT_DIR) return true;
+    if (ent->d_type != DT_UNKNOWN && !(follow && ent->d_type == DT_LNK)) return false;
+    struct stat st;
+    return (follow ? stat(w->path, &st) : lstat(w->path, &st)) == 0 && S_ISDIR(st.st_mode);
+}
+
+/// @brief add path[0, len) to the matches, with a '/' after it for a pattern that ended in one
+static void add_match(glob_walk* w, size_t len) {
+    glob_matches* m = w->out;
+    if (w->g->dirs_only) w->path[len++] = '/';
+    if (m->count == m->cap) {
+        m->cap = m->cap ? m->cap * 2 : GLOB_INIT_MATCHES;
+        m->offsets = realloc(m->offsets, m->cap * sizeof(size_t));
+    }
+    if (m->names_len + len + 1 > m->names_cap) {
+        if (m->names_cap == 0) m->names_cap = GLOB_INIT_NAMES;
+        while (m->names_len + len + 1 > m->names_cap) {
+            m->names_cap *= 2;
+        }
+        m->names = realloc(m->names, m->names_cap);
+    }
+    memcpy(m->names + m->names_len, w->path, len);
+    m->names[m->names_len + len] = '\0';
+    m->offsets[m->count++] = m->names_len;
+    m->names_len += len + 1;
+    if (w->g->dirs_only) w->path[--len] = '\0';
+}
+
+static int compare_offsets(const void* a, const void* b) {
+    return strcmp(sort_names + *(const size_t*) a, sort_names + *(const size_t*) b);
+}
@@ -0,0 +1,74 @@
+#ifndef PATHGLOB_H
+#define PATHGLOB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "tokenizer.h"
+
+#define GLOB_INIT_MATCHES 64
+#define GLOB_INIT_NAMES 4096 // bytes
+
+typedef enum {
+    GLOB_COMP_LITERAL,  // no glob characters, the name is just appended
+    GLOB_COMP_PATTERN,  // matched against every entry of the directory
+    GLOB_COMP_GLOBSTAR, // `**`, any number of directories
+} glob_comp_kind;
+
+typedef enum {
+    GLOB_OP_CHAR,
+    GLOB_OP_ANY,   // ?
+    GLOB_OP_STAR,  // *
+    GLOB_OP_CLASS, // [...]
+} glob_op_kind;
+
+typedef struct glob_op glob_op;
+struct glob_op {
+    glob_op_kind kind;
+    unsigned char c;
+    const uint64_t* bits; // GLOB_OP_CLASS, the 256 bytes it takes
+};
+
+// one '/' separated part of a pattern
+typedef struct glob_comp glob_comp;
+struct glob_comp {
+    glob_comp_kind kind;
+    const char* prefix; // literal bytes a name starts with, the whole name for GLOB_COMP_LITERAL
+    size_t prefix_len;
+    const char* suffix; // literal bytes after the last '*' a name ends with, if only literals follow it
+    size_t suffix_len;
+    const glob_op* ops; // everything after the prefix
+    size_t num_ops;
+    bool star_suffix; // ops are a '*' and then the suffix, so checking both ends is the whole match
+};
+
+// a compiled pattern
+typedef struct path_glob path_glob;
+struct path_glob {
+    glob_comp* comps;
+    size_t num_comps;
+    bool absolute;
+    bool dirs_only; // ended in '/', only directories match and keep the '/'
+    arena mem;
+};
+
+// the names patterns expanded to, NUL terminated back to back
+typedef struct glob_matches glob_matches;
+struct glob_matches {
+    char* names;
+    size_t names_len;
+    size_t names_cap;
+    size_t* offsets; // into names, each pattern's matches are sorted among themselves
+    size_t count;
+    size_t cap;
+};
+
+int    path_glob_compile(path_glob* g, const char* pattern);
+size_t path_glob_expand(const path_glob* g, glob_matches* out);
+void   path_glob_free(path_glob* g);
+void   glob_matches_free(glob_matches* m);
+void   path_glob_tokens(token_list* tokens);
+
+#endif
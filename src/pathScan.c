@@ -0,0 +1,293 @@
+/*
+Startup scan of the PATH directories on a small pool of worker threads.
+
+The directories used to be read one after another, so one slow directory (a network mount, a big Nix or
+Spack profile) held up all the ones after it. Here every directory is a task for the pool: a worker stat()s
+it for the executable index key, and if the main thread finds no usable index, reads it with getdents64 and
+sorts the names. The main thread takes the batches in PATH order and inserts each one as soon as it's
+ready, so merging overlaps with the reading, and sorted names insert into the radix tree about twice as fast.
+
+There is one deadline for the whole scan. A directory that hasn't answered by then is left out, and the
+workers are abandoned instead of joined: whoever finishes last frees the scan, so a hung mount can cost a
+thread but never the first prompt. A directory whose read fails partway (EIO, ESTALE) counts as late too, so
+a tree missing some of its names is never saved as the executable index.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+#include "pathScan.h"
+#include "exeIndex.h"
+#include "dirReader.h"
+
+#define INIT_BATCH_CAP 64
+
+// one PATH directory
+typedef struct scan_batch scan_batch;
+struct scan_batch {
+    char* dir;
+    int64_t mtime[2]; // seconds and nanoseconds, -1 if it doesn't exist
+    bool stat_done;
+    bool list_done;
+    bool list_failed; // a read error cut the listing short, or it couldn't be read for a reason other than not being there
+    arena names;      // the NUL terminated names that list points to
+    char** list;      // sorted
+    size_t len;
+    size_t cap;
+};
+
+struct path_scan {
+    pthread_mutex_t lock;      // guards everything below except what a worker owns while it runs a task
+    pthread_cond_t progress;   // a task finished, the main thread waits on it
+    pthread_cond_t work;       // more tasks, or the main thread is done, idle workers wait on it
+    struct timespec deadline;  // CLOCK_MONOTONIC, tv_sec 0 for no deadline
+    char* path;
+    scan_batch* batches;
+    size_t num_batches;
+    size_t next_stat;          // next batch to stat
+    size_t next_list;          // next batch to list, once listing
+    bool listing;              // the main thread wants the listings, not just the key
+    bool abandoned;            // the main thread is done with the scan, no more tasks get taken
+    size_t num_workers;
+    size_t refs;               // the main thread and every worker still running, the last one frees the scan
+};
+
+static void* worker_main(void* arg);
+static bool run_task(path_scan* s);
+static bool wait_for(path_scan* s, const bool* done);
+static void release(path_scan* s);
+static void stat_batch(scan_batch* b);
+static void list_batch(scan_batch* b);
+static int compare_names(const void* a, const void* b);
+
+/// @brief start stat'ing every PATH directory in the background
+/// @param timeout_ms for the whole scan, 0 for none
+/// @return the scan, path_scan_finish() it once done
+path_scan* path_scan_start(const char* path, int timeout_ms) {
+    path_scan* s = calloc(1, sizeof(path_scan));
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC); // timed waits against the monotonic deadline
+    pthread_cond_init(&s->progress, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    pthread_cond_init(&s->work, NULL);
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &s->deadline);
+        s->deadline.tv_sec += timeout_ms / 1000;
+        s->deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+        if (s->deadline.tv_nsec >= 1000000000) {
+            s->deadline.tv_sec += 1;
+            s->deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    s->path = strdup(path ? path : "");
+    char* path_copy = strdup(s->path);
+    for (char* dir = strtok(path_copy, ":"); dir; dir = strtok(NULL, ":")) {
+        s->batches = realloc(s->batches, (s->num_batches + 1) * sizeof(scan_batch));
+        scan_batch* b = &s->batches[s->num_batches++];
+        memset(b, 0, sizeof(scan_batch));
+        b->dir = strdup(dir);
+        b->mtime[0] = b->mtime[1] = -1;
+        arena_init(&b->names);
+    }
+    free(path_copy);
+
+    size_t num_threads = s->num_batches < PATH_SCAN_MAX_THREADS ? s->num_batches : PATH_SCAN_MAX_THREADS;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED); // never joined, see release()
+    s->refs = 1;
+    pthread_mutex_lock(&s->lock);
+    for (size_t i = 0; i < num_threads; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, worker_main, s)) break; // fewer workers, or none and the main thread does it all
+        ++s->num_workers;
+        ++s->refs;
+    }
+    pthread_mutex_unlock(&s->lock);
+    pthread_attr_destroy(&attr);
+    return s;
+}
+
+/// @brief the executable index key for the PATH, from the workers' stat()s, see exe_index_key()
+/// * a directory that doesn't answer before the deadline counts as missing, which can only make the key stale
+/// @return malloc'd key, MUST BE FREE'D BY CALLER
+char* path_scan_index_key(path_scan* s, size_t* key_len) {
+    int64_t* mtimes = malloc((s->num_batches + 1) * 2 * sizeof(int64_t));
+    pthread_mutex_lock(&s->lock);
+    for (size_t i = 0; i < s->num_batches; ++i) {
+        bool done = wait_for(s, &s->batches[i].stat_done);
+        mtimes[2 * i] = done ? s->batches[i].mtime[0] : -1;
+        mtimes[2 * i + 1] = done ? s->batches[i].mtime[1] : -1;
+    }
+    pthread_mutex_unlock(&s->lock);
+    char* key = exe_index_key_mtimes(s->path, mtimes, key_len);
+    free(mtimes);
+    return key;
+}
+
+/// @brief list every directory and insert the names into root, in PATH order as each one is ready
+/// @return false if a directory was left out for missing the deadline or only partly read
+bool path_scan_merge(path_scan* s, trie* root) {
+    bool complete = true;
+    pthread_mutex_lock(&s->lock);
+    s->listing = true;
+    pthread_cond_broadcast(&s->work);
+    for (size_t i = 0; i < s->num_batches; ++i) {
+        scan_batch* b = &s->batches[i];
+        if (!wait_for(s, &b->list_done)) { // * the ones after it that are ready still go in
+            complete = false;
+            continue;
+        }
+        if (b->list_failed) complete = false; // * what was read still goes in, the watcher's rescan finds the rest
+        pthread_mutex_unlock(&s->lock); // a listed batch is never touched by a worker again
+        for (size_t k = 0; k < b->len; ++k) {
+            trie_insert(root, b->list[k]);
+        }
+        pthread_mutex_lock(&s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return complete;
+}
+
+/// @brief the main thread is done with the scan, workers still busy are left to finish and free it
+void path_scan_finish(path_scan* s) {
+    pthread_mutex_lock(&s->lock);
+    s->abandoned = true;
+    pthread_cond_broadcast(&s->work);
+    release(s);
+}
+
+/// @brief $CSHELL_PATH_TIMEOUT_MS if it is a number, 0 waits as long as it takes, PATH_SCAN_DEFAULT_TIMEOUT_MS otherwise
+int path_scan_timeout_setting(void) {
+    const char* ms = getenv("CSHELL_PATH_TIMEOUT_MS");
+    char* end = NULL;
+    long n = ms ? strtol(ms, &end, 10) : -1;
+    return (ms && *ms && *end == '\0' && n >= 0 && n <= INT_MAX) ? (int) n : PATH_SCAN_DEFAULT_TIMEOUT_MS;
+}
+
+static void* worker_main(void* arg) {
+    path_scan* s = arg;
+    // signals are for the shell's main thread
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    pthread_mutex_lock(&s->lock);
+    while (!s->abandoned) {
+        if (run_task(s)) continue;
+        if (s->listing) break; // every directory has been taken
+        pthread_cond_wait(&s->work, &s->lock); // stat'd everything, the main thread decides if listings are needed
+    }
+    release(s);
+    return NULL;
+}
+
+/// @brief take the next task and run it, called and returns with the lock held
+/// @return false if there is none right now
+static bool run_task(path_scan* s) {
+    scan_batch* b = NULL;
+    bool stat_task = s->next_stat < s->num_batches;
+    if (stat_task) {
+        b = &s->batches[s->next_stat++];
+    } else if (s->listing && s->next_list < s->num_batches) {
+        b = &s->batches[s->next_list++];
+    } else {
+        return false;
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (stat_task) {
+        stat_batch(b);
+    } else {
+        list_batch(b);
+    }
+    pthread_mutex_lock(&s->lock);
+    if (stat_task) {
+        b->stat_done = true;
+    } else {
+        b->list_done = true;
+    }
+    pthread_cond_broadcast(&s->progress);
+    return true;
+}
+
+/// @brief wait with the lock held until done is set or the deadline passes
+/// * with no workers at all the main thread runs the tasks itself, and the deadline can't help
+/// @return done
+static bool wait_for(path_scan* s, const bool* done) {
+    while (!*done) {
+        if (s->num_workers == 0) {
+            if (!run_task(s)) break;
+        } else if (s->deadline.tv_sec == 0) {
+            pthread_cond_wait(&s->progress, &s->lock);
+        } else if (pthread_cond_timedwait(&s->progress, &s->lock, &s->deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    return *done;
+}
+
+/// @brief drop one reference, called with the lock held, which it releases
+static void release(path_scan* s) {
+    bool last = --s->refs == 0;
+    pthread_mutex_unlock(&s->lock);
+    if (!last) return;
+
+    for (size_t i = 0; i < s->num_batches; ++i) {
+        free(s->batches[i].dir);
+        free(s->batches[i].list);
+        arena_free(&s->batches[i].names);
+    }
+    free(s->batches);
+    free(s->path);
+    pthread_cond_destroy(&s->progress);
+    pthread_cond_destroy(&s->work);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+}
+
+static void stat_batch(scan_batch* b) {
+    struct stat st;
+    if (stat(b->dir, &st) == 0) {
+        b->mtime[0] = st.st_mtim.tv_sec;
+        b->mtime[1] = st.st_mtim.tv_nsec;
+    }
+}
+
+static void list_batch(scan_batch* b) {
+    dir_reader dir;
+    if (dir_reader_open(&dir, b->dir)) { // missing, unreadable or not a directory at all is just empty
+        b->list_failed = errno != ENOENT && errno != ENOTDIR && errno != EACCES;
+        return;
+    }
+
+    dir_ent* ent;
+    while ((ent = dir_reader_next(&dir))) {
+        if (ent->d_type == DT_DIR) continue; // * d_type saves a stat() for the common case, unknown types still go in
+        if (b->len == b->cap) {
+            b->cap = b->cap ? b->cap * 2 : INIT_BATCH_CAP;
+            b->list = realloc(b->list, b->cap * sizeof(char*));
+        }
+        b->list[b->len++] = arena_strndup(&b->names, ent->d_name, strlen(ent->d_name));
+    }
+    b->list_failed = dir_reader_error(&dir) != 0;
+    dir_reader_close(&dir);
+    if (b->len) qsort(b->list, b->len, sizeof(char*), compare_names);
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
@@ -0,0 +1,21 @@
+#ifndef PATHSCAN_H
+#define PATHSCAN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "prefixTree.h"
+
+#define PATH_SCAN_MAX_THREADS 8            // directories read at once, the work is waiting on the filesystem, not the cpu
+#define PATH_SCAN_DEFAULT_TIMEOUT_MS 2000 // startup never waits on PATH longer than this, $CSHELL_PATH_TIMEOUT_MS overrides
+
+// the PATH directories of one startup, stat'd and then listed by a pool of worker threads
+typedef struct path_scan path_scan;
+
+path_scan* path_scan_start(const char* path, int timeout_ms);
+char* path_scan_index_key(path_scan* s, size_t* key_len);
+bool  path_scan_merge(path_scan* s, trie* root);
+void  path_scan_finish(path_scan* s);
+int   path_scan_timeout_setting(void);
+
+#endif
@@ -0,0 +1,449 @@
+/*
+Background refresh of the executable completion trie.
+
+A worker thread watches every PATH directory with inotify. When one changes (or PATH itself is exported),
+only the affected directories are rescanned, a fresh trie is built from the per-directory listings and
+handed over through a single atomic pointer. A directory that doesn't exist (yet, like ~/.local/bin before
+the first `pip install --user`) or was deleted has its nearest existing parent watched instead, so it is
+watched and scanned as soon as it's created. The readline thread picks it up with path_watcher_poll()
+at the start of a completion and frees the tree it replaced, so it never waits on the worker and never
+sees a half built tree.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <errno.h>
+
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+
+#include "pathWatcher.h"
+#include "exeIndex.h"
+#include "dirReader.h"
+#include "redirect.h"
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define PARENT_MASK (IN_CREATE | IN_MOVED_TO | IN_ONLYDIR | IN_MASK_ADD) // added to whatever else watches it
+#define INIT_LISTING_CAP 64
+
+typedef struct watched_dir watched_dir;
+struct watched_dir {
+    char* dir;
+    int wd;        // inotify watch descriptor, -1 if the directory could not be watched
+    int parent_wd; // while wd is -1, the watch on the nearest parent that exists, -1 if none
+    bool scanned;  // list holds the directory contents as of the last scan
+    bool dirty;    // changed since then
+    arena names;   // the NUL terminated names that list points to
+    char** list;
+    size_t len;
+    size_t cap;
+};
+
+static pthread_t worker;
+static bool worker_running = false;
+static int inotify_fd = -1;
+static int wake_fd = -1; // eventfd, wakes the worker for a PATH change or shutdown
+
+static pthread_mutex_t path_lock = PTHREAD_MUTEX_INITIALIZER;
+static char* new_path = NULL; // guarded by path_lock
+static atomic_bool stop_requested = false;
+static _Atomic(trie*) pending = NULL; // built by the worker, not yet picked up by the readline thread
+
+// everything below is only touched by the worker thread
+static watched_dir* dirs = NULL;
+static size_t num_dirs = 0;
+static time_t initial_built_at = 0;
+
+static void* worker_main(void* arg);
+static void watch_path(const char* path, time_t built_at);
+static void free_dir(watched_dir* d);
+static bool rewatch(watched_dir* d);
+static void drop_watch(int wd);
+static bool watch_lost(int wd);
+static bool scan_dir(watched_dir* d);
+static bool drain_events(void);
+static bool rebuild(void);
+static long elapsed_ms(struct timespec* since);
+
+/// @brief start watching the directories of path in the background
+/// @param path PATH the current executable trie was built from
+/// @param built_at when that build started, directories modified since are rescanned straight away
+void path_watcher_start(const char* path, time_t built_at) {
+    if (worker_running) return;
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd == -1 || wake_fd == -1) {
+        perror("path watcher");
+        if (inotify_fd != -1) close(inotify_fd);
+        if (wake_fd != -1) close(wake_fd);
+        inotify_fd = wake_fd = -1;
+        return; // completion still works, it just won't notice PATH changes
+    }
+    inotify_fd = redirect_fd_high(inotify_fd);
+    wake_fd = redirect_fd_high(wake_fd);
+
+    new_path = strdup(path ? path : "");
+    initial_built_at = built_at;
+    atomic_store(&stop_requested, false);
+    if (pthread_create(&worker, NULL, worker_main, NULL)) {
+        perror("pthread_create");
+        free(new_path);
+        new_path = NULL;
+        close(inotify_fd);
+        close(wake_fd);
+        inotify_fd = wake_fd = -1;
+        return; // same as without inotify
+    }
+    worker_running = true;
+}
+
+/// @brief tell the worker PATH was reassigned, e.g. by `export PATH=...`
+void path_watcher_path_changed(const char* path) {
+    if (!worker_running) return;
+
+    pthread_mutex_lock(&path_lock);
+    free(new_path);
+    new_path = strdup(path ? path : "");
+    pthread_mutex_unlock(&path_lock);
+
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) == -1) {
+        perror("path watcher wake");
+    }
+}
+
+/// @brief non blocking, called from the readline thread
+/// @return a newly built executable trie that the caller now owns, or NULL if nothing changed
+trie* path_watcher_poll(void) {
+    if (!worker_running) return NULL;
+    return atomic_exchange(&pending, NULL);
+}
+
+void path_watcher_stop(void) {
+    if (!worker_running) return;
+
+    atomic_store(&stop_requested, true);
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) == -1) {
+        perror("path watcher wake");
+    }
+    pthread_join(worker, NULL);
+    worker_running = false;
+
+    for (size_t i = 0; i < num_dirs; ++i) {
+        free_dir(&dirs[i]);
+    }
+    free(dirs);
+    dirs = NULL;
+    num_dirs = 0;
+    free(new_path);
+    new_path = NULL;
+    trie_free(atomic_exchange(&pending, NULL));
+    close(inotify_fd);
+    close(wake_fd);
+    inotify_fd = wake_fd = -1;
+}
+
+static void* worker_main(void* arg) {
+    (void) arg;
+    // signals are for the shell's main thread
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    pthread_mutex_lock(&path_lock);
+    char* path = new_path;
+    new_path = NULL;
+    pthread_mutex_unlock(&path_lock);
+    watch_path(path, initial_built_at);
+    free(path);
+
+    bool need_rebuild = false;
+    for (size_t i = 0; i < num_dirs; ++i) {
+        need_rebuild |= dirs[i].dirty;
+    }
+
+    struct pollfd fds[2] = {{.fd = wake_fd, .events = POLLIN}, {.fd = inotify_fd, .events = POLLIN}};
+    int timeout = -1;
+    while (!atomic_load(&stop_requested)) {
+        if (need_rebuild) {
+            timeout = rebuild() ? -1 : WATCH_RETRY_MS;
+            need_rebuild = false;
+        }
+        int ready = poll(fds, 2, timeout);
+        if (ready == 0) { // a directory failed to read last time, no event may ever come to try again
+            need_rebuild = true;
+            continue;
+        }
+        if (ready == -1) continue; // EINTR
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(wake_fd, &count, sizeof(count)) == -1) {
+                // already drained
+            }
+            pthread_mutex_lock(&path_lock);
+            path = new_path;
+            new_path = NULL;
+            pthread_mutex_unlock(&path_lock);
+            if (path) {
+                watch_path(path, 0);
+                free(path);
+                need_rebuild = true;
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            need_rebuild |= drain_events();
+            // debounce, an install touches a directory many times in a row
+            struct timespec first;
+            clock_gettime(CLOCK_MONOTONIC, &first);
+            while (!atomic_load(&stop_requested) && elapsed_ms(&first) < WATCH_MAX_DELAY_MS) {
+                struct pollfd quiet = {.fd = inotify_fd, .events = POLLIN};
+                if (poll(&quiet, 1, WATCH_DEBOUNCE_MS) <= 0) break;
+                need_rebuild |= drain_events();
+            }
+        }
+    }
+    return NULL;
+}
+
+static long elapsed_ms(struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/// @brief switch the watched set to the directories of path, listings of directories that stay in PATH are kept
+/// @param built_at directories not modified since then are assumed to match the current trie, 0 to rescan everything
+static void watch_path(const char* path, time_t built_at) {
+    watched_dir* next = NULL;
+    size_t next_len = 0;
+
+    char* path_copy = strdup(path);
+    for (char* dir = strtok(path_copy, ":"); dir; dir = strtok(NULL, ":")) {
+        next = realloc(next, sizeof(watched_dir) * (next_len + 1));
+        watched_dir* d = &next[next_len++];
+
+        size_t old = 0;
+        while (old < num_dirs && (dirs[old].dir == NULL || strcmp(dirs[old].dir, dir))) {
+            ++old;
+        }
+        if (old < num_dirs) {
+            *d = dirs[old];
+            dirs[old].dir = NULL; // moved, don't free below
+            continue;
+        }
+        memset(d, 0, sizeof(watched_dir));
+        d->dir = strdup(dir);
+        d->wd = d->parent_wd = -1;
+        rewatch(d); // * or its parent, if it doesn't exist
+        arena_init(&d->names);
+
+        struct stat st;
+        d->dirty = (built_at == 0) || (stat(dir, &st) == 0 && st.st_mtim.tv_sec >= built_at);
+    }
+    free(path_copy);
+
+    watched_dir* old = dirs;
+    size_t old_len = num_dirs;
+    dirs = next;
+    num_dirs = next_len;
+    for (size_t i = 0; i < old_len; ++i) {
+        if (old[i].dir) {
+            drop_watch(old[i].wd);
+            drop_watch(old[i].parent_wd);
+            free_dir(&old[i]);
+        }
+    }
+    free(old);
+}
+
+static void free_dir(watched_dir* d) {
+    free(d->dir);
+    free(d->list);
+    arena_free(&d->names);
+}
+
+/// @brief watch d again if it has no watch, or else the nearest parent that exists, for d being created
+/// @return true if d is watched again, it's dirty then, whatever it holds now was never seen
+static bool rewatch(watched_dir* d) {
+    if (d->wd != -1) return false;
+    d->wd = inotify_add_watch(inotify_fd, d->dir, WATCH_MASK);
+    if (d->wd != -1) {
+        int parent_wd = d->parent_wd;
+        d->parent_wd = -1;
+        drop_watch(parent_wd);
+        d->dirty = true;
+        return true;
+    }
+
+    char parent[PATH_MAX];
+    size_t len = strlen(d->dir);
+    if (len >= sizeof(parent)) return false;
+    memcpy(parent, d->dir, len + 1);
+    int wd = -1;
+    while (wd == -1) {
+        char* slash = strrchr(parent, '/');
+        if (slash == NULL) { // relative, like PATH=bin
+            wd = inotify_add_watch(inotify_fd, ".", PARENT_MASK);
+            break;
+        }
+        slash[slash == parent] = '\0'; // keep the root's '/'
+        wd = inotify_add_watch(inotify_fd, parent, PARENT_MASK);
+        if (slash == parent) break;
+    }
+    if (wd != d->parent_wd) { // * a parent created meanwhile is closer, the old one can go
+        int parent_wd = d->parent_wd;
+        d->parent_wd = wd;
+        drop_watch(parent_wd);
+    }
+    return false;
+}
+
+/// @brief remove watch wd unless another PATH directory still uses it, inotify hands out one wd per inode
+static void drop_watch(int wd) {
+    if (wd == -1) return;
+    for (size_t i = 0; i < num_dirs; ++i) {
+        if (dirs[i].wd == wd || dirs[i].parent_wd == wd) return;
+    }
+    inotify_rm_watch(inotify_fd, wd);
+}
+
+/// @brief watch wd is gone, the directories it was for wait for their PATH entries to be (re)created
+/// @return true if any of them changed
+static bool watch_lost(int wd) {
+    bool changed = false;
+    for (size_t i = 0; i < num_dirs; ++i) {
+        if (dirs[i].wd == wd) { // the directory went away or was renamed, wait for it on its parent
+            dirs[i].wd = -1;
+            dirs[i].dirty = true;
+            rewatch(&dirs[i]);
+            changed = true;
+        } else if (dirs[i].parent_wd == wd) { // the parent went too, rewatch() finds another
+            dirs[i].parent_wd = -1;
+            changed |= rewatch(&dirs[i]);
+        }
+    }
+    return changed;
+}
+
+/// @brief read every queued inotify event and mark the directories they belong to
+/// @return true if any watched directory changed
+static bool drain_events(void) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t len;
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char* ptr = buf; ptr < buf + len; ) {
+            struct inotify_event* ev = (struct inotify_event*) ptr;
+            ptr += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) { // events were lost (ev->wd is -1), any directory may have changed
+                for (size_t i = 0; i < num_dirs; ++i) {
+                    dirs[i].dirty = true;
+                    rewatch(&dirs[i]);
+                }
+                changed = true;
+                continue;
+            }
+            if (ev->mask & (IN_IGNORED | IN_MOVE_SELF)) {
+                // * a renamed directory keeps its watch, which would follow it away from its PATH entry
+                if (ev->mask & IN_MOVE_SELF) inotify_rm_watch(inotify_fd, ev->wd);
+                changed |= watch_lost(ev->wd);
+                continue;
+            }
+            for (size_t i = 0; i < num_dirs; ++i) {
+                if (dirs[i].wd == ev->wd) {
+                    dirs[i].dirty = true;
+                    changed = true;
+                } else if (dirs[i].parent_wd == ev->wd) { // something created in the parent, maybe the directory
+                    changed |= rewatch(&dirs[i]);
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+/// @return false if the directory couldn't be read in full (EIO, ESTALE...), it stays dirty then
+static bool scan_dir(watched_dir* d) {
+    arena_reset(&d->names);
+    d->len = 0;
+    d->scanned = true;
+    d->dirty = false;
+
+    dir_reader dir;
+    if (dir_reader_open(&dir, d->dir)) { // missing, unreadable or not a directory at all is just empty
+        d->dirty = errno != ENOENT && errno != ENOTDIR && errno != EACCES;
+        return !d->dirty;
+    }
+
+    dir_ent* ent;
+    while ((ent = dir_reader_next(&dir))) {
+        if (ent->d_type == DT_DIR) continue; // same as the startup scan in pathScan.c
+        if (d->len == d->cap) {
+            d->cap = d->cap ? d->cap * 2 : INIT_LISTING_CAP;
+            d->list = realloc(d->list, d->cap * sizeof(char*));
+        }
+        d->list[d->len++] = arena_strndup(&d->names, ent->d_name, strlen(ent->d_name));
+    }
+    d->dirty = dir_reader_error(&dir) != 0;
+    dir_reader_close(&dir);
+    return !d->dirty;
+}
+
+/// @brief rescan the changed directories, build a whole new trie, publish it and write it to the on disk index
+// * a tree missing the names of a directory that failed to read is neither, the current one is kept
+/// @return false if a directory failed to read, rebuild again later
+static bool rebuild(void) {
+    size_t path_len = 0;
+    for (size_t i = 0; i < num_dirs; ++i) {
+        path_len += strlen(dirs[i].dir) + 1;
+    }
+    char* path = calloc(path_len + 1, 1);
+    for (size_t i = 0; i < num_dirs; ++i) {
+        if (i) strcat(path, ":");
+        strcat(path, dirs[i].dir);
+    }
+    size_t key_len = 0;
+    char* key = exe_index_key(path, &key_len);
+    free(path);
+
+    for (size_t i = 0; i < num_dirs; ++i) {
+        rewatch(&dirs[i]); // in case an event for a parent was missed, a no-op for a watched directory
+    }
+
+    bool complete = true;
+    for (size_t i = 0; i < num_dirs; ++i) {
+        if (!dirs[i].scanned || dirs[i].dirty) {
+            complete &= scan_dir(&dirs[i]);
+        }
+    }
+    if (!complete) {
+        free(key);
+        return false;
+    }
+    trie* fresh = trie_create();
+    for (size_t i = 0; i < num_dirs; ++i) {
+        for (size_t k = 0; k < dirs[i].len; ++k) {
+            trie_insert(fresh, dirs[i].list[k]);
+        }
+    }
+    exe_index_save(fresh, key, key_len);
+    free(key);
+    // a tree the readline thread never picked up was never seen by it, so it can go straight away
+    trie_free(atomic_exchange(&pending, fresh));
+    return true;
+}
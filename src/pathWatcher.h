@@ -0,0 +1,17 @@
+#ifndef PATHWATCHER_H
+#define PATHWATCHER_H
+
+#include <time.h>
+
+#include "prefixTree.h"
+
+#define WATCH_DEBOUNCE_MS 100  // wait for a burst of PATH changes (package installs) to settle before rebuilding
+#define WATCH_MAX_DELAY_MS 1000 // but never hold a rebuild back longer than this
+#define WATCH_RETRY_MS 5000 // rebuild again this long after a directory failed to read
+
+void  path_watcher_start(const char* path, time_t built_at);
+void  path_watcher_path_changed(const char* path);
+trie* path_watcher_poll(void);
+void  path_watcher_stop(void);
+
+#endif
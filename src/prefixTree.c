@@ -1,123 +1,491 @@
 /*
 some of the function skeleton code taken from leetcode problem: https://leetcode.com/problems/implement-trie-prefix-tree/
+
+Nodes are path compressed (radix tree), so a PATH full of executables costs roughly one node per word
+instead of one 2kb node per character.
 */
 #define _DEFAULT_SOURCE
+#include <stddef.h>
+#include <sys/mman.h>
+
 #include "prefixTree.h"
 
+static int find_child(trie* node, unsigned char c, size_t* pos);
+static void add_child(arena* a, trie* node, trie* child, size_t pos);
+static trie* alloc_leaf(arena* a, const char* edge, size_t edge_len);
+static size_t common_prefix(const char* a, size_t a_len, const char* b);
+
 void ac_buf_push(char x, trie_type* type) {
     assert((type->autocomplete_buf_sz < AC_BUF_CAP) && type);
     type->autocomplete_buf[type->autocomplete_buf_sz++] = x;
 }
 
+void ac_buf_push_n(const char* x, size_t n, trie_type* type) {
+    assert((type->autocomplete_buf_sz + n <= AC_BUF_CAP) && type);
+    memcpy(type->autocomplete_buf + type->autocomplete_buf_sz, x, n);
+    type->autocomplete_buf_sz += n;
+}
+
 void ac_buf_pop(trie_type* type) {
     assert((type->autocomplete_buf_sz > 0) && type);
     --type->autocomplete_buf_sz;
 }
 
+void ac_buf_pop_n(size_t n, trie_type* type) {
+    assert((type->autocomplete_buf_sz >= n) && type);
+    type->autocomplete_buf_sz -= n;
+}
+
+// the root handed out by trie_create(), owns the arena every other node of the tree is allocated from
+typedef struct trie_root trie_root;
+struct trie_root {
+    trie node; // must stay first, a trie_root* is used as a trie*
+    arena arena;
+};
 
-trie* alloc_node(void) {
-    trie* node = calloc(1, sizeof(trie));
-    if (node == NULL) {
+static arena* tree_arena(trie* root) {
+    return &((trie_root*) root)->arena;
+}
+
+trie* alloc_node(arena* a) {
+    return arena_calloc(a, sizeof(trie));
+}
+
+trie* trie_create(void) {
+    trie_root* root = calloc(1, sizeof(trie_root));
+    if (root == NULL) {
         perror("calloc");
         exit(1);
     }
+    arena_init(&root->arena);
+    return &root->node;
+}
+
+static trie* alloc_leaf(arena* a, const char* edge, size_t edge_len) {
+    trie* node = alloc_node(a);
+    trie_ref_set(&node->edge, arena_strndup(a, edge, edge_len));
+    node->edge_len = edge_len;
+    node->num_words = 1;
+    node->isEnd = true;
     return node;
 }
 
-trie* trie_create(void) {
-    return alloc_node();
+/// @brief binary search the sorted keys of node for c
+/// @param pos set to the index of c, or to where c would be inserted
+/// @return 1 if found, 0 otherwise
+static int find_child(trie* node, unsigned char c, size_t* pos) {
+    if (node->num_children == 0) {
+        *pos = 0;
+        return 0;
+    }
+    unsigned char* keys = trie_keys(node);
+    size_t lo = 0;
+    size_t hi = node->num_children;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (keys[mid] < c) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *pos = lo;
+    return lo < node->num_children && keys[lo] == c;
+}
+
+/// @brief insert child at pos, keeping children sorted
+static void add_child(arena* a, trie* node, trie* child, size_t pos) {
+    trie_ref* refs = trie_child_refs(node);
+    if (node->num_children == node->cap_children) {
+        // children and keys share one block: [trie_ref x cap][unsigned char x cap]
+        size_t old_cap = node->cap_children;
+        size_t new_cap = old_cap ? old_cap * 2 : INIT_CHILDREN_CAP;
+        trie_ref* grown = arena_grow(a, refs, old_cap * (sizeof(trie_ref) + 1), new_cap * (sizeof(trie_ref) + 1));
+        memmove(grown + new_cap, grown + old_cap, old_cap); // keys move up when the ref half grows
+        if (grown != refs) {
+            // * refs are relative to their own slot, so copied ones have to be re-pointed
+            for (size_t i = 0; i < old_cap && i < node->num_children; ++i) {
+                trie_ref_set(&grown[i], trie_ref_get(&refs[i]));
+            }
+        }
+        refs = grown;
+        trie_ref_set(&node->children, refs);
+        node->cap_children = new_cap;
+    }
+    unsigned char* keys = trie_keys(node);
+    for (size_t i = node->num_children; i > pos; --i) {
+        trie_ref_set(&refs[i], trie_ref_get(&refs[i - 1]));
+        keys[i] = keys[i - 1];
+    }
+    trie_ref_set(&refs[pos], child);
+    keys[pos] = (unsigned char) trie_edge(child)[0];
+    ++node->num_children;
+}
+
+/// @brief length of the common prefix of edge a and NUL terminated b
+static size_t common_prefix(const char* a, size_t a_len, const char* b) {
+    size_t i = 0;
+    while (i < a_len && b[i] && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
 }
 
 void trie_insert(trie* root, char* word) {
-    assert(root && word);
+    assert(root && word && !(root->flags & TRIE_FROZEN));
+    // word counts along the path only change for new words
+    if (trie_search(root, word)) return;
 
+    arena* a = tree_arena(root);
     trie* currNode = root;
-    for (size_t i = 0; word[i] != '\0'; ++i) {
-        unsigned char idx = (unsigned char)word[i];
-        if (!currNode->children[idx]) {
-            currNode->children[idx] = alloc_node();
+    ++currNode->num_words;
+    while (*word) {
+        size_t pos = 0;
+        if (!find_child(currNode, (unsigned char) *word, &pos)) {
+            add_child(a, currNode, alloc_leaf(a, word, strlen(word)), pos);
+            return;
+        }
+        trie* child = trie_child(currNode, pos);
+        const char* edge = trie_edge(child);
+        size_t common = common_prefix(edge, child->edge_len, word);
+
+        if (common < child->edge_len) {
+            // split the edge: currNode -> mid ("common" bytes) -> child (the rest), both halves keep pointing into the same label bytes
+            trie* mid = alloc_node(a);
+            trie_ref_set(&mid->edge, edge);
+            mid->edge_len = common;
+            mid->num_words = child->num_words;
+
+            trie_ref_set(&child->edge, edge + common);
+            child->edge_len -= common;
+
+            add_child(a, mid, child, 0);
+            trie_ref_set(&trie_child_refs(currNode)[pos], mid); // first byte unchanged, so the key stays valid
+            child = mid;
         }
-        currNode = currNode->children[idx];
+        ++child->num_words;
+        currNode = child;
+        word += common;
     }
     currNode->isEnd = true;
 }
 
-bool trie_search(trie* root, char* word) { // left as recursive, don't think ill be using this
+bool trie_search(trie* root, char* word) {
     assert(word);
 
-    if (root == NULL) {
-        return false;
+    trie* curr = root;
+    while (curr && *word) {
+        size_t pos = 0;
+        if (!find_child(curr, (unsigned char) *word, &pos)) {
+            return false;
+        }
+        curr = trie_child(curr, pos);
+        if (common_prefix(trie_edge(curr), curr->edge_len, word) != curr->edge_len) {
+            return false;
+        }
+        word += curr->edge_len;
+    }
+    return curr && curr->isEnd;
+}
+
+/// @brief raise the value of every node on the path to word, so each subtree knows the largest value below it
+/// * word must already be in the tree
+void trie_set_value(trie* root, const char* word, uint64_t value) {
+    assert(root && word && !(root->flags & TRIE_FROZEN));
+    trie* curr = root;
+    while (1) {
+        if (curr->value < value) curr->value = value;
+        if (!*word) return;
+        size_t pos = 0;
+        if (!find_child(curr, (unsigned char) *word, &pos)) return;
+        curr = trie_child(curr, pos);
+        word += curr->edge_len;
     }
-    // if we have reached the end of the prefix, then we have found it
-    if ( *word == '\0') {
-        if (root->isEnd == true) {
-            return true;    
+}
+
+/// @brief like get_prefix_subtree() without filling a buffer, for when only the subtree's counts or value matter
+/// @return node below which every word starts with prefix, NULL if no word does
+trie* trie_find_prefix(trie* root, const char* prefix) {
+    assert(root && prefix);
+    trie* curr = root;
+    while (*prefix) {
+        size_t pos = 0;
+        if (!find_child(curr, (unsigned char) *prefix, &pos)) {
+            return NULL;
+        }
+        curr = trie_child(curr, pos);
+        size_t common = common_prefix(trie_edge(curr), curr->edge_len, prefix);
+        if (common < curr->edge_len && prefix[common] != '\0') {
+            return NULL; // diverges inside the edge
         }
-        return false;
+        prefix += common;
     }
-    return trie_search(root->children[(size_t) *word], word + 1);
+    return curr;
 }
 
 // returns sub tree, inserts prefix into buffer, which will be used when we are assembling the subtree
+// * when the prefix ends part way along an edge, the whole edge is pushed and the node below it is returned,
+// * so every word assembled from the subtree still starts with the prefix
 trie* get_prefix_subtree(trie* root, char* prefix, trie_type* type) {
     assert(root && prefix);
     trie* curr = root;
-    for (size_t i = 0; prefix[i] != '\0'; ++i) {
-        unsigned char idx = (unsigned char)prefix[i];
-        if (!curr->children[idx]) {
+    while (*prefix) {
+        size_t pos = 0;
+        if (!find_child(curr, (unsigned char) *prefix, &pos)) {
             return NULL;
         }
-        curr = curr->children[idx];
-        ac_buf_push(prefix[i], type);
+        curr = trie_child(curr, pos);
+        const char* edge = trie_edge(curr);
+        size_t common = common_prefix(edge, curr->edge_len, prefix);
+        if (common < curr->edge_len && prefix[common] != '\0') {
+            return NULL; // diverges inside the edge
+        }
+        ac_buf_push_n(edge, curr->edge_len, type);
+        prefix += common;
     }
     return curr;
 }
 
 void push_word(char*** words, size_t* count, size_t* cap, trie_type* type) {
     assert(count && cap && type);
-    // resize array
+    // resize array, assemble_trie sizes it from num_words so this only happens for callers that don't
     if (*count >= *cap) {
-        *cap = (*cap == 0) ? INIT_MATCHES_BUF_SIZE : (*cap) * 2; 
-        *words = realloc(*words, (*cap) * sizeof(char*));
+        size_t new_cap = (*cap == 0) ? INIT_MATCHES_BUF_SIZE : (*cap) * 2;
+        *words = type->scratch ? arena_grow(type->scratch, *words, (*cap) * sizeof(char*), new_cap * sizeof(char*))
+                               : realloc(*words, new_cap * sizeof(char*));
+        *cap = new_cap;
     }
     // * remember "*" has operator precendence, so you must inclose what you want dereferenced with brackets, took forever to debug
-    (*words)[(*count)++] = strndup(type->autocomplete_buf, type->autocomplete_buf_sz); // *strndup adds null terminator
+    (*words)[(*count)++] = type->scratch ? arena_strndup(type->scratch, type->autocomplete_buf, type->autocomplete_buf_sz)
+                                         : strndup(type->autocomplete_buf, type->autocomplete_buf_sz); // *strndup adds null terminator
 }
 
 void _assemble_trie_helper(trie* root, char*** words, size_t* count, size_t* cap, trie_type* type) {
     if (root->isEnd) {
         push_word(words, count, cap, type);
     }
-    // DFS search all the nodes
-    for (size_t i = 0; i < ARRAY_LEN(root->children); ++i) {
-        if (root->children[i] != NULL) {
-            ac_buf_push((char) i, type);
-            _assemble_trie_helper(root->children[i], words, count, cap, type);
-            ac_buf_pop(type);
-        }   
+    // DFS search all the nodes, children are sorted so words come out in byte order
+    for (size_t i = 0; i < root->num_children; ++i) {
+        trie* child = trie_child(root, i);
+        ac_buf_push_n(trie_edge(child), child->edge_len, type);
+        _assemble_trie_helper(child, words, count, cap, type);
+        ac_buf_pop_n(child->edge_len, type);
     }
 }
 
+/// @brief collect every word below root
+/// @return NULL terminated array, from type->scratch if set (dropped with the arena), otherwise malloc'd array of malloc'd strings
 char** assemble_trie(trie* root, trie_type* type) {
     assert(root);
-    char** words = NULL;
     size_t count = 0;
-    size_t cap = 0;
+    size_t cap = root->num_words + 1; // +1 for the NULL sentinel
+    char** words = type->scratch ? arena_alloc(type->scratch, cap * sizeof(char*)) : malloc(cap * sizeof(char*));
     // populate words array of possible autocomplete matches
     _assemble_trie_helper(root, &words, &count, &cap, type);
-    // push NULL sentinel into array
-    if (count >= cap) {
-        cap = (cap == 0) ? INIT_MATCHES_BUF_SIZE : cap * 2; 
-        words = realloc(words, (cap) * sizeof(char*)); // TODO. maybe use small pointers or something
-    }
     words[count++] = NULL; //* generator function for gnu readline requires null sentinel!
-    return words; //* GNU readline will free the mallocd strings in the array here
+    return words;
+}
+
+/// @brief extend the prefix in type's buffer down the chain of single child nodes, which is the longest common prefix of every word below root
+/// @return node the common prefix ends at, a word or a branch
+trie* trie_lcp(trie* root, trie_type* type) {
+    assert(root);
+    trie* curr = root;
+    while (!curr->isEnd && curr->num_children == 1) {
+        curr = trie_child(curr, 0);
+        ac_buf_push_n(trie_edge(curr), curr->edge_len, type);
+    }
+    return curr;
+}
+
+/// @brief start iterating the words below root, type's buffer must already hold the prefix root was found with
+void trie_iter_init(trie_iter* it, trie* root, trie_type* type) {
+    assert(root && type);
+    it->type = type;
+    it->root_pending = root->isEnd;
+    it->depth = 1;
+    it->stack[0].node = root;
+    it->stack[0].next_child = 0;
+}
+
+/// @brief advance to the next word, same DFS order as assemble_trie but nothing is allocated
+/// @return true with the word in it->type->autocomplete_buf, false once every word was returned
+bool trie_iter_next(trie_iter* it) {
+    if (it->root_pending) {
+        it->root_pending = false;
+        return true;
+    }
+    while (it->depth > 0) {
+        trie* node = it->stack[it->depth - 1].node;
+        if (it->stack[it->depth - 1].next_child < node->num_children) {
+            trie* child = trie_child(node, it->stack[it->depth - 1].next_child++);
+            ac_buf_push_n(trie_edge(child), child->edge_len, it->type);
+            assert(it->depth < AC_BUF_CAP);
+            it->stack[it->depth].node = child;
+            it->stack[it->depth].next_child = 0;
+            ++it->depth;
+            if (child->isEnd) return true;
+        } else {
+            if (--it->depth > 0) ac_buf_pop_n(node->edge_len, it->type); // leave the root's prefix in the buffer
+        }
+    }
+    return false;
+}
+
+/// @brief bytes the tree holds on to, used by the benchmarks
+size_t trie_mem_usage(trie* root) {
+    if (!root) return 0;
+    if (root->flags & TRIE_FROZEN) {
+        return ((trie_image*) root - 1)->size;
+    }
+    return sizeof(trie_root) + tree_arena(root)->bytes;
+}
+
+// growable byte buffer the frozen image is laid out in, everything is addressed by offset since it moves
+typedef struct image_buf image_buf;
+struct image_buf {
+    char* data;
+    size_t len;
+    size_t cap;
+};
+
+static size_t image_alloc(image_buf* buf, size_t size) {
+    size_t off = (buf->len + 7) & ~(size_t) 7;
+    if (off + size > buf->cap) {
+        while (off + size > buf->cap) {
+            buf->cap = buf->cap ? buf->cap * 2 : 4096;
+        }
+        buf->data = realloc(buf->data, buf->cap);
+        if (buf->data == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memset(buf->data + buf->len, 0, off + size - buf->len);
+    buf->len = off + size;
+    return off;
+}
+
+static void image_set_ref(image_buf* buf, size_t ref_off, size_t target_off) {
+    *(trie_ref*) (buf->data + ref_off) = (trie_ref) target_off - (trie_ref) ref_off;
+}
+
+/// @brief copy node and its subtree depth first, so every subtree ends up in one contiguous run
+static size_t freeze_node(image_buf* buf, trie* node) {
+    size_t node_off = image_alloc(buf, sizeof(trie));
+    size_t edge_off = image_alloc(buf, node->edge_len);
+    memcpy(buf->data + edge_off, trie_edge(node), node->edge_len);
+    size_t n = node->num_children;
+    size_t refs_off = n ? image_alloc(buf, n * (sizeof(trie_ref) + 1)) : 0;
+    if (n) {
+        memcpy(buf->data + refs_off + n * sizeof(trie_ref), trie_keys(node), n);
+    }
+
+    trie* copy = (trie*) (buf->data + node_off);
+    copy->edge_len = node->edge_len;
+    copy->num_words = node->num_words;
+    copy->value = node->value;
+    copy->num_children = copy->cap_children = n; // no spare capacity, nothing is inserted into an image
+    copy->isEnd = node->isEnd;
+    image_set_ref(buf, node_off + offsetof(trie, edge), edge_off);
+    if (n) {
+        image_set_ref(buf, node_off + offsetof(trie, children), refs_off);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t child_off = freeze_node(buf, trie_child(node, i)); // may move buf->data
+        image_set_ref(buf, refs_off + i * sizeof(trie_ref), child_off);
+    }
+    return node_off;
+}
+
+/// @brief 64 bit hash of an image's bytes, checked on every startup that maps the executable index
+// * four independent lanes of 8 bytes, so the multiplies overlap instead of waiting on each other
+static uint64_t image_checksum(const char* data, size_t len) {
+    const uint64_t k = 0x9e3779b97f4a7c15ull;
+    uint64_t lanes[4] = {len, len ^ k, len + k, ~len};
+    size_t i = 0;
+    for (; i + sizeof(lanes) <= len; i += sizeof(lanes)) {
+        uint64_t words[4];
+        memcpy(words, data + i, sizeof(words));
+        for (int l = 0; l < 4; ++l) {
+            lanes[l] = (lanes[l] ^ words[l]) * k;
+            lanes[l] ^= lanes[l] >> 29;
+        }
+    }
+    uint64_t hash = 14695981039346656037ull;
+    for (int l = 0; l < 4; ++l) {
+        hash = (hash ^ lanes[l]) * 1099511628211ull;
+    }
+    for (; i < len; ++i) {
+        hash = (hash ^ (unsigned char) data[i]) * 1099511628211ull;
+    }
+    return hash ^ (hash >> 32);
+}
+
+/// @brief lay the whole tree out in one position independent block, ready to be written to disk and mapped back with trie_map_image()
+/// @param user caller bytes stored alongside the tree, e.g. a cache key
+/// @return malloc'd image, image->size bytes long, MUST BE FREE'D BY CALLER
+trie_image* trie_freeze(trie* root, const void* user, size_t user_size) {
+    assert(root);
+    image_buf buf = {0};
+    image_alloc(&buf, sizeof(trie_image));
+    size_t root_off = freeze_node(&buf, root);
+    assert(root_off == sizeof(trie_image)); // trie_free() finds the header right before the root
+    size_t user_off = image_alloc(&buf, user_size);
+    memcpy(buf.data + user_off, user, user_size);
+
+    ((trie*) (buf.data + root_off))->flags = TRIE_FROZEN;
+
+    trie_image* image = (trie_image*) buf.data;
+    memcpy(image->magic, TRIE_IMAGE_MAGIC, sizeof(image->magic));
+    image->version = TRIE_IMAGE_VERSION;
+    image->node_size = sizeof(trie);
+    image->size = buf.len;
+    image->user = user_off;
+    image->user_size = user_size;
+    image->checksum = image_checksum(buf.data + sizeof(trie_image), buf.len - sizeof(trie_image));
+    return image;
+}
+
+/// @brief use an mmap'd image as a read only tree, it is walked in place and never copied
+/// @param image start of the mapping, it gets munmap'd by trie_free()
+/// @param size length of the mapping
+/// @return root of the tree, NULL if the image is malformed, truncated, corrupted or from a build with another layout
+// * the refs inside are followed unchecked from then on, the checksum is what vouches for them
+trie* trie_map_image(void* image, size_t size) {
+    trie_image* header = image;
+    if (size < sizeof(trie_image) + sizeof(trie) || memcmp(header->magic, TRIE_IMAGE_MAGIC, sizeof(header->magic)) ||
+        header->version != TRIE_IMAGE_VERSION || header->node_size != sizeof(trie) ||
+        header->size != size || header->user > size || header->user_size > size - header->user) {
+        return NULL;
+    }
+    if (header->checksum != image_checksum((char*) image + sizeof(trie_image), size - sizeof(trie_image))) {
+        return NULL;
+    }
+    trie* root = (trie*) (header + 1);
+    if (!(root->flags & TRIE_FROZEN)) {
+        return NULL;
+    }
+    return root;
+}
+
+/// @brief caller bytes stored by trie_freeze()
+const void* trie_image_user(trie* root, size_t* user_size) {
+    assert(root->flags & TRIE_FROZEN);
+    trie_image* header = (trie_image*) root - 1;
+    *user_size = header->user_size;
+    return (char*) header + header->user;
 }
 
+/// @brief frees the whole tree at once, root must come from trie_create() or trie_map_image()
 void trie_free(trie* root) {
     if (!root) return;
-    for (int i = 0; i < 256; ++i) {
-        trie_free(root->children[i]);
+    if (root->flags & TRIE_FROZEN) {
+        trie_image* header = (trie_image*) root - 1;
+        munmap(header, header->size);
+        return;
     }
+    arena_free(tree_arena(root));
     free(root);
 }
@@ -1,41 +1,130 @@
 #ifndef PREFIXTREE_H
 #define PREFIXTREE_H
 
-#include <stdbool.h> 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
+
 #define ARRAY_LEN(x) ((sizeof(x)) / (sizeof((x)[0])))
 #define AC_BUF_CAP 1024 // 1kb max word length
 #define INIT_MATCHES_BUF_SIZE 4 // trie should be small
+#define INIT_CHILDREN_CAP 2 // most radix nodes only branch a couple of ways
+
+// radix tree (path compressed trie): every node owns the label of the edge leading into it,
+// and a single child chain with no words along it is collapsed into one edge.
+// children are kept sorted by the first byte of their edge, with those bytes mirrored in a keys array
+// so finding a child only touches one small contiguous array.
+// * every node, edge and child array lives in an arena owned by the root returned from trie_create(),
+// * so trie_insert()/trie_free() must be given that root
+// * links are self-relative offsets (trie_ref) instead of pointers, so a tree copied into one block by
+// * trie_freeze() stays valid wherever that block is mapped, and the same lookup code walks both
+typedef int64_t trie_ref; // target address minus the address of the ref itself, 0 for none
 
 typedef struct trie trie;
 struct trie {
-    trie* children[256];
+    trie_ref edge;        // edge label, not NUL terminated
+    trie_ref children;    // cap_children child refs, immediately followed by cap_children keys
+    uint32_t edge_len;
+    uint32_t num_words;   // words in this subtree, lets assemble_trie size its array up front
+    uint64_t value;       // largest value trie_set_value() gave a word in this subtree, 0 if none
+    uint16_t num_children;
+    uint16_t cap_children;
     bool isEnd;
+    uint8_t flags;
 };
 
+#define TRIE_FROZEN 0x1 // root of a read only image from trie_map_image()
+
+#define TRIE_IMAGE_MAGIC "CSHTRIE2"
+#define TRIE_IMAGE_VERSION 3 // bump whenever struct trie, trie_image or the way freeze_node() lays nodes out changes
+
+// header of a frozen tree, the root node follows it directly, caller data (user bytes) follows the tree
+// * images come from a cache directory, so trie_map_image() rejects one from another layout or with any byte off
+typedef struct trie_image trie_image;
+struct trie_image {
+    char magic[8];
+    uint32_t version;   // TRIE_IMAGE_VERSION of the build that wrote it
+    uint32_t node_size; // and its sizeof(trie)
+    uint64_t size;      // bytes in the whole image, header included
+    uint64_t user;      // offset of the caller data
+    uint64_t user_size;
+    uint64_t checksum;  // of every byte after the header, see image_checksum()
+};
+
+static inline void* trie_ref_get(const trie_ref* ref) {
+    return *ref ? (void*) ((intptr_t) ref + *ref) : NULL;
+}
+
+static inline void trie_ref_set(trie_ref* ref, const void* target) {
+    *ref = target ? (trie_ref) ((intptr_t) target - (intptr_t) ref) : 0;
+}
+
+static inline const char* trie_edge(trie* node) {
+    return trie_ref_get(&node->edge);
+}
+
+static inline trie_ref* trie_child_refs(trie* node) {
+    return trie_ref_get(&node->children);
+}
+
+static inline unsigned char* trie_keys(trie* node) {
+    return (unsigned char*) (trie_child_refs(node) + node->cap_children);
+}
+
+static inline trie* trie_child(trie* node, size_t i) {
+    return trie_ref_get(&trie_child_refs(node)[i]);
+}
+
 // there could be multiple Tries, one for builtins, one for executables
+// * when scratch is set, assemble_trie allocates the match array and strings from it instead of malloc
 typedef struct trie_type trie_type;
 struct trie_type {
     char autocomplete_buf[AC_BUF_CAP];
     size_t autocomplete_buf_sz;
+    arena* scratch;
+};
+
+// walks the words below a subtree one at a time in byte order, each word is left in type's autocomplete_buf
+// * depth is bounded by AC_BUF_CAP since every edge below the root is at least one byte
+typedef struct trie_iter trie_iter;
+struct trie_iter {
+    trie_type* type;
+    bool root_pending; // the subtree root itself is a word that hasn't been returned yet
+    size_t depth;
+    struct {
+        trie* node;
+        uint32_t next_child;
+    } stack[AC_BUF_CAP];
 };
 
 // insert into dynamic array of words, helper to assemble_trie
 void push_word(char*** words, size_t* count, size_t* cap, trie_type* type);
 void ac_buf_push(char x, trie_type* type);
+void ac_buf_push_n(const char* x, size_t n, trie_type* type);
 void ac_buf_pop(trie_type* type);
+void ac_buf_pop_n(size_t n, trie_type* type);
 
-trie* alloc_node(void);
+trie* alloc_node(arena* a);
 trie* trie_create(void);
 void trie_insert(trie* root, char* word);
 bool trie_search(trie* root, char* word);
+void trie_set_value(trie* root, const char* word, uint64_t value);
+trie* trie_find_prefix(trie* root, const char* prefix);
 trie* get_prefix_subtree(trie* root, char* prefix, trie_type* type);
 void _assemble_trie_helper(trie* root, char*** words, size_t* count, size_t* cap, trie_type* type);
 char** assemble_trie(trie* root, trie_type* type);
+trie* trie_lcp(trie* root, trie_type* type);
+void trie_iter_init(trie_iter* it, trie* root, trie_type* type);
+bool trie_iter_next(trie_iter* it);
+size_t trie_mem_usage(trie* root);
+trie_image* trie_freeze(trie* root, const void* user, size_t user_size);
+trie* trie_map_image(void* image, size_t size);
+const void* trie_image_user(trie* root, size_t* user_size);
 void trie_free(trie* root);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,7 +1,45 @@
+#include <stdio.h>
+#include <poll.h>
+#include <errno.h>
+#include <readline/readline.h>
+
 #include "autocomplete.h"
 #include "history.h"
+#include "jobs.h"
+
+static int shell_getc(FILE* stream);
 
 void init_readline(void) {
     init_ac_readline();
     init_history_readline();
-}
\ No newline at end of file
+    // ^C and SIGCHLD are handled by the shell, readline only sees them through shell_getc
+    rl_getc_function = shell_getc;
+    rl_catch_signals = 0;
+}
+
+/// @brief readline's input, waits on the terminal and the job signal pipe together
+/// * background jobs are reaped as soon as they change state, and ^C at the prompt throws away the line
+/// @return next character of input, EOF at the end
+static int shell_getc(FILE* stream) {
+    struct pollfd fds[2] = {
+        {.fd = fileno(stream), .events = POLLIN},
+        {.fd = jobs_signal_fd(), .events = POLLIN},
+    };
+    while (1) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            return EOF;
+        }
+        if (fds[1].revents & POLLIN) {
+            bool interrupted = jobs_take_interrupt();
+            jobs_reap();
+            if (interrupted) {
+                rl_replace_line("", 0);
+                printf("\n");
+                rl_on_new_line();
+                rl_redisplay();
+            }
+        }
+        if (fds[0].revents) return rl_getc(stream);
+    }
+}
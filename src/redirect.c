@@ -0,0 +1,238 @@
+/*
+Redirects of one command: <, >, >>, n<&m, n>&m, n>&-, <<, <<< and &>, any number of them, anywhere among the words.
+
+Parsing takes the operators and their words out of the command and turns them into a list of launch_fd
+changes, in the order they were written since that's what `> f 2>&1` vs `2>&1 > f` depends on. Files are
+opened by the shell so a bad one is reported before anything starts, but the fd changes only ever happen
+in the child (or as posix_spawn file actions), the shell's own fds are left alone. A builtin running in the
+shell applies them itself and puts its fds back afterwards.
+
+Heredoc and here-string bodies go into a memfd, which takes any amount of text without the writer having
+to wait for the command to read it the way a pipe would.
+*/
+
+#define _GNU_SOURCE // memfd_create
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "redirect.h"
+
+heredoc_line_reader redirect_heredoc_reader = NULL;
+
+static void add_fd(redirect_list* redirs, int fd, int target, bool keep);
+static int keep_opened(redirect_list* redirs, int fd);
+static int open_file(redirect_list* redirs, const char* fname, int flags);
+static int open_text(redirect_list* redirs, const char* text, size_t len);
+static int read_heredoc(redirect_list* redirs, const char* delim, bool literal);
+static int add_redirect(redirect_list* redirs, token_kind kind, const char* op, const char* word);
+
+static void add_fd(redirect_list* redirs, int fd, int target, bool keep) {
+    if (redirs->len == redirs->cap) {
+        redirs->cap = redirs->cap ? redirs->cap * 2 : 4;
+        redirs->fds = realloc(redirs->fds, redirs->cap * sizeof(launch_fd));
+    }
+    redirs->fds[redirs->len++] = (launch_fd) {.fd = fd, .target = target, .keep = keep};
+}
+
+/// @brief move fd at or above REDIR_FD_MIN and remember to close it
+/// @return the fd to use, -1 on failure (already reported)
+static int keep_opened(redirect_list* redirs, int fd) {
+    if (fd < REDIR_FD_MIN) {
+        int high = fcntl(fd, F_DUPFD_CLOEXEC, REDIR_FD_MIN);
+        close(fd);
+        if (high == -1) {
+            perror("fcntl");
+            return -1;
+        }
+        fd = high;
+    }
+    redirs->opened = realloc(redirs->opened, (redirs->num_opened + 1) * sizeof(int));
+    redirs->opened[redirs->num_opened++] = fd;
+    return fd;
+}
+
+static int open_file(redirect_list* redirs, const char* fname, int flags) {
+    int fd = open(fname, flags | O_CLOEXEC, 0666);
+    if (fd == -1) {
+        fprintf(stderr, "%s: %s\n", fname, strerror(errno));
+        return -1;
+    }
+    return keep_opened(redirs, fd);
+}
+
+/// @brief an fd to read text from, for heredocs and here-strings
+static int open_text(redirect_list* redirs, const char* text, size_t len) {
+    int fd = memfd_create("heredoc", MFD_CLOEXEC);
+    if (fd == -1) {
+        perror("memfd_create");
+        return -1;
+    }
+    for (size_t done = 0; done < len; ) {
+        ssize_t n = write(fd, text + done, len - done);
+        if (n <= 0) {
+            perror("write");
+            close(fd);
+            return -1;
+        }
+        done += n;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return keep_opened(redirs, fd);
+}
+
+/// @brief read lines up to delim and make them an fd to read from
+/// @param literal the delimiter was quoted, so the body isn't expanded
+static int read_heredoc(redirect_list* redirs, const char* delim, bool literal) {
+    char* body = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    char* line;
+    while (1) {
+        line = redirect_heredoc_reader ? redirect_heredoc_reader() : NULL;
+        if (line == NULL) {
+            fprintf(stderr, "warning: here-document delimited by end-of-file (wanted `%s')\n", delim);
+            break;
+        }
+        if (!strcmp(line, delim)) break;
+        size_t line_len = strlen(line);
+        if (len + line_len + 2 > cap) {
+            cap = (len + line_len + 2) * 2;
+            body = realloc(body, cap);
+        }
+        memcpy(body + len, line, line_len);
+        len += line_len;
+        body[len++] = '\n';
+    }
+    if (body) body[len] = '\0';
+
+    int fd;
+    if (body && !literal) {
+        char* expanded = expand_vars(body);
+        fd = open_text(redirs, expanded, strlen(expanded));
+        free(expanded);
+    } else {
+        fd = open_text(redirs, body ? body : "", len);
+    }
+    free(body);
+    return fd;
+}
+
+/// @brief turn one redirect into fd changes
+/// @param op the operator as spelled, with its fd digit if it has one
+/// @param word the file, fd, delimiter or string after it
+/// @return 0 on success, -1 on failure (already reported)
+static int add_redirect(redirect_list* redirs, token_kind kind, const char* op, const char* word) {
+    bool has_fd = isdigit((unsigned char) op[0]);
+    int n = has_fd ? op[0] - '0' : -1;
+    int fd;
+    switch (kind) {
+    case TOK_IN:
+        if ((fd = open_file(redirs, word, O_RDONLY)) == -1) return -1;
+        add_fd(redirs, fd, has_fd ? n : STDIN_FILENO, false);
+        return 0;
+    case TOK_OUT:
+    case TOK_OUT_APPEND:
+        fd = open_file(redirs, word, O_WRONLY | O_CREAT | (kind == TOK_OUT ? O_TRUNC : O_APPEND));
+        if (fd == -1) return -1;
+        add_fd(redirs, fd, has_fd ? n : STDOUT_FILENO, false);
+        return 0;
+    case TOK_OUT_ALL:
+    case TOK_OUT_ALL_APPEND:
+        fd = open_file(redirs, word, O_WRONLY | O_CREAT | (kind == TOK_OUT_ALL ? O_TRUNC : O_APPEND));
+        if (fd == -1) return -1;
+        add_fd(redirs, fd, STDOUT_FILENO, false);
+        add_fd(redirs, STDOUT_FILENO, STDERR_FILENO, true);
+        return 0;
+    case TOK_DUP_IN:
+    case TOK_DUP_OUT: {
+        int target = has_fd ? n : kind == TOK_DUP_IN ? STDIN_FILENO : STDOUT_FILENO;
+        if (!strcmp(word, "-")) {
+            add_fd(redirs, target, -1, false);
+            return 0;
+        }
+        char* end = NULL;
+        long src = strtol(word, &end, 10);
+        if (*word == '\0' || *end) {
+            if (kind == TOK_DUP_OUT && !has_fd) return add_redirect(redirs, TOK_OUT_ALL, "&>", word); // >&file is &>file
+            fprintf(stderr, "%s: ambiguous redirect\n", word);
+            return -1;
+        }
+        // * fine if an earlier redirect of this command opens it, otherwise it has to be open in the shell and not
+        // * one of the shell's own (the history log, the SIGCHLD pipe...), those are all close-on-exec
+        bool opened_here = false;
+        for (size_t i = 0; i < redirs->len; ++i) {
+            opened_here |= redirs->fds[i].target == src;
+        }
+        int flags = src < 0 || src > INT_MAX || opened_here ? 0 : fcntl((int) src, F_GETFD);
+        if (src < 0 || src > INT_MAX || flags == -1 || (flags & FD_CLOEXEC)) {
+            fprintf(stderr, "%s: Bad file descriptor\n", word);
+            return -1;
+        }
+        add_fd(redirs, (int) src, target, true);
+        return 0;
+    }
+    case TOK_HEREDOC:
+    case TOK_HEREDOC_LITERAL:
+        if ((fd = read_heredoc(redirs, word, kind == TOK_HEREDOC_LITERAL)) == -1) return -1;
+        add_fd(redirs, fd, has_fd ? n : STDIN_FILENO, false);
+        return 0;
+    case TOK_HERESTRING: {
+        size_t len = strlen(word);
+        char* text = malloc(len + 2);
+        memcpy(text, word, len);
+        text[len] = '\n';
+        fd = open_text(redirs, text, len + 1);
+        free(text);
+        if (fd == -1) return -1;
+        add_fd(redirs, fd, has_fd ? n : STDIN_FILENO, false);
+        return 0;
+    }
+    default:
+        return -1;
+    }
+}
+
+/// @brief take the redirects out of a command
+/// @param tokens one command, or one stage of a pipeline, its argv is left with only the words
+/// @param redirs filled in, free with redirect_list_free() whatever this returns
+/// @return 0 on success, 2 for a syntax error, 1 if a file couldn't be opened (already reported either way)
+int redirect_parse(token_list* tokens, redirect_list* redirs) {
+    memset(redirs, 0, sizeof(redirect_list));
+    size_t argc = 0;
+    for (size_t i = 0; i < tokens->len; ++i) {
+        if (!token_is_redir(tokens->kinds[i])) {
+            tokens->argv[argc] = tokens->argv[i];
+            tokens->kinds[argc++] = tokens->kinds[i];
+            continue;
+        }
+        const char* word = i + 1 < tokens->len ? tokens->argv[i + 1] : NULL;
+        if (word == NULL || tokens->kinds[i + 1] != TOK_WORD) {
+            fprintf(stderr, "syntax error near unexpected token `%s'\n", word ? word : "newline");
+            return 2;
+        }
+        if (add_redirect(redirs, tokens->kinds[i], tokens->argv[i], word)) return 1;
+        ++i; // the word was the redirect's
+    }
+    tokens->argv[argc] = NULL;
+    tokens->len = argc;
+    return 0;
+}
+
+void redirect_list_free(redirect_list* redirs) {
+    for (size_t i = 0; i < redirs->num_opened; ++i) {
+        close(redirs->opened[i]);
+    }
+    free(redirs->opened);
+    free(redirs->fds);
+    memset(redirs, 0, sizeof(redirect_list));
+}
@@ -0,0 +1,42 @@
+#ifndef REDIRECT_H
+#define REDIRECT_H
+
+#include <stddef.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "launch.h"
+#include "tokenizer.h"
+
+#define REDIR_FD_MIN 10 // files opened for redirects are moved to this fd or above, clear of the 0-9 a redirect can name
+
+/// @brief move one of the shell's own long lived fds to REDIR_FD_MIN or above, close-on-exec, out of the way of `2>&5`
+/// @return the fd to use from now on, fd itself if it can't be moved
+static inline int redirect_fd_high(int fd) {
+    if (fd == -1 || fd >= REDIR_FD_MIN) return fd;
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, REDIR_FD_MIN);
+    if (high == -1) return fd;
+    close(fd);
+    return high;
+}
+
+// the redirects of one command as fd changes in the order they apply, and the fds the shell opened for them
+typedef struct redirect_list redirect_list;
+struct redirect_list {
+    launch_fd* fds;
+    size_t len;
+    size_t cap;
+    int* opened; // closed by redirect_list_free()
+    size_t num_opened;
+};
+
+// next line of input for a heredoc body without its newline, NULL at the end of input,
+// * only has to stay valid until the next call
+typedef char* (*heredoc_line_reader)(void);
+extern heredoc_line_reader redirect_heredoc_reader;
+
+int  redirect_parse(token_list* tokens, redirect_list* redirs);
+void redirect_list_free(redirect_list* redirs);
+
+#endif
@@ -0,0 +1,321 @@
+/*
+Single pass lexer for a command line.
+
+Quotes and backslashes used to be stripped by memmove'ing the rest of the line over them, once per quote
+or escape, which is quadratic in the line length. Here every token is copied exactly once into an output
+buffer as it is read, with the quoting already removed. A line of n bytes can't produce more than n tokens
+or more than 2n bytes of output (every token adds one NUL), so argv and the kinds are sized up front in one
+allocation, and the output only has to grow when a variable expands to something longer than its name.
+
+Operators are recognized wherever they appear outside quotes, so `ls|wc` and `echo hi>out` work without spaces.
+A redirect's fd number has to start the token though, `a2>f` is the word a2 redirected to f.
+
+A word with an unquoted *, ? or [ is a TOK_GLOB for pathGlob.c to expand. So that the quoted parts of it
+stay literal, every quoted or escaped glob character and backslash is written with a backslash in front,
+and in a word that turns out not to be a glob those backslashes are taken out again at its end. That's
+still at most two output bytes per input byte.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "tokenizer.h"
+
+#define VAR_NAME_CAP 256 // longer $NAMEs are left unexpanded
+
+static const char* token_spelling[] = {
+    [TOK_WORD] = "",
+    [TOK_PIPE] = "|",
+    [TOK_IN] = "<",
+    [TOK_OUT] = ">",
+    [TOK_OUT_APPEND] = ">>",
+    [TOK_DUP_IN] = "<&",
+    [TOK_DUP_OUT] = ">&",
+    [TOK_HEREDOC] = "<<",
+    [TOK_HEREDOC_LITERAL] = "<<",
+    [TOK_HERESTRING] = "<<<",
+    [TOK_OUT_ALL] = "&>",
+    [TOK_OUT_ALL_APPEND] = "&>>",
+    [TOK_AMP] = "&",
+    [TOK_GLOB] = "",
+};
+
+typedef struct out_buf out_buf;
+struct out_buf {
+    char* data;
+    size_t len;
+    size_t cap;
+};
+
+token_var_lookup tokenize_var_lookup = NULL;
+
+static size_t lex_operator(const char* ptr, bool word_start, token_kind* kind, char* fd);
+static void out_reserve(out_buf* out, size_t extra);
+static size_t expand_var(const char* ptr, const char* end, out_buf* out, bool* escaped);
+
+static inline bool is_glob_char(char c) {
+    return c == '*' || c == '?' || c == '[';
+}
+
+/// @brief copy a byte that was quoted, escaped or came out of a variable, with a backslash if a glob would take it as one
+static inline void put_literal(out_buf* out, char c, bool* escaped) {
+    if (is_glob_char(c) || c == '\\') {
+        out->data[out->len++] = '\\';
+        *escaped = true;
+    }
+    out->data[out->len++] = c;
+}
+
+/// @brief match an operator at ptr
+/// @param word_start an fd number ("2>") only counts at the start of a token, in "a2>f" the 2 belongs to the word
+/// @param fd set to the fd digit in front of a redirect, '\0' if there is none
+/// @return number of bytes the operator takes up, 0 if ptr doesn't start one
+static size_t lex_operator(const char* ptr, bool word_start, token_kind* kind, char* fd) {
+    *fd = '\0';
+    if (ptr[0] == '|') {
+        *kind = TOK_PIPE;
+        return 1;
+    }
+    if (ptr[0] == '&') {
+        if (ptr[1] != '>') {
+            *kind = TOK_AMP;
+            return 1;
+        }
+        *kind = ptr[2] == '>' ? TOK_OUT_ALL_APPEND : TOK_OUT_ALL;
+        return ptr[2] == '>' ? 3 : 2;
+    }
+    size_t len = 0;
+    if (word_start && isdigit((unsigned char) ptr[0]) && (ptr[1] == '<' || ptr[1] == '>')) {
+        *fd = ptr[0];
+        len = 1;
+    }
+    if (ptr[len] == '<') {
+        if (ptr[len + 1] == '<' && ptr[len + 2] == '<') {
+            *kind = TOK_HERESTRING;
+            return len + 3;
+        }
+        *kind = ptr[len + 1] == '<' ? TOK_HEREDOC : ptr[len + 1] == '&' ? TOK_DUP_IN : TOK_IN;
+        return *kind == TOK_IN ? len + 1 : len + 2;
+    }
+    if (ptr[len] == '>') {
+        *kind = ptr[len + 1] == '>' ? TOK_OUT_APPEND : ptr[len + 1] == '&' ? TOK_DUP_OUT : TOK_OUT;
+        return *kind == TOK_OUT ? len + 1 : len + 2;
+    }
+    *fd = '\0';
+    return 0;
+}
+
+/// @brief make room for extra more bytes of output
+static void out_reserve(out_buf* out, size_t extra) {
+    if (out->len + extra <= out->cap) return;
+    while (out->len + extra > out->cap) {
+        out->cap *= 2;
+    }
+    out->data = realloc(out->data, out->cap);
+}
+
+/// @brief expand the variable reference after a '$': $?, $NAME, ${NAME} or ${NAME[subscript]}
+/// @param ptr just past the '$'
+/// @param end end of the line, room for the rest of it is reserved along with the value
+/// @param escaped NULL to copy the value as is, otherwise it goes through put_literal()
+/// @return bytes of ptr consumed, 0 if it isn't a variable reference and the '$' is literal
+static size_t expand_var(const char* ptr, const char* end, out_buf* out, bool* escaped) {
+    char name[VAR_NAME_CAP];
+    char subscript[VAR_NAME_CAP];
+    bool has_subscript = false;
+    bool braced = *ptr == '{';
+    const char* cur = braced ? ptr + 1 : ptr;
+    size_t name_len = 0;
+
+    if (*cur == '?') {
+        name[name_len++] = *cur++;
+    } else {
+        if (!(isalpha((unsigned char) *cur) || *cur == '_')) return 0;
+        while (isalnum((unsigned char) *cur) || *cur == '_') {
+            if (name_len == VAR_NAME_CAP - 1) return 0;
+            name[name_len++] = *cur++;
+        }
+    }
+    name[name_len] = '\0';
+
+    if (braced) {
+        if (*cur == '[') {
+            const char* close = strchr(cur, ']');
+            if (close == NULL || (size_t) (close - cur) > VAR_NAME_CAP - 1) return 0;
+            memcpy(subscript, cur + 1, close - cur - 1);
+            subscript[close - cur - 1] = '\0';
+            has_subscript = true;
+            cur = close + 1;
+        }
+        if (*cur != '}') return 0;
+        ++cur;
+    }
+
+    const char* value = tokenize_var_lookup ? tokenize_var_lookup(name, has_subscript ? subscript : NULL) : NULL;
+    if (value == NULL && !has_subscript) value = getenv(name);
+    size_t value_len = value ? strlen(value) : 0;
+    out_reserve(out, 2 * value_len + 2 * (end - cur) + 1); // keeps the invariant tokenize() relies on
+    if (value && escaped) {
+        for (size_t i = 0; i < value_len; ++i) {
+            put_literal(out, value[i], escaped);
+        }
+    } else if (value) {
+        memcpy(out->data + out->len, value, value_len);
+        out->len += value_len;
+    }
+    return cur - ptr;
+}
+
+/// @brief split line into words and operators, removing quotes and escapes and expanding variables
+/// * single quotes keep everything literally, inside double quotes a backslash only escapes " \ and $,
+/// * outside of quotes a backslash escapes any character. Quoted parts join the word they touch, like `a"b c"d`
+/// * an unterminated quote runs to the end of the line
+/// * an unquoted '#' starting a token comments out the rest of the line
+/// * $VAR is expanded outside of single quotes, the value is never split into more words or globbed,
+/// * and an unquoted word that expands to nothing is dropped like in sh
+/// * a word with an unquoted *, ? or [ becomes a TOK_GLOB, see the top of this file
+/// @param line the shell input to be tokenized, not modified
+/// @param tokens filled in, free with token_list_free()
+void tokenize(const char* line, token_list* tokens) {
+    size_t line_len = strlen(line);
+    size_t max_tokens = line_len + 1; // +1 for the NULL sentinel, expansion never adds tokens
+    char* block = malloc(max_tokens * (sizeof(char*) + sizeof(token_kind)));
+    char** argv = (char**) block;
+    token_kind* kinds = (token_kind*) (argv + max_tokens);
+    // unescaped bytes, only outgrows this if an expansion is longer than its $NAME
+    // * there is always room for twice the unread input, so copying a byte never has to check
+    const char* end = line + line_len;
+    out_buf out = {.data = malloc(2 * line_len + 1), .len = 0, .cap = 2 * line_len + 1};
+
+    size_t argc = 0;
+    const char* ptr = line;
+    while (1) {
+        // extra spaces between tokens are collapsed
+        while (*ptr == ' ' || *ptr == '\t') {
+            ++ptr;
+        }
+        if (*ptr == '\0') break; // reached the end
+        if (*ptr == '#') break;  // a comment runs to the end of the line, a '#' inside a word is just a '#'
+
+        token_kind kind = TOK_WORD;
+        char fd = '\0';
+        size_t op_len = lex_operator(ptr, true, &kind, &fd);
+        if (op_len) {
+            size_t spelling_len = strlen(token_spelling[kind]) + 1;
+            argv[argc] = (char*) (uintptr_t) out.len; // * an offset until the end, out can move while an expansion grows it
+            kinds[argc++] = kind;
+            if (fd) out.data[out.len++] = fd; // the digit was part of the input, so this stays within 2n bytes
+            memcpy(out.data + out.len, token_spelling[kind], spelling_len);
+            out.len += spelling_len;
+            ptr += op_len;
+            continue;
+        }
+
+        size_t word_start = out.len;
+        bool quoted = false;
+        bool expanded = false;
+        bool glob = false;    // an unquoted glob character
+        bool escaped = false; // put_literal() added a backslash
+        while (*ptr && *ptr != ' ' && *ptr != '\t') {
+            if (*ptr == '\'') {
+                quoted = true;
+                ++ptr;
+                while (*ptr && *ptr != '\'') {
+                    put_literal(&out, *ptr++, &escaped);
+                }
+                if (*ptr) ++ptr; // closing quote
+            } else if (*ptr == '"') {
+                quoted = true;
+                ++ptr;
+                while (*ptr && *ptr != '"') {
+                    size_t var_len = 0;
+                    if (*ptr == '$' && (var_len = expand_var(ptr + 1, end, &out, &escaped))) {
+                        ptr += var_len + 1;
+                        continue;
+                    }
+                    // preserve backslash rules
+                    if (*ptr == '\\' && (ptr[1] == '"' || ptr[1] == '\\' || ptr[1] == '$')) ++ptr;
+                    put_literal(&out, *ptr++, &escaped);
+                }
+                if (*ptr) ++ptr;
+            } else if (*ptr == '\\') { // backslashed literal, a trailing backslash is dropped
+                ++ptr;
+                if (*ptr) put_literal(&out, *ptr++, &escaped);
+            } else if (*ptr == '$') {
+                size_t var_len = expand_var(ptr + 1, end, &out, &escaped);
+                if (var_len) {
+                    expanded = true;
+                    ptr += var_len + 1;
+                } else {
+                    out.data[out.len++] = *ptr++;
+                }
+            } else if (lex_operator(ptr, false, &kind, &fd)) {
+                break; // operator ends the word, picked up on the next round
+            } else {
+                if (is_glob_char(*ptr)) glob = true;
+                out.data[out.len++] = *ptr++;
+            }
+        }
+        if (expanded && !quoted && out.len == word_start) continue; // `echo $UNSET` has no arguments
+        if (quoted && argc && kinds[argc - 1] == TOK_HEREDOC) kinds[argc - 1] = TOK_HEREDOC_LITERAL; // <<'EOF'
+        out.data[out.len++] = '\0';
+        if (escaped && !glob) out.len = word_start + token_unescape(out.data + word_start) + 1;
+        argv[argc] = (char*) (uintptr_t) word_start;
+        kinds[argc++] = glob ? TOK_GLOB : TOK_WORD;
+    }
+    for (size_t i = 0; i < argc; ++i) {
+        argv[i] = out.data + (uintptr_t) argv[i];
+    }
+    argv[argc] = NULL;
+    tokens->argv = argv;
+    tokens->kinds = kinds;
+    tokens->len = argc;
+    tokens->buf = out.data;
+    tokens->globbed = NULL;
+}
+
+/// @brief take out the backslashes tokenize() put in front of literal glob characters, for a TOK_GLOB that stays a word
+/// @return the word's new length
+size_t token_unescape(char* word) {
+    char* out = word;
+    for (const char* in = word; *in; ++in) {
+        if (*in == '\\' && in[1]) ++in;
+        *out++ = *in;
+    }
+    *out = '\0';
+    return out - word;
+}
+
+/// @brief expand the variables in a heredoc body, a backslash only escapes $ and another backslash
+/// @return malloc'd expansion, MUST BE FREE'D BY CALLER
+char* expand_vars(const char* text) {
+    size_t len = strlen(text);
+    const char* end = text + len;
+    out_buf out = {.data = malloc(2 * len + 1), .len = 0, .cap = 2 * len + 1};
+    for (const char* ptr = text; *ptr; ) {
+        size_t var_len = 0;
+        if (*ptr == '$' && (var_len = expand_var(ptr + 1, end, &out, NULL))) {
+            ptr += var_len + 1;
+            continue;
+        }
+        if (*ptr == '\\' && (ptr[1] == '$' || ptr[1] == '\\')) ++ptr;
+        out.data[out.len++] = *ptr++;
+    }
+    out.data[out.len] = '\0';
+    return out.data;
+}
+
+void token_list_free(token_list* tokens) {
+    free(tokens->argv); // start of the block
+    free(tokens->buf);
+    free(tokens->globbed);
+    tokens->argv = NULL;
+    tokens->kinds = NULL;
+    tokens->buf = NULL;
+    tokens->globbed = NULL;
+    tokens->len = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// the redirect operators can start with a one digit fd number, which stays part of their spelling ("2>", "0<&")
+typedef enum token_kind {
+    TOK_WORD,
+    TOK_PIPE,            // |
+    TOK_IN,              // < or n<
+    TOK_OUT,             // > or n>
+    TOK_OUT_APPEND,      // >> or n>>
+    TOK_DUP_IN,          // <& or n<&, followed by the fd to copy or - to close
+    TOK_DUP_OUT,         // >& or n>&
+    TOK_HEREDOC,         // <<, followed by the delimiter, the body has variables expanded
+    TOK_HEREDOC_LITERAL, // << with a quoted delimiter, the body is taken as is
+    TOK_HERESTRING,      // <<<
+    TOK_OUT_ALL,         // &> stdout and stderr both
+    TOK_OUT_ALL_APPEND,  // &>>
+    TOK_AMP,             // & after a command, runs it in the background
+    TOK_GLOB,            // a word with an unquoted *, ? or [, its quoted ones and backslashes escaped with a backslash
+} token_kind;
+
+// result of tokenize()
+typedef struct token_list token_list;
+struct token_list {
+    char** argv;       // len tokens then NULL, operators are spelled the canonical way (">", "2>>", ...)
+    token_kind* kinds; // kinds[i] is the kind of argv[i], so a quoted ">" is still just a word
+    size_t len;
+    char* buf;         // the strings argv points to
+    char* globbed;     // the file names globs expanded to, see path_glob_tokens(), NULL if none
+};
+
+// value of $name or ${name[subscript]} (subscript NULL if there is none), NULL if unset
+// * name and subscript are NUL terminated, the result only has to stay valid until the next call
+typedef const char* (*token_var_lookup)(const char* name, const char* subscript);
+extern token_var_lookup tokenize_var_lookup; // shell variables like $?, NULL expands only the environment
+
+void  tokenize(const char* line, token_list* tokens);
+void  token_list_free(token_list* tokens);
+size_t token_unescape(char* word);
+char* expand_vars(const char* text);
+
+static inline bool token_is_redir(token_kind kind) {
+    return kind >= TOK_IN && kind <= TOK_OUT_ALL_APPEND;
+}
+
+#endif